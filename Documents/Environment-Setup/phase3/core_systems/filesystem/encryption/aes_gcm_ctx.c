@@ -0,0 +1,195 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <pthread.h>
+#include <openssl/evp.h>
+#include <openssl/crypto.h>
+#include <openssl/err.h>
+#include "aes_gcm_encrypt.h"
+#include "aes_gcm_stream.h"
+
+/* Keyed contexts for single-message encryption. Building one costs an
+ * allocation, a cipher fetch and the AES key schedule, which dominates
+ * for small messages; once built, a message only sets its IV. GCM runs
+ * AES forwards in both directions, so the same key schedule serves
+ * encryption and decryption and a context switches freely between them.
+ *
+ * Each thread also keeps a few contexts keyed with the keys it used most
+ * recently, found by comparing keys, which is what encrypt_file_data()
+ * and decrypt_file_data() go through. The pool lives behind a pthread key
+ * so that its contexts are freed, and its key copies wiped, when the
+ * thread exits. */
+
+struct aes_gcm_ctx {
+    EVP_CIPHER_CTX *evp;
+};
+
+struct pool_entry {
+    unsigned char key[AES_KEY_SIZE];
+    struct aes_gcm_ctx *ctx;    // NULL for an empty entry
+    uint64_t last_used;
+};
+
+struct ctx_pool {
+    struct pool_entry entries[AES_GCM_CTX_POOL_SIZE];
+    uint64_t clock;
+};
+
+static pthread_key_t pool_key;
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+static int pool_key_ok;
+
+struct aes_gcm_ctx *aes_gcm_ctx_new(const unsigned char *key) {
+    struct aes_gcm_ctx *ctx = malloc(sizeof(*ctx));
+
+    if (!ctx) {
+        perror("malloc");
+        return NULL;
+    }
+    ctx->evp = aes_gcm_stream_ctx(key, 1);
+    if (!ctx->evp) {
+        free(ctx);
+        return NULL;
+    }
+    return ctx;
+}
+
+void aes_gcm_ctx_free(struct aes_gcm_ctx *ctx) {
+    if (!ctx) {
+        return;
+    }
+    // Also wipes the key schedule
+    EVP_CIPHER_CTX_free(ctx->evp);
+    free(ctx);
+}
+
+int aes_gcm_ctx_encrypt(struct aes_gcm_ctx *ctx, const unsigned char *plaintext,
+                        size_t plaintext_len, const unsigned char *iv,
+                        unsigned char *ciphertext, unsigned char *tag) {
+    int len = 0, final_len = 0;
+
+    if (!ctx || (!plaintext && plaintext_len > 0) || !iv || !ciphertext || !tag ||
+        plaintext_len > INT_MAX) {
+        fprintf(stderr, "Invalid parameters to aes_gcm_ctx_encrypt\n");
+        return -1;
+    }
+
+    if (EVP_EncryptInit_ex(ctx->evp, NULL, NULL, NULL, iv) != 1 ||
+        (plaintext_len > 0 &&
+         EVP_EncryptUpdate(ctx->evp, ciphertext, &len, plaintext, (int)plaintext_len) != 1) ||
+        EVP_EncryptFinal_ex(ctx->evp, ciphertext + len, &final_len) != 1 ||
+        EVP_CIPHER_CTX_ctrl(ctx->evp, EVP_CTRL_GCM_GET_TAG, AES_TAG_SIZE, tag) != 1) {
+        fprintf(stderr, "OpenSSL Error in aes_gcm_ctx_encrypt: ");
+        ERR_print_errors_fp(stderr);
+        return -1;
+    }
+    return len + final_len;
+}
+
+int aes_gcm_ctx_decrypt(struct aes_gcm_ctx *ctx, const unsigned char *ciphertext,
+                        size_t ciphertext_len, const unsigned char *iv,
+                        const unsigned char *tag, unsigned char *plaintext) {
+    int len = 0, final_len = 0;
+
+    if (!ctx || (!ciphertext && ciphertext_len > 0) || !iv || !tag || !plaintext ||
+        ciphertext_len > INT_MAX) {
+        fprintf(stderr, "Invalid parameters to aes_gcm_ctx_decrypt\n");
+        return -1;
+    }
+
+    if (EVP_DecryptInit_ex(ctx->evp, NULL, NULL, NULL, iv) != 1 ||
+        (ciphertext_len > 0 &&
+         EVP_DecryptUpdate(ctx->evp, plaintext, &len, ciphertext, (int)ciphertext_len) != 1) ||
+        EVP_CIPHER_CTX_ctrl(ctx->evp, EVP_CTRL_GCM_SET_TAG, AES_TAG_SIZE, (void *)tag) != 1) {
+        fprintf(stderr, "OpenSSL Error in aes_gcm_ctx_decrypt: ");
+        ERR_print_errors_fp(stderr);
+        return -1;
+    }
+    if (EVP_DecryptFinal_ex(ctx->evp, plaintext + len, &final_len) != 1) {
+        fprintf(stderr, "Decryption failed authentication\n");
+        return -1;
+    }
+    return len + final_len;
+}
+
+static void pool_destroy(void *arg) {
+    struct ctx_pool *pool = arg;
+
+    for (int i = 0; i < AES_GCM_CTX_POOL_SIZE; i++) {
+        aes_gcm_ctx_free(pool->entries[i].ctx);
+    }
+    OPENSSL_cleanse(pool, sizeof(*pool));
+    free(pool);
+}
+
+static void pool_key_init(void) {
+    pool_key_ok = pthread_key_create(&pool_key, pool_destroy) == 0;
+}
+
+static struct ctx_pool *thread_pool(int create) {
+    struct ctx_pool *pool;
+
+    pthread_once(&pool_once, pool_key_init);
+    if (!pool_key_ok) {
+        fprintf(stderr, "Cannot create the cipher context pool\n");
+        return NULL;
+    }
+    pool = pthread_getspecific(pool_key);
+    if (!pool && create) {
+        pool = calloc(1, sizeof(*pool));
+        if (!pool) {
+            perror("calloc");
+            return NULL;
+        }
+        if (pthread_setspecific(pool_key, pool) != 0) {
+            fprintf(stderr, "Cannot create the cipher context pool\n");
+            free(pool);
+            return NULL;
+        }
+    }
+    return pool;
+}
+
+struct aes_gcm_ctx *aes_gcm_ctx_cached(const unsigned char *key) {
+    struct ctx_pool *pool = thread_pool(1);
+    struct pool_entry *victim;
+
+    if (!pool || !key) {
+        return NULL;
+    }
+
+    victim = &pool->entries[0];
+    for (int i = 0; i < AES_GCM_CTX_POOL_SIZE; i++) {
+        struct pool_entry *entry = &pool->entries[i];
+        if (entry->ctx && CRYPTO_memcmp(entry->key, key, AES_KEY_SIZE) == 0) {
+            entry->last_used = ++pool->clock;
+            return entry->ctx;
+        }
+        if (entry->last_used < victim->last_used) {
+            victim = entry;
+        }
+    }
+
+    aes_gcm_ctx_free(victim->ctx);
+    OPENSSL_cleanse(victim, sizeof(*victim));
+    victim->ctx = aes_gcm_ctx_new(key);
+    if (!victim->ctx) {
+        return NULL;
+    }
+    memcpy(victim->key, key, AES_KEY_SIZE);
+    victim->last_used = ++pool->clock;
+    return victim->ctx;
+}
+
+void aes_gcm_ctx_pool_flush(void) {
+    struct ctx_pool *pool = thread_pool(0);
+
+    if (!pool) {
+        return;
+    }
+    for (int i = 0; i < AES_GCM_CTX_POOL_SIZE; i++) {
+        aes_gcm_ctx_free(pool->entries[i].ctx);
+    }
+    OPENSSL_cleanse(pool, sizeof(*pool));
+}
@@ -6,17 +6,8 @@
 #include <openssl/evp.h>
 #include <openssl/rand.h>
 #include <openssl/err.h>
-
-#define AES_KEY_SIZE 32
-#define AES_IV_SIZE 12
-#define AES_TAG_SIZE 16
-#define BUFFER_SIZE 4096
-
-typedef struct {
-    unsigned char key[AES_KEY_SIZE];
-    unsigned char iv[AES_IV_SIZE];
-    unsigned char tag[AES_TAG_SIZE];
-} aes_gcm_context_t;
+#include "aes_gcm_encrypt.h"
+#include "aes_gcm_stream.h"
 
 static void handle_openssl_error(const char *msg) {
     fprintf(stderr, "OpenSSL Error in %s: ", msg);
@@ -31,132 +22,262 @@ int generate_random_key(unsigned char *key, size_t key_len) {
     return 0;
 }
 
+// Both go through the calling thread's context pool, so repeated calls
+// with one key skip the context setup and the key schedule
 int encrypt_file_data(const unsigned char *plaintext, size_t plaintext_len,
                      const unsigned char *key, const unsigned char *iv,
                      unsigned char *ciphertext, unsigned char *tag) {
-    EVP_CIPHER_CTX *ctx = NULL;
-    int len, ciphertext_len;
-    int ret = -1;
-
     if (!plaintext || !key || !iv || !ciphertext || !tag) {
         fprintf(stderr, "Invalid parameters to encrypt_file_data\n");
         return -1;
     }
 
-    ctx = EVP_CIPHER_CTX_new();
+    struct aes_gcm_ctx *ctx = aes_gcm_ctx_cached(key);
     if (!ctx) {
-        handle_openssl_error("EVP_CIPHER_CTX_new");
         return -1;
     }
+    return aes_gcm_ctx_encrypt(ctx, plaintext, plaintext_len, iv, ciphertext, tag);
+}
 
-    if (EVP_EncryptInit_ex(ctx, EVP_aes_256_gcm(), NULL, NULL, NULL) != 1) {
-        handle_openssl_error("EVP_EncryptInit_ex");
-        goto cleanup;
+int decrypt_file_data(const unsigned char *ciphertext, size_t ciphertext_len,
+                     const unsigned char *key, const unsigned char *iv,
+                     const unsigned char *tag, unsigned char *plaintext) {
+    if (!ciphertext || !key || !iv || !tag || !plaintext) {
+        fprintf(stderr, "Invalid parameters to decrypt_file_data\n");
+        return -1;
     }
 
-    if (EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_IVLEN, AES_IV_SIZE, NULL) != 1) {
-        handle_openssl_error("EVP_CTRL_GCM_SET_IVLEN");
-        goto cleanup;
+    struct aes_gcm_ctx *ctx = aes_gcm_ctx_cached(key);
+    if (!ctx) {
+        return -1;
     }
+    return aes_gcm_ctx_decrypt(ctx, ciphertext, ciphertext_len, iv, tag, plaintext);
+}
 
-    if (EVP_EncryptInit_ex(ctx, NULL, NULL, key, iv) != 1) {
-        handle_openssl_error("EVP_EncryptInit_ex key/iv");
-        goto cleanup;
+static void store_le32(unsigned char *p, uint32_t value) {
+    p[0] = value;
+    p[1] = value >> 8;
+    p[2] = value >> 16;
+    p[3] = value >> 24;
+}
+
+static uint32_t load_le32(const unsigned char *p) {
+    return p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+int aes_gcm_build_header(unsigned char *header, size_t chunk_size) {
+    memset(header, 0, AES_GCM_HEADER_SIZE);
+    memcpy(header, AES_GCM_STREAM_MAGIC, 8);
+    store_le32(header + 8, AES_GCM_STREAM_VERSION);
+    store_le32(header + 12, (uint32_t)chunk_size);
+    if (generate_random_key(header + 16, AES_IV_SIZE) != 0) {
+        fprintf(stderr, "Failed to generate nonce base\n");
+        return -1;
     }
+    return 0;
+}
 
-    if (EVP_EncryptUpdate(ctx, ciphertext, &len, plaintext, plaintext_len) != 1) {
-        handle_openssl_error("EVP_EncryptUpdate");
-        goto cleanup;
+int aes_gcm_parse_header(const unsigned char *header, size_t *chunk_size) {
+    if (memcmp(header, AES_GCM_STREAM_MAGIC, 8) != 0) {
+        fprintf(stderr, "Not an encrypted file\n");
+        return -1;
     }
-    ciphertext_len = len;
+    if (load_le32(header + 8) != AES_GCM_STREAM_VERSION) {
+        fprintf(stderr, "Unsupported encrypted file version %u\n", load_le32(header + 8));
+        return -1;
+    }
+    *chunk_size = load_le32(header + 12);
+    if (*chunk_size == 0 || *chunk_size > AES_GCM_MAX_CHUNK_SIZE) {
+        fprintf(stderr, "Invalid chunk size %zu\n", *chunk_size);
+        return -1;
+    }
+    return 0;
+}
 
-    if (EVP_EncryptFinal_ex(ctx, ciphertext + len, &len) != 1) {
-        handle_openssl_error("EVP_EncryptFinal_ex");
-        goto cleanup;
+uint64_t aes_gcm_encrypted_size(uint64_t plain_size, size_t chunk_size, uint64_t *chunks) {
+    *chunks = plain_size / chunk_size + 1;
+    return AES_GCM_HEADER_SIZE + plain_size + *chunks * AES_TAG_SIZE;
+}
+
+int aes_gcm_plain_size(uint64_t encrypted_size, size_t chunk_size, uint64_t *plain_size,
+                       uint64_t *chunks) {
+    uint64_t record = chunk_size + AES_TAG_SIZE;
+
+    if (encrypted_size < AES_GCM_HEADER_SIZE + AES_TAG_SIZE) {
+        return -1;
+    }
+    uint64_t full = (encrypted_size - AES_GCM_HEADER_SIZE) / record;
+    uint64_t rest = (encrypted_size - AES_GCM_HEADER_SIZE) % record;
+    if (rest < AES_TAG_SIZE) {
+        return -1;
     }
-    ciphertext_len += len;
+    *chunks = full + 1;
+    *plain_size = full * chunk_size + rest - AES_TAG_SIZE;
+    return 0;
+}
 
-    if (EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, AES_TAG_SIZE, tag) != 1) {
-        handle_openssl_error("EVP_CTRL_GCM_GET_TAG");
-        goto cleanup;
+// Nonce base with the chunk index XORed into its last 8 bytes
+static void chunk_nonce(const unsigned char *header, uint64_t index, unsigned char *nonce) {
+    memcpy(nonce, header + 16, AES_IV_SIZE);
+    for (int i = 0; i < 8; i++) {
+        nonce[AES_IV_SIZE - 1 - i] ^= (unsigned char)(index >> (8 * i));
     }
+}
 
-    ret = ciphertext_len;
+// Runs the key schedule once; each chunk then only sets a new nonce
+EVP_CIPHER_CTX *aes_gcm_stream_ctx(const unsigned char *key, int encrypt) {
+    EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+    if (!ctx) {
+        handle_openssl_error("EVP_CIPHER_CTX_new");
+        return NULL;
+    }
 
-cleanup:
-    if (ctx) EVP_CIPHER_CTX_free(ctx);
-    return ret;
+    if (EVP_CipherInit_ex(ctx, EVP_aes_256_gcm(), NULL, NULL, NULL, encrypt) != 1 ||
+        EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_IVLEN, AES_IV_SIZE, NULL) != 1 ||
+        EVP_CipherInit_ex(ctx, NULL, NULL, key, NULL, encrypt) != 1) {
+        handle_openssl_error("EVP_CipherInit_ex");
+        EVP_CIPHER_CTX_free(ctx);
+        return NULL;
+    }
+    return ctx;
 }
 
-int decrypt_file_data(const unsigned char *ciphertext, size_t ciphertext_len,
-                     const unsigned char *key, const unsigned char *iv,
-                     const unsigned char *tag, unsigned char *plaintext) {
+// Encrypts a chunk and stores its tag
+int aes_gcm_encrypt_chunk(EVP_CIPHER_CTX *ctx, const unsigned char *header, uint64_t index,
+                          int final, const unsigned char *in, unsigned char *out, size_t len,
+                          unsigned char *tag) {
+    unsigned char nonce[AES_IV_SIZE];
+    unsigned char flag = final ? 1 : 0;
+    int out_len = 0, aad_len;
+
+    chunk_nonce(header, index, nonce);
+    if (EVP_EncryptInit_ex(ctx, NULL, NULL, NULL, nonce) != 1 ||
+        EVP_EncryptUpdate(ctx, NULL, &aad_len, header, AES_GCM_HEADER_SIZE) != 1 ||
+        EVP_EncryptUpdate(ctx, NULL, &aad_len, &flag, 1) != 1 ||
+        (len > 0 && EVP_EncryptUpdate(ctx, out, &out_len, in, (int)len) != 1) ||
+        EVP_EncryptFinal_ex(ctx, out + out_len, &out_len) != 1 ||
+        EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, AES_TAG_SIZE, tag) != 1) {
+        handle_openssl_error("aes_gcm_encrypt_chunk");
+        return -1;
+    }
+    return 0;
+}
+
+// Decrypts a chunk; -1 when it fails authentication
+int aes_gcm_decrypt_chunk(EVP_CIPHER_CTX *ctx, const unsigned char *header, uint64_t index,
+                          int final, const unsigned char *in, unsigned char *out, size_t len,
+                          const unsigned char *tag) {
+    unsigned char nonce[AES_IV_SIZE];
+    unsigned char flag = final ? 1 : 0;
+    int out_len = 0, aad_len;
+
+    chunk_nonce(header, index, nonce);
+    if (EVP_DecryptInit_ex(ctx, NULL, NULL, NULL, nonce) != 1 ||
+        EVP_DecryptUpdate(ctx, NULL, &aad_len, header, AES_GCM_HEADER_SIZE) != 1 ||
+        EVP_DecryptUpdate(ctx, NULL, &aad_len, &flag, 1) != 1 ||
+        (len > 0 && EVP_DecryptUpdate(ctx, out, &out_len, in, (int)len) != 1) ||
+        EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, AES_TAG_SIZE, (void *)tag) != 1) {
+        handle_openssl_error("aes_gcm_decrypt_chunk");
+        return -1;
+    }
+    if (EVP_DecryptFinal_ex(ctx, out + out_len, &out_len) != 1) {
+        fprintf(stderr, "Chunk %llu failed authentication\n", (unsigned long long)index);
+        return -1;
+    }
+    return 0;
+}
+
+int encrypt_file_chunked(const char *input_file, const char *output_file,
+                         const unsigned char *key, size_t chunk_size) {
+    FILE *in_fp = NULL, *out_fp = NULL;
     EVP_CIPHER_CTX *ctx = NULL;
-    int len, plaintext_len;
+    unsigned char header[AES_GCM_HEADER_SIZE];
+    unsigned char *buffer = NULL;
     int ret = -1;
 
-    if (!ciphertext || !key || !iv || !tag || !plaintext) {
-        fprintf(stderr, "Invalid parameters to decrypt_file_data\n");
+    if (!input_file || !output_file || !key ||
+        chunk_size == 0 || chunk_size > AES_GCM_MAX_CHUNK_SIZE) {
+        fprintf(stderr, "Invalid parameters to encrypt_file_chunked\n");
         return -1;
     }
 
-    ctx = EVP_CIPHER_CTX_new();
-    if (!ctx) {
-        handle_openssl_error("EVP_CIPHER_CTX_new");
+    in_fp = fopen(input_file, "rb");
+    if (!in_fp) {
+        perror("fopen input file");
         return -1;
     }
 
-    if (EVP_DecryptInit_ex(ctx, EVP_aes_256_gcm(), NULL, NULL, NULL) != 1) {
-        handle_openssl_error("EVP_DecryptInit_ex");
-        goto cleanup;
+    out_fp = fopen(output_file, "wb");
+    if (!out_fp) {
+        perror("fopen output file");
+        fclose(in_fp);
+        return -1;
     }
 
-    if (EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_IVLEN, AES_IV_SIZE, NULL) != 1) {
-        handle_openssl_error("EVP_CTRL_GCM_SET_IVLEN");
+    // Chunks are encrypted in place, with the tag stored right behind them
+    buffer = malloc(chunk_size + AES_TAG_SIZE);
+    ctx = aes_gcm_stream_ctx(key, 1);
+    if (!buffer || !ctx || aes_gcm_build_header(header, chunk_size) != 0) {
         goto cleanup;
     }
 
-    if (EVP_DecryptInit_ex(ctx, NULL, NULL, key, iv) != 1) {
-        handle_openssl_error("EVP_DecryptInit_ex key/iv");
+    if (fwrite(header, 1, AES_GCM_HEADER_SIZE, out_fp) != AES_GCM_HEADER_SIZE) {
+        perror("fwrite header");
         goto cleanup;
     }
 
-    if (EVP_DecryptUpdate(ctx, plaintext, &len, ciphertext, ciphertext_len) != 1) {
-        handle_openssl_error("EVP_DecryptUpdate");
-        goto cleanup;
-    }
-    plaintext_len = len;
+    // A short read means end of input: that chunk is the final one
+    for (uint64_t index = 0; ; index++) {
+        size_t bytes_read = fread(buffer, 1, chunk_size, in_fp);
+        if (ferror(in_fp)) {
+            perror("fread input file");
+            goto cleanup;
+        }
 
-    if (EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, AES_TAG_SIZE, (void*)tag) != 1) {
-        handle_openssl_error("EVP_CTRL_GCM_SET_TAG");
-        goto cleanup;
-    }
+        int final = bytes_read < chunk_size;
+        if (aes_gcm_encrypt_chunk(ctx, header, index, final, buffer, buffer, bytes_read,
+                                  buffer + bytes_read) != 0) {
+            goto cleanup;
+        }
 
-    if (EVP_DecryptFinal_ex(ctx, plaintext + len, &len) != 1) {
-        handle_openssl_error("EVP_DecryptFinal_ex - Authentication failed");
-        goto cleanup;
+        if (fwrite(buffer, 1, bytes_read + AES_TAG_SIZE, out_fp) != bytes_read + AES_TAG_SIZE) {
+            perror("fwrite encrypted data");
+            goto cleanup;
+        }
+        if (final) {
+            break;
+        }
     }
-    plaintext_len += len;
 
-    ret = plaintext_len;
+    ret = fclose(out_fp) == 0 ? 0 : -1;
+    out_fp = NULL;
+    if (ret != 0) {
+        perror("fclose output file");
+    }
 
 cleanup:
     if (ctx) EVP_CIPHER_CTX_free(ctx);
+    free(buffer);
+    fclose(in_fp);
+    if (out_fp) fclose(out_fp);
+    if (ret != 0) unlink(output_file);
     return ret;
 }
 
 int encrypt_file(const char *input_file, const char *output_file, const unsigned char *key) {
+    return encrypt_file_chunked(input_file, output_file, key, AES_GCM_DEFAULT_CHUNK_SIZE);
+}
+
+int decrypt_file(const char *input_file, const char *output_file, const unsigned char *key) {
     FILE *in_fp = NULL, *out_fp = NULL;
-    unsigned char iv[AES_IV_SIZE];
-    unsigned char tag[AES_TAG_SIZE];
-    unsigned char buffer[BUFFER_SIZE];
-    unsigned char encrypted[BUFFER_SIZE + 16];
-    size_t bytes_read;
-    int encrypted_len;
+    EVP_CIPHER_CTX *ctx = NULL;
+    unsigned char header[AES_GCM_HEADER_SIZE];
+    unsigned char *buffer = NULL;
+    size_t chunk_size;
     int ret = -1;
 
-    if (generate_random_key(iv, AES_IV_SIZE) != 0) {
-        fprintf(stderr, "Failed to generate IV\n");
+    if (!input_file || !output_file || !key) {
+        fprintf(stderr, "Invalid parameters to decrypt_file\n");
         return -1;
     }
 
@@ -166,67 +287,214 @@ int encrypt_file(const char *input_file, const char *output_file, const unsigned
         return -1;
     }
 
+    if (fread(header, 1, AES_GCM_HEADER_SIZE, in_fp) != AES_GCM_HEADER_SIZE) {
+        fprintf(stderr, "Encrypted file too short\n");
+        fclose(in_fp);
+        return -1;
+    }
+    if (aes_gcm_parse_header(header, &chunk_size) != 0) {
+        fclose(in_fp);
+        return -1;
+    }
+
     out_fp = fopen(output_file, "wb");
     if (!out_fp) {
         perror("fopen output file");
-        goto cleanup;
+        fclose(in_fp);
+        return -1;
     }
 
-    // Write IV to beginning of file
-    if (fwrite(iv, 1, AES_IV_SIZE, out_fp) != AES_IV_SIZE) {
-        perror("fwrite IV");
+    buffer = malloc(chunk_size + AES_TAG_SIZE);
+    ctx = aes_gcm_stream_ctx(key, 0);
+    if (!buffer || !ctx) {
         goto cleanup;
     }
 
-    // Encrypt file in chunks
-    while ((bytes_read = fread(buffer, 1, BUFFER_SIZE, in_fp)) > 0) {
-        encrypted_len = encrypt_file_data(buffer, bytes_read, key, iv, encrypted, tag);
-        if (encrypted_len < 0) {
-            fprintf(stderr, "Encryption failed\n");
+    // A full record is never the final chunk; a short one must be
+    for (uint64_t index = 0; ; index++) {
+        size_t bytes_read = fread(buffer, 1, chunk_size + AES_TAG_SIZE, in_fp);
+        if (ferror(in_fp)) {
+            perror("fread input file");
+            goto cleanup;
+        }
+        if (bytes_read < AES_TAG_SIZE) {
+            fprintf(stderr, "Encrypted file truncated at chunk %llu\n",
+                    (unsigned long long)index);
             goto cleanup;
         }
 
-        if (fwrite(encrypted, 1, encrypted_len, out_fp) != (size_t)encrypted_len) {
-            perror("fwrite encrypted data");
+        size_t len = bytes_read - AES_TAG_SIZE;
+        int final = len < chunk_size;
+        if (aes_gcm_decrypt_chunk(ctx, header, index, final, buffer, buffer, len,
+                                  buffer + len) != 0) {
             goto cleanup;
         }
+
+        if (fwrite(buffer, 1, len, out_fp) != len) {
+            perror("fwrite decrypted data");
+            goto cleanup;
+        }
+        if (final) {
+            break;
+        }
     }
 
-    // Write authentication tag
-    if (fwrite(tag, 1, AES_TAG_SIZE, out_fp) != AES_TAG_SIZE) {
-        perror("fwrite tag");
-        goto cleanup;
+    ret = fclose(out_fp) == 0 ? 0 : -1;
+    out_fp = NULL;
+    if (ret != 0) {
+        perror("fclose output file");
+    }
+
+cleanup:
+    if (ctx) EVP_CIPHER_CTX_free(ctx);
+    free(buffer);
+    fclose(in_fp);
+    if (out_fp) fclose(out_fp);
+    if (ret != 0) unlink(output_file);
+    return ret;
+}
+
+#ifndef AES_GCM_NO_MAIN
+static int parse_hex_key(const char *hex, unsigned char *key) {
+    if (strlen(hex) != AES_KEY_SIZE * 2) {
+        return -1;
+    }
+    for (int i = 0; i < AES_KEY_SIZE; i++) {
+        unsigned int byte;
+        if (sscanf(hex + 2 * i, "%2x", &byte) != 1) {
+            return -1;
+        }
+        key[i] = (unsigned char)byte;
     }
+    return 0;
+}
 
+// Writes length bytes of plaintext from offset on to output_file
+static int decrypt_range(const char *input_file, const char *output_file,
+                         const unsigned char *key, uint64_t offset, uint64_t length) {
+    struct aes_gcm_reader *reader = aes_gcm_reader_open(input_file, key, 0);
+    unsigned char *buffer = malloc(1024 * 1024);
+    FILE *out_fp = NULL;
+    int ret = -1;
+
+    if (!reader || !buffer) {
+        goto cleanup;
+    }
+    out_fp = fopen(output_file, "wb");
+    if (!out_fp) {
+        perror("fopen output file");
+        goto cleanup;
+    }
+    while (length > 0) {
+        ssize_t n = aes_gcm_pread(reader, buffer, length < 1024 * 1024 ? length : 1024 * 1024,
+                                  offset);
+        if (n < 0) {
+            goto cleanup;
+        }
+        if (n == 0) {
+            break;
+        }
+        if (fwrite(buffer, 1, n, out_fp) != (size_t)n) {
+            perror("fwrite output file");
+            goto cleanup;
+        }
+        offset += n;
+        length -= n;
+    }
     ret = 0;
 
 cleanup:
-    if (in_fp) fclose(in_fp);
-    if (out_fp) fclose(out_fp);
+    if (out_fp && fclose(out_fp) != 0 && ret == 0) {
+        perror("fclose output file");
+        ret = -1;
+    }
+    if (out_fp && ret != 0) {
+        unlink(output_file);
+    }
+    free(buffer);
+    aes_gcm_reader_close(reader);
     return ret;
 }
 
 // Test function
 int main(int argc, char *argv[]) {
-    if (argc != 4) {
-        fprintf(stderr, "Usage: %s <input_file> <output_file> <key_hex>\n", argv[0]);
+    enum aes_gcm_io_backend backend = AES_GCM_IO_STDIO;
+    unsigned long long range_offset = 0, range_length = 0;
+    int decrypt = 0, range = 0, workers = 1, opt;
+
+    while ((opt = getopt(argc, argv, "b:dj:r:")) != -1) {
+        switch (opt) {
+            case 'b':
+                if (aes_gcm_io_backend_parse(optarg, &backend) != 0) {
+                    fprintf(stderr, "Unknown I/O backend %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'd':
+                decrypt = 1;
+                break;
+            case 'j':
+                workers = atoi(optarg);
+                break;
+            case 'r':
+                if (sscanf(optarg, "%llu:%llu", &range_offset, &range_length) != 2) {
+                    fprintf(stderr, "Range must be OFFSET:LENGTH\n");
+                    return 1;
+                }
+                range = 1;
+                break;
+            default:
+                argc = 0;
+                break;
+        }
+    }
+
+    if (argc - optind != 3) {
+        fprintf(stderr, "Usage: %s [-d] [-j workers | -b stdio|mmap|uring] "
+                "<input_file> <output_file> <key_hex>\n", argv[0]);
+        fprintf(stderr, "       %s -r offset:length <input_file> <output_file> <key_hex>\n",
+                argv[0]);
+        fprintf(stderr, "  -j 0 uses one cipher thread per CPU\n");
+        fprintf(stderr, "  -r decrypts only that plaintext range\n");
+        return 1;
+    }
+    if (workers != 1 && backend != AES_GCM_IO_STDIO) {
+        fprintf(stderr, "The pipeline (-j) only uses stdio\n");
         return 1;
     }
 
+    const char *input_file = argv[optind];
+    const char *output_file = argv[optind + 1];
     unsigned char key[AES_KEY_SIZE];
     
-    // Generate random key for demo
-    if (generate_random_key(key, AES_KEY_SIZE) != 0) {
-        fprintf(stderr, "Failed to generate key\n");
+    if (parse_hex_key(argv[optind + 2], key) != 0) {
+        fprintf(stderr, "Key must be %d hex digits\n", AES_KEY_SIZE * 2);
         return 1;
     }
 
-    printf("Encrypting file with AES-256-GCM...\n");
-    if (encrypt_file(argv[1], argv[2], key) == 0) {
-        printf("File encrypted successfully\n");
+    int ret;
+    if (range) {
+        decrypt = 1;
+        printf("Decrypting range with AES-256-GCM...\n");
+        ret = decrypt_range(input_file, output_file, key, range_offset, range_length);
+    } else if (decrypt) {
+        printf("Decrypting file with AES-256-GCM...\n");
+        ret = workers == 1 ? decrypt_file_io(input_file, output_file, key, backend) :
+                             decrypt_file_parallel(input_file, output_file, key, workers);
+    } else {
+        printf("Encrypting file with AES-256-GCM...\n");
+        ret = workers == 1 ? encrypt_file_io(input_file, output_file, key,
+                                             AES_GCM_DEFAULT_CHUNK_SIZE, backend) :
+                             encrypt_file_parallel(input_file, output_file, key,
+                                                   AES_GCM_DEFAULT_CHUNK_SIZE, workers);
+    }
+
+    if (ret == 0) {
+        printf("File %s successfully\n", decrypt ? "decrypted" : "encrypted");
         return 0;
     } else {
-        printf("Encryption failed\n");
+        printf("%s failed\n", decrypt ? "Decryption" : "Encryption");
         return 1;
     }
 }
+#endif
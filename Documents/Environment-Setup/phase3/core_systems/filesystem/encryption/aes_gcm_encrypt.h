@@ -0,0 +1,138 @@
+#ifndef AES_GCM_ENCRYPT_H
+#define AES_GCM_ENCRYPT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#define AES_KEY_SIZE 32
+#define AES_IV_SIZE 12
+#define AES_TAG_SIZE 16
+
+/* Encrypted file format. A 32-byte header, then the plaintext split into
+ * chunks of chunk_size bytes, each stored as its ciphertext followed by
+ * its 16-byte GCM tag. Every chunk but the last is full; the last one is
+ * shorter than chunk_size, possibly empty, so a file always ends with a
+ * final chunk and a truncated file is detected.
+ *
+ * Header (integers little endian):
+ *   0  magic "SOSAGCM1"
+ *   8  version (uint32)
+ *  12  chunk_size (uint32), 1..AES_GCM_MAX_CHUNK_SIZE
+ *  16  nonce base (12 random bytes)
+ *  28  reserved, zero (uint32)
+ *
+ * Chunk i is encrypted with nonce = base XOR i, the 64-bit big-endian
+ * index being XORed into the last 8 bytes. Its additional authenticated
+ * data is the whole header followed by one byte, 1 for the final chunk
+ * and 0 otherwise. Chunks can therefore be verified one at a time, and
+ * are bound to their file, position and finality: reordering, splicing,
+ * truncating or extending a file fails authentication. */
+
+#define AES_GCM_STREAM_MAGIC "SOSAGCM1"
+#define AES_GCM_STREAM_VERSION 1
+#define AES_GCM_HEADER_SIZE 32
+#define AES_GCM_DEFAULT_CHUNK_SIZE (64 * 1024)
+#define AES_GCM_MAX_CHUNK_SIZE (16 * 1024 * 1024)
+#define AES_GCM_MAX_WORKERS 64
+
+int generate_random_key(unsigned char *key, size_t key_len);
+
+/* Single-message encryption with a context keyed once: building one
+ * allocates it and runs the AES key schedule, after which each message
+ * only sets its IV, in either direction. A context is used by one thread
+ * at a time. The IV must never repeat under one key. encrypt/decrypt
+ * return the output length or -1; decryption fails when the tag does not
+ * verify, leaving plaintext unspecified. */
+struct aes_gcm_ctx;
+
+struct aes_gcm_ctx *aes_gcm_ctx_new(const unsigned char *key);
+void aes_gcm_ctx_free(struct aes_gcm_ctx *ctx);
+int aes_gcm_ctx_encrypt(struct aes_gcm_ctx *ctx, const unsigned char *plaintext,
+                        size_t plaintext_len, const unsigned char *iv,
+                        unsigned char *ciphertext, unsigned char *tag);
+int aes_gcm_ctx_decrypt(struct aes_gcm_ctx *ctx, const unsigned char *ciphertext,
+                        size_t ciphertext_len, const unsigned char *iv,
+                        const unsigned char *tag, unsigned char *plaintext);
+
+/* The calling thread's context for key, from a pool of the
+ * AES_GCM_CTX_POOL_SIZE keys it used most recently; NULL on failure. The
+ * context belongs to the pool: it stays valid until this thread uses
+ * that many other keys, flushes its pool or exits, when it is freed and
+ * the copy of the key wiped. */
+#define AES_GCM_CTX_POOL_SIZE 4
+
+struct aes_gcm_ctx *aes_gcm_ctx_cached(const unsigned char *key);
+void aes_gcm_ctx_pool_flush(void);
+
+/* One-shot encryption of a single buffer through the calling thread's
+ * pool; return the output length or -1 */
+int encrypt_file_data(const unsigned char *plaintext, size_t plaintext_len,
+                     const unsigned char *key, const unsigned char *iv,
+                     unsigned char *ciphertext, unsigned char *tag);
+int decrypt_file_data(const unsigned char *ciphertext, size_t ciphertext_len,
+                     const unsigned char *key, const unsigned char *iv,
+                     const unsigned char *tag, unsigned char *plaintext);
+
+/* Whole files in the format above, in one pass with one cipher context.
+ * encrypt_file() uses AES_GCM_DEFAULT_CHUNK_SIZE. decrypt_file() writes
+ * only chunks that have been verified. Both return 0 or -1, and remove
+ * the output file on failure. */
+int encrypt_file(const char *input_file, const char *output_file, const unsigned char *key);
+int encrypt_file_chunked(const char *input_file, const char *output_file,
+                         const unsigned char *key, size_t chunk_size);
+int decrypt_file(const char *input_file, const char *output_file, const unsigned char *key);
+
+/* The same, pipelined: a reader thread, workers cipher threads (0 for one
+ * per online CPU) each with its own context, and the calling thread
+ * writing chunks out in order. Memory is bounded by a pool of a few
+ * chunk buffers per worker. Output is identical in format, and
+ * decrypt_file_parallel() still writes only verified chunks. */
+int encrypt_file_parallel(const char *input_file, const char *output_file,
+                          const unsigned char *key, size_t chunk_size, int workers);
+int decrypt_file_parallel(const char *input_file, const char *output_file,
+                          const unsigned char *key, int workers);
+
+/* I/O strategies for the single-threaded path, chosen at run time:
+ * stdio streams (encrypt_file_chunked()/decrypt_file()), mmap of input
+ * and output with chunks encrypted from one mapping into the other, or
+ * io_uring with registered chunk buffers, several chunks in flight and
+ * O_DIRECT input reads when encrypting with a 4 KiB-multiple chunk size
+ * (where the filesystem supports it). Same format and guarantees, except
+ * that mmap and io_uring need regular files; decrypting with mmap puts
+ * plaintext in the output mapping before its chunk is verified, and the
+ * output is still removed if any chunk fails. */
+enum aes_gcm_io_backend {
+    AES_GCM_IO_STDIO,
+    AES_GCM_IO_MMAP,
+    AES_GCM_IO_URING,
+};
+
+/* "stdio", "mmap" or "uring"/"io_uring"; -1 for anything else */
+int aes_gcm_io_backend_parse(const char *name, enum aes_gcm_io_backend *backend);
+const char *aes_gcm_io_backend_name(enum aes_gcm_io_backend backend);
+int encrypt_file_io(const char *input_file, const char *output_file, const unsigned char *key,
+                    size_t chunk_size, enum aes_gcm_io_backend backend);
+int decrypt_file_io(const char *input_file, const char *output_file, const unsigned char *key,
+                    enum aes_gcm_io_backend backend);
+
+/* Random access to an encrypted file: aes_gcm_pread() decrypts len bytes
+ * of plaintext at offset into buf, reading and verifying only the chunks
+ * that cover them, and returns the count (short at end of file, 0 past
+ * it) or -1 when a chunk fails authentication or cannot be read. Up to
+ * cache_chunks decrypted chunks (0 for AES_GCM_READER_DEFAULT_CACHE) are
+ * kept for reads that use part of a chunk; each costs chunk_size bytes.
+ * Opening verifies the final chunk, so aes_gcm_reader_size() can be
+ * trusted. Calls on one reader are serialized. */
+#define AES_GCM_READER_DEFAULT_CACHE 8
+#define AES_GCM_READER_MAX_CACHE 256
+
+struct aes_gcm_reader;
+
+struct aes_gcm_reader *aes_gcm_reader_open(const char *path, const unsigned char *key,
+                                           size_t cache_chunks);
+uint64_t aes_gcm_reader_size(const struct aes_gcm_reader *reader);
+ssize_t aes_gcm_pread(struct aes_gcm_reader *reader, void *buf, size_t len, uint64_t offset);
+void aes_gcm_reader_close(struct aes_gcm_reader *reader);
+
+#endif /* AES_GCM_ENCRYPT_H */
@@ -0,0 +1,713 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include <openssl/evp.h>
+#include "aes_gcm_encrypt.h"
+#include "aes_gcm_stream.h"
+
+/* Alternative I/O paths for the single-threaded encryptor, producing the
+ * same file format as encrypt_file_chunked()/decrypt_file().
+ *
+ * mmap: the input is mapped read-only and the output is sized up front
+ * and mapped shared, so each chunk is encrypted straight from one mapping
+ * into the other with no buffer in between.
+ *
+ * io_uring: AES_GCM_URING_DEPTH chunk buffers, registered with the ring,
+ * each cycle through read -> encrypt in place -> write, reads and writes
+ * being READ_FIXED/WRITE_FIXED at explicit offsets, so several chunks are
+ * in flight and completions may arrive in any order. When encrypting, a
+ * chunk size that is a multiple of AES_GCM_DIRECT_ALIGN lets the input be
+ * read with O_DIRECT, bypassing the page cache; output offsets are never
+ * aligned (the header and tags shift them), so writes stay buffered. No
+ * liburing: the ring is driven with the raw syscalls. */
+
+#define AES_GCM_URING_DEPTH 8
+#define AES_GCM_DIRECT_ALIGN 4096
+
+int aes_gcm_io_backend_parse(const char *name, enum aes_gcm_io_backend *backend) {
+    if (strcmp(name, "stdio") == 0) {
+        *backend = AES_GCM_IO_STDIO;
+    } else if (strcmp(name, "mmap") == 0) {
+        *backend = AES_GCM_IO_MMAP;
+    } else if (strcmp(name, "uring") == 0 || strcmp(name, "io_uring") == 0) {
+        *backend = AES_GCM_IO_URING;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+const char *aes_gcm_io_backend_name(enum aes_gcm_io_backend backend) {
+    switch (backend) {
+        case AES_GCM_IO_STDIO: return "stdio";
+        case AES_GCM_IO_MMAP: return "mmap";
+        case AES_GCM_IO_URING: return "io_uring";
+    }
+    return "unknown";
+}
+
+static int open_input(const char *input_file, int flags, uint64_t *size) {
+    struct stat st;
+    int fd = open(input_file, O_RDONLY | O_CLOEXEC | flags);
+
+    if (fd < 0) {
+        return -1;
+    }
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+    if (!S_ISREG(st.st_mode)) {
+        close(fd);
+        errno = EINVAL;
+        return -1;
+    }
+    *size = st.st_size;
+    return fd;
+}
+
+// Creates the output at its final size, blocks allocated, so that a full
+// disk fails here rather than as SIGBUS on a mapped write
+static int create_output(const char *output_file, int flags, uint64_t size) {
+    int fd = open(output_file, O_CREAT | O_TRUNC | O_CLOEXEC | flags, 0666);
+
+    if (fd < 0) {
+        perror("open output file");
+        return -1;
+    }
+    if (size > 0) {
+        int err = posix_fallocate(fd, 0, size);
+        if (err == EOPNOTSUPP || err == EINVAL) {
+            err = ftruncate(fd, size) == 0 ? 0 : errno;
+        }
+        if (err != 0) {
+            fprintf(stderr, "Cannot size output file: %s\n", strerror(err));
+            close(fd);
+            unlink(output_file);
+            return -1;
+        }
+    }
+    return fd;
+}
+
+static int finish_output(int fd, const char *output_file, int ret) {
+    if (close(fd) != 0 && ret == 0) {
+        perror("close output file");
+        ret = -1;
+    }
+    if (ret != 0) {
+        unlink(output_file);
+    }
+    return ret;
+}
+
+static int read_header(int fd, unsigned char *header, size_t *chunk_size) {
+    if (pread(fd, header, AES_GCM_HEADER_SIZE, 0) != AES_GCM_HEADER_SIZE) {
+        fprintf(stderr, "Encrypted file too short\n");
+        return -1;
+    }
+    return aes_gcm_parse_header(header, chunk_size);
+}
+
+// Maps size bytes of fd, NULL for an empty range
+static unsigned char *map_file(int fd, uint64_t size, int writable) {
+    if (size == 0) {
+        return NULL;
+    }
+    void *map = mmap(NULL, size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        perror("mmap");
+        return MAP_FAILED;
+    }
+    madvise(map, size, MADV_SEQUENTIAL);
+    return map;
+}
+
+static int mmap_encrypt(const char *input_file, const char *output_file,
+                        const unsigned char *key, size_t chunk_size) {
+    unsigned char header[AES_GCM_HEADER_SIZE];
+    unsigned char *in = MAP_FAILED, *out = MAP_FAILED;
+    EVP_CIPHER_CTX *ctx = NULL;
+    uint64_t in_size, out_size, chunks;
+    int ret = -1;
+
+    int in_fd = open_input(input_file, 0, &in_size);
+    if (in_fd < 0) {
+        perror("open input file");
+        return -1;
+    }
+
+    out_size = aes_gcm_encrypted_size(in_size, chunk_size, &chunks);
+    int out_fd = create_output(output_file, O_RDWR, out_size);
+    if (out_fd < 0) {
+        close(in_fd);
+        return -1;
+    }
+
+    in = map_file(in_fd, in_size, 0);
+    out = map_file(out_fd, out_size, 1);
+    ctx = aes_gcm_stream_ctx(key, 1);
+    if (in == MAP_FAILED || out == MAP_FAILED || !ctx ||
+        aes_gcm_build_header(header, chunk_size) != 0) {
+        goto cleanup;
+    }
+
+    memcpy(out, header, AES_GCM_HEADER_SIZE);
+    for (uint64_t index = 0; index < chunks; index++) {
+        int final = index == chunks - 1;
+        size_t len = final ? in_size - index * chunk_size : chunk_size;
+        unsigned char *record = out + AES_GCM_HEADER_SIZE + index * (chunk_size + AES_TAG_SIZE);
+
+        if (aes_gcm_encrypt_chunk(ctx, header, index, final, in ? in + index * chunk_size : NULL,
+                                  record, len, record + len) != 0) {
+            goto cleanup;
+        }
+    }
+    ret = 0;
+
+cleanup:
+    if (ctx) EVP_CIPHER_CTX_free(ctx);
+    if (in && in != MAP_FAILED) munmap(in, in_size);
+    if (out && out != MAP_FAILED) munmap(out, out_size);
+    close(in_fd);
+    return finish_output(out_fd, output_file, ret);
+}
+
+/* Plaintext lands in the output mapping before its tag is checked; on a
+ * failure the output file is removed, as with the other paths */
+static int mmap_decrypt(const char *input_file, const char *output_file,
+                        const unsigned char *key) {
+    unsigned char header[AES_GCM_HEADER_SIZE];
+    unsigned char *in = MAP_FAILED, *out = MAP_FAILED;
+    EVP_CIPHER_CTX *ctx = NULL;
+    uint64_t in_size, out_size, chunks;
+    size_t chunk_size;
+    int ret = -1;
+
+    int in_fd = open_input(input_file, 0, &in_size);
+    if (in_fd < 0) {
+        perror("open input file");
+        return -1;
+    }
+    if (read_header(in_fd, header, &chunk_size) != 0) {
+        close(in_fd);
+        return -1;
+    }
+    if (aes_gcm_plain_size(in_size, chunk_size, &out_size, &chunks) != 0) {
+        fprintf(stderr, "Encrypted file truncated\n");
+        close(in_fd);
+        return -1;
+    }
+
+    int out_fd = create_output(output_file, O_RDWR, out_size);
+    if (out_fd < 0) {
+        close(in_fd);
+        return -1;
+    }
+
+    in = map_file(in_fd, in_size, 0);
+    out = map_file(out_fd, out_size, 1);
+    ctx = aes_gcm_stream_ctx(key, 0);
+    if (in == MAP_FAILED || out == MAP_FAILED || !ctx) {
+        goto cleanup;
+    }
+
+    for (uint64_t index = 0; index < chunks; index++) {
+        int final = index == chunks - 1;
+        size_t len = final ? out_size - index * chunk_size : chunk_size;
+        const unsigned char *record = in + AES_GCM_HEADER_SIZE +
+                                      index * (chunk_size + AES_TAG_SIZE);
+
+        if (aes_gcm_decrypt_chunk(ctx, header, index, final, record,
+                                  out ? out + index * chunk_size : NULL, len, record + len) != 0) {
+            goto cleanup;
+        }
+    }
+    ret = 0;
+
+cleanup:
+    if (ctx) EVP_CIPHER_CTX_free(ctx);
+    if (in && in != MAP_FAILED) munmap(in, in_size);
+    if (out && out != MAP_FAILED) munmap(out, out_size);
+    close(in_fd);
+    return finish_output(out_fd, output_file, ret);
+}
+
+struct uring {
+    int fd;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *sq_ring;
+    void *cq_ring;
+    size_t sq_ring_size;
+    size_t cq_ring_size;
+    size_t sqes_size;
+    unsigned queued;            // SQEs filled in since the last submit
+    unsigned inflight;          // Requests whose completion is not reaped yet
+};
+
+static int uring_init(struct uring *ring, unsigned entries) {
+    struct io_uring_params params;
+
+    memset(ring, 0, sizeof(*ring));
+    memset(&params, 0, sizeof(params));
+    ring->fd = syscall(__NR_io_uring_setup, entries, &params);
+    if (ring->fd < 0) {
+        return -1;
+    }
+
+    ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+
+    ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if (ring->sq_ring == MAP_FAILED || ring->cq_ring == MAP_FAILED || ring->sqes == MAP_FAILED) {
+        int err = errno;
+        if (ring->sq_ring != MAP_FAILED) munmap(ring->sq_ring, ring->sq_ring_size);
+        if (ring->cq_ring != MAP_FAILED) munmap(ring->cq_ring, ring->cq_ring_size);
+        if (ring->sqes != MAP_FAILED) munmap(ring->sqes, ring->sqes_size);
+        close(ring->fd);
+        errno = err;
+        return -1;
+    }
+
+    unsigned char *sq = ring->sq_ring, *cq = ring->cq_ring;
+    ring->sq_tail = (unsigned *)(sq + params.sq_off.tail);
+    ring->sq_mask = (unsigned *)(sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned *)(sq + params.sq_off.array);
+    ring->cq_head = (unsigned *)(cq + params.cq_off.head);
+    ring->cq_tail = (unsigned *)(cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned *)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+    return 0;
+}
+
+static void uring_exit(struct uring *ring) {
+    munmap(ring->sqes, ring->sqes_size);
+    munmap(ring->cq_ring, ring->cq_ring_size);
+    munmap(ring->sq_ring, ring->sq_ring_size);
+    close(ring->fd);
+}
+
+// Queues a fixed-buffer read or write; the ring never holds more than
+// AES_GCM_URING_DEPTH requests, so there is always room
+static void uring_queue(struct uring *ring, int opcode, int fd, void *addr, unsigned len,
+                        uint64_t offset, unsigned buf_index, uint64_t user_data) {
+    unsigned tail = *ring->sq_tail;
+    unsigned slot = tail & *ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[slot];
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = opcode;
+    sqe->fd = fd;
+    sqe->addr = (uintptr_t)addr;
+    sqe->len = len;
+    sqe->off = offset;
+    sqe->buf_index = buf_index;
+    sqe->user_data = user_data;
+    ring->sq_array[slot] = slot;
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    ring->queued++;
+    ring->inflight++;
+}
+
+// Submits what is queued and waits for at least one completion
+static int uring_wait(struct uring *ring) {
+    for (;;) {
+        int ret = syscall(__NR_io_uring_enter, ring->fd, ring->queued, 1,
+                          IORING_ENTER_GETEVENTS, NULL, 0);
+        if (ret >= 0) {
+            ring->queued -= ret;
+            return 0;
+        }
+        if (errno != EINTR) {
+            return -1;
+        }
+    }
+}
+
+enum uring_stage {
+    STAGE_READ,
+    STAGE_WRITE,
+};
+
+struct uring_slot {
+    unsigned char *buf;
+    uint64_t index;             // Chunk number
+    size_t len;                 // Payload bytes, tag excluded
+    size_t done;                // Of the current transfer
+    enum uring_stage stage;
+};
+
+struct uring_job {
+    int encrypt;
+    int in_fd;
+    int out_fd;
+    int direct;                 // in_fd was opened with O_DIRECT
+    EVP_CIPHER_CTX *ctx;
+    unsigned char header[AES_GCM_HEADER_SIZE];
+    size_t chunk_size;
+    uint64_t chunks;
+    uint64_t last_len;          // Payload of the final chunk
+    struct uring ring;
+    struct uring_slot slots[AES_GCM_URING_DEPTH];
+};
+
+static uint64_t input_offset(const struct uring_job *job, uint64_t index) {
+    return job->encrypt ? index * job->chunk_size :
+                          AES_GCM_HEADER_SIZE + index * (job->chunk_size + AES_TAG_SIZE);
+}
+
+static uint64_t output_offset(const struct uring_job *job, uint64_t index) {
+    return job->encrypt ? AES_GCM_HEADER_SIZE + index * (job->chunk_size + AES_TAG_SIZE) :
+                          index * job->chunk_size;
+}
+
+// Bytes to read and write for a slot; the tag is on the ciphertext side
+static size_t read_size(const struct uring_job *job, const struct uring_slot *slot) {
+    return slot->len + (job->encrypt ? 0 : AES_TAG_SIZE);
+}
+
+static size_t write_size(const struct uring_job *job, const struct uring_slot *slot) {
+    return slot->len + (job->encrypt ? AES_TAG_SIZE : 0);
+}
+
+// Where a read resumes: O_DIRECT needs an aligned buffer, offset and
+// length, so after a short read the partial block is read again
+static size_t read_resume(const struct uring_job *job, const struct uring_slot *slot) {
+    return job->direct ? slot->done & ~(size_t)(AES_GCM_DIRECT_ALIGN - 1) : slot->done;
+}
+
+static void queue_transfer(struct uring_job *job, int id) {
+    struct uring_slot *slot = &job->slots[id];
+
+    if (slot->stage == STAGE_READ) {
+        size_t from = read_resume(job, slot);
+        size_t want = read_size(job, slot) - from;
+        // O_DIRECT transfers whole blocks; the file just ends inside the last one
+        if (job->direct) {
+            want = (want + AES_GCM_DIRECT_ALIGN - 1) & ~(size_t)(AES_GCM_DIRECT_ALIGN - 1);
+        }
+        uring_queue(&job->ring, IORING_OP_READ_FIXED, job->in_fd, slot->buf + from, want,
+                    input_offset(job, slot->index) + from, id, id);
+    } else {
+        uring_queue(&job->ring, IORING_OP_WRITE_FIXED, job->out_fd, slot->buf + slot->done,
+                    write_size(job, slot) - slot->done,
+                    output_offset(job, slot->index) + slot->done, id, id);
+    }
+}
+
+// Runs the cipher over a slot that has been read in full and moves it
+// on to writing; returns 1 when there is nothing to write
+static int process_chunk(struct uring_job *job, int id) {
+    struct uring_slot *slot = &job->slots[id];
+    int final = slot->index == job->chunks - 1;
+    int ret = job->encrypt ?
+        aes_gcm_encrypt_chunk(job->ctx, job->header, slot->index, final, slot->buf,
+                              slot->buf, slot->len, slot->buf + slot->len) :
+        aes_gcm_decrypt_chunk(job->ctx, job->header, slot->index, final, slot->buf,
+                              slot->buf, slot->len, slot->buf + slot->len);
+    if (ret != 0) {
+        return -1;
+    }
+
+    slot->stage = STAGE_WRITE;
+    slot->done = 0;
+    // Decrypting, an empty final chunk has no plaintext to write
+    if (write_size(job, slot) == 0) {
+        return 1;
+    }
+    queue_transfer(job, id);
+    return 0;
+}
+
+// Returns 1 when the chunk needed no I/O at all
+static int start_chunk(struct uring_job *job, int id, uint64_t index) {
+    struct uring_slot *slot = &job->slots[id];
+
+    slot->index = index;
+    slot->len = index == job->chunks - 1 ? job->last_len : job->chunk_size;
+    slot->done = 0;
+    slot->stage = STAGE_READ;
+    // Encrypting, an empty final chunk has nothing to read
+    if (read_size(job, slot) == 0) {
+        return process_chunk(job, id);
+    }
+    queue_transfer(job, id);
+    return 0;
+}
+
+// Handles one completion; returns 1 when the slot's chunk is written out
+static int complete(struct uring_job *job, int id, int res) {
+    struct uring_slot *slot = &job->slots[id];
+
+    if (res < 0) {
+        fprintf(stderr, "io_uring %s failed: %s\n", slot->stage == STAGE_READ ? "read" : "write",
+                strerror(-res));
+        return -1;
+    }
+
+    if (slot->stage == STAGE_READ) {
+        slot->done = read_resume(job, slot); // Where this read was issued
+    }
+    slot->done += res;
+    if (slot->stage == STAGE_READ) {
+        if (res == 0) {
+            fprintf(stderr, "Input file shrank while being read\n");
+            return -1;
+        }
+        if (slot->done < read_size(job, slot)) {
+            queue_transfer(job, id);
+            return 0;
+        }
+        return process_chunk(job, id);
+    }
+
+    if (slot->done < write_size(job, slot)) {
+        queue_transfer(job, id);
+        return 0;
+    }
+    return 1;
+}
+
+/* Reaps every completion available. Chunks that are done make room for
+ * the next ones; after a failure, completions are only drained. */
+static int reap(struct uring_job *job, uint64_t *next, uint64_t *finished, int failed) {
+    unsigned head = *job->ring.cq_head;
+    unsigned tail = __atomic_load_n(job->ring.cq_tail, __ATOMIC_ACQUIRE);
+
+    for (; head != tail; head++) {
+        struct io_uring_cqe *cqe = &job->ring.cqes[head & *job->ring.cq_mask];
+        int id = (int)cqe->user_data;
+        int done = failed ? 0 : complete(job, id, cqe->res);
+
+        job->ring.inflight--;
+        // The next chunk may complete without I/O as well
+        while (done > 0) {
+            (*finished)++;
+            done = *next < job->chunks ? start_chunk(job, id, (*next)++) : 0;
+        }
+        if (done < 0) {
+            failed = 1;
+        }
+    }
+    __atomic_store_n(job->ring.cq_head, head, __ATOMIC_RELEASE);
+    return failed ? -1 : 0;
+}
+
+static int run_uring(struct uring_job *job) {
+    struct iovec iov[AES_GCM_URING_DEPTH];
+    size_t capacity = (job->chunk_size + AES_TAG_SIZE + AES_GCM_DIRECT_ALIGN - 1) &
+                      ~(size_t)(AES_GCM_DIRECT_ALIGN - 1);
+    int depth = job->chunks < AES_GCM_URING_DEPTH ? (int)job->chunks : AES_GCM_URING_DEPTH;
+    int ret = -1;
+
+    if (uring_init(&job->ring, AES_GCM_URING_DEPTH) != 0) {
+        perror("io_uring_setup");
+        return -1;
+    }
+
+    for (int i = 0; i < depth; i++) {
+        job->slots[i].buf = aligned_alloc(AES_GCM_DIRECT_ALIGN, capacity);
+        if (!job->slots[i].buf) {
+            fprintf(stderr, "Failed to allocate io_uring buffers\n");
+            goto cleanup;
+        }
+        iov[i].iov_base = job->slots[i].buf;
+        iov[i].iov_len = capacity;
+    }
+    if (syscall(__NR_io_uring_register, job->ring.fd, IORING_REGISTER_BUFFERS, iov, depth) != 0) {
+        perror("io_uring_register");
+        goto cleanup;
+    }
+
+    uint64_t next = 0, finished = 0;
+    int failed = 0;
+    for (int i = 0; i < depth && !failed; i++) {
+        int done = start_chunk(job, i, next++);
+        while (done > 0) {
+            finished++;
+            done = next < job->chunks ? start_chunk(job, i, next++) : 0;
+        }
+        failed = done < 0;
+    }
+
+    // After a failure, wait for the kernel to be done with every buffer
+    while (failed ? job->ring.inflight > 0 : finished < job->chunks) {
+        if (uring_wait(&job->ring) != 0) {
+            perror("io_uring_enter");
+            failed = 1;
+            break;
+        }
+        if (reap(job, &next, &finished, failed) != 0) {
+            failed = 1;
+        }
+    }
+    ret = failed ? -1 : 0;
+
+cleanup:
+    uring_exit(&job->ring);
+    for (int i = 0; i < depth; i++) {
+        free(job->slots[i].buf);
+    }
+    return ret;
+}
+
+static int uring_encrypt(const char *input_file, const char *output_file,
+                         const unsigned char *key, size_t chunk_size) {
+    struct uring_job *job = calloc(1, sizeof(*job));
+    uint64_t in_size;
+    int ret = -1;
+
+    if (!job) {
+        return -1;
+    }
+    job->encrypt = 1;
+    job->chunk_size = chunk_size;
+
+    // Page cache bypass where the filesystem and the alignment allow it
+    job->in_fd = -1;
+    if (chunk_size % AES_GCM_DIRECT_ALIGN == 0) {
+        job->in_fd = open_input(input_file, O_DIRECT, &in_size);
+        job->direct = job->in_fd >= 0;
+    }
+    if (job->in_fd < 0) {
+        job->in_fd = open_input(input_file, 0, &in_size);
+    }
+    if (job->in_fd < 0) {
+        perror("open input file");
+        free(job);
+        return -1;
+    }
+
+    uint64_t out_size = aes_gcm_encrypted_size(in_size, chunk_size, &job->chunks);
+    job->last_len = in_size - (job->chunks - 1) * chunk_size;
+    job->out_fd = create_output(output_file, O_WRONLY, out_size);
+    if (job->out_fd < 0) {
+        close(job->in_fd);
+        free(job);
+        return -1;
+    }
+
+    job->ctx = aes_gcm_stream_ctx(key, 1);
+    if (job->ctx && aes_gcm_build_header(job->header, chunk_size) == 0) {
+        if (pwrite(job->out_fd, job->header, AES_GCM_HEADER_SIZE, 0) == AES_GCM_HEADER_SIZE) {
+            ret = run_uring(job);
+        } else {
+            perror("write header");
+        }
+    }
+
+    if (job->ctx) EVP_CIPHER_CTX_free(job->ctx);
+    close(job->in_fd);
+    ret = finish_output(job->out_fd, output_file, ret);
+    free(job);
+    return ret;
+}
+
+static int uring_decrypt(const char *input_file, const char *output_file,
+                         const unsigned char *key) {
+    struct uring_job *job = calloc(1, sizeof(*job));
+    uint64_t in_size, out_size;
+    int ret = -1;
+
+    if (!job) {
+        return -1;
+    }
+
+    job->in_fd = open_input(input_file, 0, &in_size);
+    if (job->in_fd < 0) {
+        perror("open input file");
+        free(job);
+        return -1;
+    }
+    if (read_header(job->in_fd, job->header, &job->chunk_size) != 0) {
+        close(job->in_fd);
+        free(job);
+        return -1;
+    }
+    if (aes_gcm_plain_size(in_size, job->chunk_size, &out_size, &job->chunks) != 0) {
+        fprintf(stderr, "Encrypted file truncated\n");
+        close(job->in_fd);
+        free(job);
+        return -1;
+    }
+    job->last_len = out_size - (job->chunks - 1) * job->chunk_size;
+
+    job->out_fd = create_output(output_file, O_WRONLY, out_size);
+    if (job->out_fd < 0) {
+        close(job->in_fd);
+        free(job);
+        return -1;
+    }
+
+    job->ctx = aes_gcm_stream_ctx(key, 0);
+    if (job->ctx) {
+        ret = run_uring(job);
+    }
+
+    if (job->ctx) EVP_CIPHER_CTX_free(job->ctx);
+    close(job->in_fd);
+    ret = finish_output(job->out_fd, output_file, ret);
+    free(job);
+    return ret;
+}
+
+int encrypt_file_io(const char *input_file, const char *output_file, const unsigned char *key,
+                    size_t chunk_size, enum aes_gcm_io_backend backend) {
+    if (!input_file || !output_file || !key ||
+        chunk_size == 0 || chunk_size > AES_GCM_MAX_CHUNK_SIZE) {
+        fprintf(stderr, "Invalid parameters to encrypt_file_io\n");
+        return -1;
+    }
+
+    switch (backend) {
+        case AES_GCM_IO_STDIO:
+            return encrypt_file_chunked(input_file, output_file, key, chunk_size);
+        case AES_GCM_IO_MMAP:
+            return mmap_encrypt(input_file, output_file, key, chunk_size);
+        case AES_GCM_IO_URING:
+            return uring_encrypt(input_file, output_file, key, chunk_size);
+    }
+    fprintf(stderr, "Unknown I/O backend %d\n", backend);
+    return -1;
+}
+
+int decrypt_file_io(const char *input_file, const char *output_file, const unsigned char *key,
+                    enum aes_gcm_io_backend backend) {
+    if (!input_file || !output_file || !key) {
+        fprintf(stderr, "Invalid parameters to decrypt_file_io\n");
+        return -1;
+    }
+
+    switch (backend) {
+        case AES_GCM_IO_STDIO:
+            return decrypt_file(input_file, output_file, key);
+        case AES_GCM_IO_MMAP:
+            return mmap_decrypt(input_file, output_file, key);
+        case AES_GCM_IO_URING:
+            return uring_decrypt(input_file, output_file, key);
+    }
+    fprintf(stderr, "Unknown I/O backend %d\n", backend);
+    return -1;
+}
@@ -0,0 +1,383 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <openssl/evp.h>
+#include "aes_gcm_encrypt.h"
+#include "aes_gcm_stream.h"
+
+/* Pipelined encryption and decryption of whole files. A reader thread
+ * fills buffers with chunks (records, when decrypting) and queues them
+ * in file order; cipher workers, each with its own keyed context, take
+ * them off the queue and work in place; the calling thread writes them
+ * out strictly in order and hands the buffers back to the reader.
+ *
+ * The pool holds AES_GCM_BUFFERS_PER_WORKER buffers per worker, which
+ * bounds memory and lets a slow disk or a slow chunk hold the reader
+ * back. Chunks in flight always have consecutive indices starting at the
+ * one the writer waits for, so index % buffer_count is a unique slot in
+ * the done table. Any failure sets failed and wakes every thread. */
+
+#define AES_GCM_BUFFERS_PER_WORKER 4
+
+struct pipeline_buffer {
+    unsigned char *data;        // chunk_size + AES_TAG_SIZE bytes
+    size_t len;                 // Payload, tag excluded
+    uint64_t index;
+    int final;
+    int next;                   // Free list or work queue link, -1 at the end
+};
+
+struct pipeline {
+    int encrypt;
+    FILE *in_fp;
+    FILE *out_fp;
+    const unsigned char *key;
+    unsigned char header[AES_GCM_HEADER_SIZE];
+    size_t chunk_size;
+
+    struct pipeline_buffer *buffers;
+    int buffer_count;
+    int *done;                  // By index % buffer_count: buffer ready to write, or -1
+
+    pthread_mutex_t lock;
+    pthread_cond_t free_cond;   // Reader: a buffer was freed
+    pthread_cond_t work_cond;   // Workers: a chunk was queued, or the input ended
+    pthread_cond_t done_cond;   // Writer: a chunk is ready
+    int free_head;
+    int work_head;
+    int work_tail;
+    int input_done;             // The final chunk has been queued
+    int failed;
+};
+
+static void pipeline_fail(struct pipeline *p) {
+    pthread_mutex_lock(&p->lock);
+    p->failed = 1;
+    pthread_cond_broadcast(&p->free_cond);
+    pthread_cond_broadcast(&p->work_cond);
+    pthread_cond_broadcast(&p->done_cond);
+    pthread_mutex_unlock(&p->lock);
+}
+
+// Fills one buffer from the input; -1 on a read error or a truncated file
+static int read_chunk(struct pipeline *p, struct pipeline_buffer *buf) {
+    size_t want = p->chunk_size + (p->encrypt ? 0 : AES_TAG_SIZE);
+    size_t bytes_read = fread(buf->data, 1, want, p->in_fp);
+
+    if (ferror(p->in_fp)) {
+        perror("fread input file");
+        return -1;
+    }
+
+    if (p->encrypt) {
+        buf->len = bytes_read;
+    } else {
+        if (bytes_read < AES_TAG_SIZE) {
+            fprintf(stderr, "Encrypted file truncated at chunk %llu\n",
+                    (unsigned long long)buf->index);
+            return -1;
+        }
+        buf->len = bytes_read - AES_TAG_SIZE;
+    }
+    // Only the final chunk is short, whichever way we are going
+    buf->final = buf->len < p->chunk_size;
+    return 0;
+}
+
+static void *reader_main(void *arg) {
+    struct pipeline *p = arg;
+
+    for (uint64_t index = 0; ; index++) {
+        pthread_mutex_lock(&p->lock);
+        while (p->free_head < 0 && !p->failed) {
+            pthread_cond_wait(&p->free_cond, &p->lock);
+        }
+        if (p->failed) {
+            pthread_mutex_unlock(&p->lock);
+            break;
+        }
+        int id = p->free_head;
+        struct pipeline_buffer *buf = &p->buffers[id];
+        p->free_head = buf->next;
+        pthread_mutex_unlock(&p->lock);
+
+        buf->index = index;
+        if (read_chunk(p, buf) != 0) {
+            pipeline_fail(p);
+            break;
+        }
+
+        pthread_mutex_lock(&p->lock);
+        buf->next = -1;
+        if (p->work_tail >= 0) {
+            p->buffers[p->work_tail].next = id;
+        } else {
+            p->work_head = id;
+        }
+        p->work_tail = id;
+        p->input_done = buf->final;
+        pthread_cond_signal(&p->work_cond);
+        if (buf->final) {
+            pthread_cond_broadcast(&p->work_cond);
+        }
+        pthread_mutex_unlock(&p->lock);
+
+        if (buf->final) {
+            break;
+        }
+    }
+    return NULL;
+}
+
+static void *worker_main(void *arg) {
+    struct pipeline *p = arg;
+    EVP_CIPHER_CTX *ctx = aes_gcm_stream_ctx(p->key, p->encrypt);
+
+    if (!ctx) {
+        pipeline_fail(p);
+        return NULL;
+    }
+
+    for (;;) {
+        pthread_mutex_lock(&p->lock);
+        while (p->work_head < 0 && !p->input_done && !p->failed) {
+            pthread_cond_wait(&p->work_cond, &p->lock);
+        }
+        if (p->failed || p->work_head < 0) {
+            pthread_mutex_unlock(&p->lock);
+            break;
+        }
+        int id = p->work_head;
+        struct pipeline_buffer *buf = &p->buffers[id];
+        p->work_head = buf->next;
+        if (p->work_head < 0) {
+            p->work_tail = -1;
+        }
+        pthread_mutex_unlock(&p->lock);
+
+        int ret = p->encrypt ?
+            aes_gcm_encrypt_chunk(ctx, p->header, buf->index, buf->final, buf->data, buf->data,
+                                  buf->len, buf->data + buf->len) :
+            aes_gcm_decrypt_chunk(ctx, p->header, buf->index, buf->final, buf->data, buf->data,
+                                  buf->len, buf->data + buf->len);
+        if (ret != 0) {
+            pipeline_fail(p);
+            break;
+        }
+
+        pthread_mutex_lock(&p->lock);
+        p->done[buf->index % p->buffer_count] = id;
+        pthread_cond_signal(&p->done_cond);
+        pthread_mutex_unlock(&p->lock);
+    }
+
+    EVP_CIPHER_CTX_free(ctx);
+    return NULL;
+}
+
+// On the calling thread: writes chunks in order until the final one
+static int write_chunks(struct pipeline *p) {
+    size_t tag = p->encrypt ? AES_TAG_SIZE : 0;
+
+    for (uint64_t next = 0; ; next++) {
+        int slot = next % p->buffer_count;
+
+        pthread_mutex_lock(&p->lock);
+        while (p->done[slot] < 0 && !p->failed) {
+            pthread_cond_wait(&p->done_cond, &p->lock);
+        }
+        if (p->failed) {
+            pthread_mutex_unlock(&p->lock);
+            return -1;
+        }
+        int id = p->done[slot];
+        p->done[slot] = -1;
+        pthread_mutex_unlock(&p->lock);
+
+        struct pipeline_buffer *buf = &p->buffers[id];
+        if (fwrite(buf->data, 1, buf->len + tag, p->out_fp) != buf->len + tag) {
+            perror("fwrite output file");
+            pipeline_fail(p);
+            return -1;
+        }
+        if (buf->final) {
+            return 0;
+        }
+
+        pthread_mutex_lock(&p->lock);
+        buf->next = p->free_head;
+        p->free_head = id;
+        pthread_cond_signal(&p->free_cond);
+        pthread_mutex_unlock(&p->lock);
+    }
+}
+
+static int run_pipeline(struct pipeline *p, int workers) {
+    pthread_t reader, threads[AES_GCM_MAX_WORKERS];
+    int started = 0, ret = -1;
+
+    if (workers <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        workers = cpus > 0 ? (int)cpus : 1;
+    }
+    if (workers > AES_GCM_MAX_WORKERS) {
+        workers = AES_GCM_MAX_WORKERS;
+    }
+
+    p->buffer_count = workers * AES_GCM_BUFFERS_PER_WORKER;
+    p->buffers = calloc(p->buffer_count, sizeof(*p->buffers));
+    p->done = malloc(p->buffer_count * sizeof(*p->done));
+    if (!p->buffers || !p->done) {
+        fprintf(stderr, "Failed to allocate pipeline buffers\n");
+        goto cleanup;
+    }
+    for (int i = 0; i < p->buffer_count; i++) {
+        p->buffers[i].data = malloc(p->chunk_size + AES_TAG_SIZE);
+        if (!p->buffers[i].data) {
+            fprintf(stderr, "Failed to allocate pipeline buffers\n");
+            goto cleanup;
+        }
+        p->buffers[i].next = i + 1 < p->buffer_count ? i + 1 : -1;
+        p->done[i] = -1;
+    }
+    p->free_head = 0;
+    p->work_head = p->work_tail = -1;
+
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->free_cond, NULL);
+    pthread_cond_init(&p->work_cond, NULL);
+    pthread_cond_init(&p->done_cond, NULL);
+
+    if (pthread_create(&reader, NULL, reader_main, p) != 0) {
+        fprintf(stderr, "Failed to start reader thread\n");
+        goto destroy;
+    }
+    for (; started < workers; started++) {
+        if (pthread_create(&threads[started], NULL, worker_main, p) != 0) {
+            fprintf(stderr, "Failed to start cipher worker\n");
+            pipeline_fail(p);
+            break;
+        }
+    }
+
+    ret = write_chunks(p);
+    if (ret != 0) {
+        pipeline_fail(p);
+    }
+
+    pthread_join(reader, NULL);
+    for (int i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+destroy:
+    pthread_cond_destroy(&p->done_cond);
+    pthread_cond_destroy(&p->work_cond);
+    pthread_cond_destroy(&p->free_cond);
+    pthread_mutex_destroy(&p->lock);
+
+cleanup:
+    if (p->buffers) {
+        for (int i = 0; i < p->buffer_count; i++) {
+            free(p->buffers[i].data);
+        }
+    }
+    free(p->buffers);
+    free(p->done);
+    return ret;
+}
+
+static int close_output(FILE *out_fp, const char *output_file, int ret) {
+    if (fclose(out_fp) != 0 && ret == 0) {
+        perror("fclose output file");
+        ret = -1;
+    }
+    if (ret != 0) {
+        unlink(output_file);
+    }
+    return ret;
+}
+
+int encrypt_file_parallel(const char *input_file, const char *output_file,
+                          const unsigned char *key, size_t chunk_size, int workers) {
+    struct pipeline p;
+    int ret = -1;
+
+    if (!input_file || !output_file || !key ||
+        chunk_size == 0 || chunk_size > AES_GCM_MAX_CHUNK_SIZE) {
+        fprintf(stderr, "Invalid parameters to encrypt_file_parallel\n");
+        return -1;
+    }
+
+    memset(&p, 0, sizeof(p));
+    p.encrypt = 1;
+    p.key = key;
+    p.chunk_size = chunk_size;
+
+    p.in_fp = fopen(input_file, "rb");
+    if (!p.in_fp) {
+        perror("fopen input file");
+        return -1;
+    }
+
+    p.out_fp = fopen(output_file, "wb");
+    if (!p.out_fp) {
+        perror("fopen output file");
+        fclose(p.in_fp);
+        return -1;
+    }
+
+    if (aes_gcm_build_header(p.header, chunk_size) == 0) {
+        if (fwrite(p.header, 1, AES_GCM_HEADER_SIZE, p.out_fp) == AES_GCM_HEADER_SIZE) {
+            ret = run_pipeline(&p, workers);
+        } else {
+            perror("fwrite header");
+        }
+    }
+
+    fclose(p.in_fp);
+    return close_output(p.out_fp, output_file, ret);
+}
+
+int decrypt_file_parallel(const char *input_file, const char *output_file,
+                          const unsigned char *key, int workers) {
+    struct pipeline p;
+
+    if (!input_file || !output_file || !key) {
+        fprintf(stderr, "Invalid parameters to decrypt_file_parallel\n");
+        return -1;
+    }
+
+    memset(&p, 0, sizeof(p));
+    p.encrypt = 0;
+    p.key = key;
+
+    p.in_fp = fopen(input_file, "rb");
+    if (!p.in_fp) {
+        perror("fopen input file");
+        return -1;
+    }
+
+    if (fread(p.header, 1, AES_GCM_HEADER_SIZE, p.in_fp) != AES_GCM_HEADER_SIZE) {
+        fprintf(stderr, "Encrypted file too short\n");
+        fclose(p.in_fp);
+        return -1;
+    }
+    if (aes_gcm_parse_header(p.header, &p.chunk_size) != 0) {
+        fclose(p.in_fp);
+        return -1;
+    }
+
+    p.out_fp = fopen(output_file, "wb");
+    if (!p.out_fp) {
+        perror("fopen output file");
+        fclose(p.in_fp);
+        return -1;
+    }
+
+    int ret = run_pipeline(&p, workers);
+    fclose(p.in_fp);
+    return close_output(p.out_fp, output_file, ret);
+}
@@ -0,0 +1,245 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <openssl/evp.h>
+#include "aes_gcm_encrypt.h"
+#include "aes_gcm_stream.h"
+
+/* Random access into an encrypted file. The chunk layout follows from
+ * the header and the file size alone, so a read at some plaintext offset
+ * goes straight to the records covering it: each is read with pread(),
+ * verified and decrypted on its own.
+ *
+ * Decrypted chunks are kept in a small cache, least recently used out,
+ * so readers going through a file in pieces smaller than a chunk decrypt
+ * each chunk once. Chunks a read covers entirely are decrypted straight
+ * into the caller's buffer and not cached: a large sequential read would
+ * only flush the cache. The final chunk is verified at open, so the size
+ * reported is authentic and truncation shows up there. */
+
+struct reader_slot {
+    uint64_t index;
+    uint64_t last_used;         // 0 for an empty slot
+    unsigned char *data;        // chunk_size bytes
+};
+
+struct aes_gcm_reader {
+    int fd;
+    unsigned char header[AES_GCM_HEADER_SIZE];
+    size_t chunk_size;
+    uint64_t plain_size;
+    uint64_t chunks;
+
+    EVP_CIPHER_CTX *ctx;
+    unsigned char *record;      // Ciphertext and tag of the chunk being read
+    struct reader_slot *slots;
+    size_t slot_count;
+    uint64_t clock;
+    pthread_mutex_t lock;
+};
+
+static int pread_full(int fd, unsigned char *buf, size_t len, uint64_t offset) {
+    while (len > 0) {
+        ssize_t n = pread(fd, buf, len, (off_t)offset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            perror("pread encrypted file");
+            return -1;
+        }
+        if (n == 0) {
+            fprintf(stderr, "Encrypted file truncated\n");
+            return -1;
+        }
+        buf += n;
+        len -= n;
+        offset += n;
+    }
+    return 0;
+}
+
+static size_t chunk_len(const struct aes_gcm_reader *reader, uint64_t index) {
+    return index == reader->chunks - 1 ? reader->plain_size - index * reader->chunk_size :
+                                         reader->chunk_size;
+}
+
+// Reads, verifies and decrypts one chunk into out; nothing unverified
+// is left there on failure
+static int read_chunk(struct aes_gcm_reader *reader, uint64_t index, unsigned char *out) {
+    size_t len = chunk_len(reader, index);
+    uint64_t offset = AES_GCM_HEADER_SIZE + index * (reader->chunk_size + AES_TAG_SIZE);
+
+    if (pread_full(reader->fd, reader->record, len + AES_TAG_SIZE, offset) != 0 ||
+        aes_gcm_decrypt_chunk(reader->ctx, reader->header, index, index == reader->chunks - 1,
+                              reader->record, out, len, reader->record + len) != 0) {
+        memset(out, 0, len);
+        return -1;
+    }
+    return 0;
+}
+
+static struct reader_slot *find_slot(struct aes_gcm_reader *reader, uint64_t index) {
+    for (size_t i = 0; i < reader->slot_count; i++) {
+        struct reader_slot *slot = &reader->slots[i];
+        if (slot->last_used != 0 && slot->index == index) {
+            slot->last_used = ++reader->clock;
+            return slot;
+        }
+    }
+    return NULL;
+}
+
+// Decrypts a chunk into the least recently used slot
+static struct reader_slot *load_slot(struct aes_gcm_reader *reader, uint64_t index) {
+    struct reader_slot *victim = &reader->slots[0];
+
+    for (size_t i = 1; i < reader->slot_count; i++) {
+        if (reader->slots[i].last_used < victim->last_used) {
+            victim = &reader->slots[i];
+        }
+    }
+
+    victim->last_used = 0;
+    if (read_chunk(reader, index, victim->data) != 0) {
+        return NULL;
+    }
+    victim->index = index;
+    victim->last_used = ++reader->clock;
+    return victim;
+}
+
+struct aes_gcm_reader *aes_gcm_reader_open(const char *path, const unsigned char *key,
+                                           size_t cache_chunks) {
+    struct aes_gcm_reader *reader = calloc(1, sizeof(*reader));
+    struct stat st;
+
+    if (!reader) {
+        perror("calloc");
+        return NULL;
+    }
+    reader->fd = open(path, O_RDONLY | O_CLOEXEC);
+    pthread_mutex_init(&reader->lock, NULL);
+    if (reader->fd < 0) {
+        perror("open encrypted file");
+        goto fail;
+    }
+    if (fstat(reader->fd, &st) != 0) {
+        perror("fstat encrypted file");
+        goto fail;
+    }
+    if (st.st_size < AES_GCM_HEADER_SIZE) {
+        fprintf(stderr, "Encrypted file too short\n");
+        goto fail;
+    }
+    if (pread_full(reader->fd, reader->header, AES_GCM_HEADER_SIZE, 0) != 0 ||
+        aes_gcm_parse_header(reader->header, &reader->chunk_size) != 0) {
+        goto fail;
+    }
+    if (aes_gcm_plain_size(st.st_size, reader->chunk_size, &reader->plain_size,
+                           &reader->chunks) != 0) {
+        fprintf(stderr, "Encrypted file truncated\n");
+        goto fail;
+    }
+
+    if (cache_chunks == 0) {
+        cache_chunks = AES_GCM_READER_DEFAULT_CACHE;
+    }
+    if (cache_chunks > AES_GCM_READER_MAX_CACHE) {
+        cache_chunks = AES_GCM_READER_MAX_CACHE;
+    }
+    reader->slots = calloc(cache_chunks, sizeof(*reader->slots));
+    reader->record = malloc(reader->chunk_size + AES_TAG_SIZE);
+    reader->ctx = aes_gcm_stream_ctx(key, 0);
+    if (!reader->slots || !reader->record || !reader->ctx) {
+        goto fail;
+    }
+    for (reader->slot_count = 0; reader->slot_count < cache_chunks; reader->slot_count++) {
+        reader->slots[reader->slot_count].data = malloc(reader->chunk_size);
+        if (!reader->slots[reader->slot_count].data) {
+            perror("malloc");
+            goto fail;
+        }
+    }
+
+    // Authenticates the size: only the real final chunk verifies as final
+    if (!load_slot(reader, reader->chunks - 1)) {
+        goto fail;
+    }
+    return reader;
+
+fail:
+    aes_gcm_reader_close(reader);
+    return NULL;
+}
+
+uint64_t aes_gcm_reader_size(const struct aes_gcm_reader *reader) {
+    return reader->plain_size;
+}
+
+ssize_t aes_gcm_pread(struct aes_gcm_reader *reader, void *buf, size_t len, uint64_t offset) {
+    unsigned char *dst = buf;
+    ssize_t ret;
+
+    if (offset >= reader->plain_size) {
+        return 0;
+    }
+    if (len > reader->plain_size - offset) {
+        len = reader->plain_size - offset;
+    }
+    if (len > SSIZE_MAX) {
+        len = SSIZE_MAX;
+    }
+
+    pthread_mutex_lock(&reader->lock);
+    for (size_t done = 0; done < len; ) {
+        uint64_t pos = offset + done;
+        uint64_t index = pos / reader->chunk_size;
+        size_t start = pos % reader->chunk_size;
+        size_t n = chunk_len(reader, index) - start;
+
+        if (n > len - done) {
+            n = len - done;
+        }
+        struct reader_slot *slot = find_slot(reader, index);
+        if (!slot && start == 0 && n == chunk_len(reader, index)) {
+            if (read_chunk(reader, index, dst + done) != 0) {
+                ret = -1;
+                goto out;
+            }
+        } else {
+            if (!slot && !(slot = load_slot(reader, index))) {
+                ret = -1;
+                goto out;
+            }
+            memcpy(dst + done, slot->data + start, n);
+        }
+        done += n;
+    }
+    ret = (ssize_t)len;
+
+out:
+    pthread_mutex_unlock(&reader->lock);
+    return ret;
+}
+
+void aes_gcm_reader_close(struct aes_gcm_reader *reader) {
+    if (!reader) {
+        return;
+    }
+    if (reader->fd >= 0) close(reader->fd);
+    if (reader->ctx) EVP_CIPHER_CTX_free(reader->ctx);
+    for (size_t i = 0; i < reader->slot_count; i++) {
+        free(reader->slots[i].data);
+    }
+    free(reader->slots);
+    free(reader->record);
+    pthread_mutex_destroy(&reader->lock);
+    free(reader);
+}
@@ -0,0 +1,38 @@
+#ifndef AES_GCM_STREAM_H
+#define AES_GCM_STREAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <openssl/evp.h>
+
+/* Chunk-level pieces of the file format described in aes_gcm_encrypt.h,
+ * shared by the single-threaded and the pipelined paths. Internal to the
+ * encryption library. Functions return 0 or -1 and report errors on
+ * stderr. */
+
+// Fills in a header with a fresh random nonce base
+int aes_gcm_build_header(unsigned char *header, size_t chunk_size);
+int aes_gcm_parse_header(const unsigned char *header, size_t *chunk_size);
+
+/* Sizes implied by the format. aes_gcm_plain_size() fails when
+ * encrypted_size cannot be a whole file (cut inside or right after a
+ * full chunk). Both count the chunks, the final one included. */
+uint64_t aes_gcm_encrypted_size(uint64_t plain_size, size_t chunk_size, uint64_t *chunks);
+int aes_gcm_plain_size(uint64_t encrypted_size, size_t chunk_size, uint64_t *plain_size,
+                       uint64_t *chunks);
+
+/* A context keyed once for a whole file (encrypt 1, decrypt 0); each
+ * chunk then only sets its nonce */
+EVP_CIPHER_CTX *aes_gcm_stream_ctx(const unsigned char *key, int encrypt);
+
+/* Encrypt or decrypt one chunk from in to out, which may be the same
+ * buffer. Decryption fails when the chunk does not authenticate, leaving
+ * out unspecified. */
+int aes_gcm_encrypt_chunk(EVP_CIPHER_CTX *ctx, const unsigned char *header, uint64_t index,
+                          int final, const unsigned char *in, unsigned char *out, size_t len,
+                          unsigned char *tag);
+int aes_gcm_decrypt_chunk(EVP_CIPHER_CTX *ctx, const unsigned char *header, uint64_t index,
+                          int final, const unsigned char *in, unsigned char *out, size_t len,
+                          const unsigned char *tag);
+
+#endif /* AES_GCM_STREAM_H */
@@ -0,0 +1,114 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../aes_gcm_encrypt.h"
+
+/* Small-message benchmark: encrypts messages of several sizes with
+ *   fresh   a context built, keyed and freed per message,
+ *   pool    encrypt_file_data(), through the thread's context pool,
+ *   ctx     one aes_gcm_ctx held by the caller,
+ * and reports messages per second, best of --runs. The three outputs
+ * are compared and decrypted to check they agree.
+ *
+ * Usage: ctx_bench [--messages N] [--runs N] */
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int encrypt_fresh(const unsigned char *plaintext, size_t len, const unsigned char *key,
+                         const unsigned char *iv, unsigned char *ciphertext, unsigned char *tag) {
+    struct aes_gcm_ctx *ctx = aes_gcm_ctx_new(key);
+    int ret = ctx ? aes_gcm_ctx_encrypt(ctx, plaintext, len, iv, ciphertext, tag) : -1;
+    aes_gcm_ctx_free(ctx);
+    return ret;
+}
+
+int main(int argc, char *argv[]) {
+    static const size_t sizes[] = { 16, 64, 256, 1024, 4096, 16384 };
+    long messages = 200000;
+    int runs = 3;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--messages") == 0 && i + 1 < argc) {
+            messages = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--runs") == 0 && i + 1 < argc) {
+            runs = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "Usage: %s [--messages N] [--runs N]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (messages <= 0 || runs <= 0) {
+        return 1;
+    }
+
+    unsigned char key[AES_KEY_SIZE], iv[AES_IV_SIZE];
+    unsigned char plaintext[16384], ciphertext[3][16384], decrypted[16384];
+    unsigned char tag[3][AES_TAG_SIZE];
+    if (generate_random_key(key, sizeof(key)) != 0 ||
+        generate_random_key(iv, sizeof(iv)) != 0 ||
+        generate_random_key(plaintext, sizeof(plaintext)) != 0) {
+        return 1;
+    }
+    struct aes_gcm_ctx *ctx = aes_gcm_ctx_new(key);
+    if (!ctx) {
+        return 1;
+    }
+
+    printf("AES-256-GCM single messages, best of %d x %ld, messages/s\n", runs, messages);
+    printf("%8s %12s %12s %12s\n", "size", "fresh", "pool", "ctx");
+
+    int failed = 0;
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]) && !failed; s++) {
+        size_t len = sizes[s];
+        double best[3] = { 1e30, 1e30, 1e30 };
+
+        for (int run = 0; run < runs && !failed; run++) {
+            for (int method = 0; method < 3 && !failed; method++) {
+                double start = now_seconds();
+                for (long m = 0; m < messages; m++) {
+                    int ret;
+                    // A benchmark only: real callers must not reuse an IV
+                    iv[0] = (unsigned char)m;
+                    if (method == 0) {
+                        ret = encrypt_fresh(plaintext, len, key, iv, ciphertext[0], tag[0]);
+                    } else if (method == 1) {
+                        ret = encrypt_file_data(plaintext, len, key, iv, ciphertext[1], tag[1]);
+                    } else {
+                        ret = aes_gcm_ctx_encrypt(ctx, plaintext, len, iv, ciphertext[2], tag[2]);
+                    }
+                    if (ret != (int)len) {
+                        failed = 1;
+                        break;
+                    }
+                }
+                double elapsed = now_seconds() - start;
+                if (elapsed < best[method]) best[method] = elapsed;
+            }
+        }
+
+        for (int method = 1; method < 3 && !failed; method++) {
+            if (memcmp(ciphertext[0], ciphertext[method], len) != 0 ||
+                memcmp(tag[0], tag[method], AES_TAG_SIZE) != 0) {
+                failed = 1;
+            }
+        }
+        if (failed ||
+            decrypt_file_data(ciphertext[0], len, key, iv, tag[0], decrypted) != (int)len ||
+            memcmp(decrypted, plaintext, len) != 0) {
+            fprintf(stderr, "Methods disagree at %zu bytes\n", len);
+            failed = 1;
+            break;
+        }
+        printf("%8zu %12.0f %12.0f %12.0f\n", len,
+               messages / best[0], messages / best[1], messages / best[2]);
+    }
+
+    aes_gcm_ctx_free(ctx);
+    aes_gcm_ctx_pool_flush();
+    return failed;
+}
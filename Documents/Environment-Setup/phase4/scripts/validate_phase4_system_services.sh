@@ -23,11 +23,23 @@ gcc -o "$PHASE4_DIR/process_sandbox/test_sandbox_production" \
 }
 echo "✅ Compiled with FULL CAPABILITY CONTROL - NO REDUCED FUNCTIONALITY"
 
+# Launcher benchmark (fork+sh vs vfork fast path)
+echo "Compiling process launcher benchmark..."
+gcc -O2 -o "$PHASE4_DIR/process_sandbox/spawn_bench" \
+    "$PHASE4_DIR/process_sandbox/bench/spawn_bench.c" \
+    "$PHASE4_DIR/process_sandbox/src/spawn_launcher.c" \
+    -I"$PHASE4_DIR/process_sandbox/include" || {
+    echo "ERROR: Launcher benchmark compilation failed"
+    exit 1
+}
+
 # Test container runtime
 echo "Compiling container runtime..."
 gcc -o "$PHASE4_DIR/container_runtime/test_container" \
     "$PHASE4_DIR/container_runtime/src/container_security.c" \
-    -I"$PHASE4_DIR/container_runtime/include" || {
+    "$PHASE4_DIR/process_sandbox/src/spawn_launcher.c" \
+    -I"$PHASE4_DIR/container_runtime/include" \
+    -I"$PHASE4_DIR/process_sandbox/include" || {
     echo "ERROR: Container runtime compilation failed"
     exit 1
 }
@@ -36,7 +48,16 @@ gcc -o "$PHASE4_DIR/container_runtime/test_container" \
 echo "Compiling service manager..."
 gcc -o "$PHASE4_DIR/service_manager/test_service_manager" \
     "$PHASE4_DIR/service_manager/src/service_manager.c" \
-    -I"$PHASE4_DIR/service_manager/include" || {
+    "$PHASE4_DIR/service_manager/src/service_registry.c" \
+    "$PHASE4_DIR/service_manager/src/service_supervisor.c" \
+    "$PHASE4_DIR/service_manager/src/service_scheduler.c" \
+    "$PHASE4_DIR/service_manager/src/service_cgroup.c" \
+    "$PHASE4_DIR/service_manager/src/service_credentials.c" \
+    "$PHASE4_DIR/service_manager/src/service_restart.c" \
+    "$PHASE4_DIR/service_manager/src/service_config_blob.c" \
+    "$PHASE4_DIR/process_sandbox/src/spawn_launcher.c" \
+    -I"$PHASE4_DIR/service_manager/include" \
+    -I"$PHASE4_DIR/process_sandbox/include" -pthread || {
     echo "ERROR: Service manager compilation failed"
     exit 1
 }
@@ -45,11 +66,78 @@ gcc -o "$PHASE4_DIR/service_manager/test_service_manager" \
 echo "Compiling security monitor..."
 gcc -o "$PHASE4_DIR/security_monitor/test_monitor" \
     "$PHASE4_DIR/security_monitor/src/security_monitor.c" \
-    -I"$PHASE4_DIR/security_monitor/include" || {
+    "$PHASE4_DIR/security_monitor/src/event_ring.c" \
+    "$PHASE4_DIR/security_monitor/src/event_store.c" \
+    "$PHASE4_DIR/security_monitor/src/rule_matcher.c" \
+    "$PHASE4_DIR/security_monitor/src/rule_dfa.c" \
+    "$PHASE4_DIR/security_monitor/src/correlation.c" \
+    "$PHASE4_DIR/security_monitor/src/event_journal.c" \
+    "$PHASE4_DIR/security_monitor/src/enforcement.c" \
+    "$PHASE4_DIR/security_monitor/src/event_collectors.c" \
+    "$PHASE4_DIR/security_monitor/src/rule_workers.c" \
+    "$PHASE4_DIR/security_monitor/src/ruleset.c" \
+    "$PHASE4_DIR/audit_sink/src/audit_sink.c" \
+    -I"$PHASE4_DIR/security_monitor/include" \
+    -I"$PHASE4_DIR/audit_sink/include" -pthread || {
     echo "ERROR: Security monitor compilation failed"
     exit 1
 }
 
+# Rule matching benchmark (nested strstr vs Aho-Corasick)
+echo "Compiling rule matching benchmark..."
+gcc -O2 -o "$PHASE4_DIR/security_monitor/match_bench" \
+    "$PHASE4_DIR/security_monitor/bench/match_bench.c" \
+    "$PHASE4_DIR/security_monitor/src/rule_matcher.c" \
+    "$PHASE4_DIR/security_monitor/src/rule_dfa.c" \
+    -I"$PHASE4_DIR/security_monitor/include" || {
+    echo "ERROR: Rule matching benchmark compilation failed"
+    exit 1
+}
+
+# Block rule reaction latency harness
+echo "Compiling block latency harness..."
+gcc -O2 -DSECURITY_MONITOR_NO_MAIN -o "$PHASE4_DIR/security_monitor/block_latency" \
+    "$PHASE4_DIR/security_monitor/bench/block_latency.c" \
+    "$PHASE4_DIR/security_monitor/src/security_monitor.c" \
+    "$PHASE4_DIR/security_monitor/src/event_ring.c" \
+    "$PHASE4_DIR/security_monitor/src/event_store.c" \
+    "$PHASE4_DIR/security_monitor/src/rule_matcher.c" \
+    "$PHASE4_DIR/security_monitor/src/rule_dfa.c" \
+    "$PHASE4_DIR/security_monitor/src/correlation.c" \
+    "$PHASE4_DIR/security_monitor/src/event_journal.c" \
+    "$PHASE4_DIR/security_monitor/src/enforcement.c" \
+    "$PHASE4_DIR/security_monitor/src/event_collectors.c" \
+    "$PHASE4_DIR/security_monitor/src/rule_workers.c" \
+    "$PHASE4_DIR/security_monitor/src/ruleset.c" \
+    "$PHASE4_DIR/audit_sink/src/audit_sink.c" \
+    -I"$PHASE4_DIR/security_monitor/include" \
+    -I"$PHASE4_DIR/audit_sink/include" -pthread || {
+    echo "ERROR: Block latency harness compilation failed"
+    exit 1
+}
+
+# Sharded rule evaluation throughput benchmark
+echo "Compiling rule worker scaling benchmark..."
+gcc -O2 -DSECURITY_MONITOR_NO_MAIN -o "$PHASE4_DIR/security_monitor/shard_bench" \
+    "$PHASE4_DIR/security_monitor/bench/shard_bench.c" \
+    "$PHASE4_DIR/security_monitor/src/security_monitor.c" \
+    "$PHASE4_DIR/security_monitor/src/event_ring.c" \
+    "$PHASE4_DIR/security_monitor/src/event_store.c" \
+    "$PHASE4_DIR/security_monitor/src/rule_matcher.c" \
+    "$PHASE4_DIR/security_monitor/src/rule_dfa.c" \
+    "$PHASE4_DIR/security_monitor/src/correlation.c" \
+    "$PHASE4_DIR/security_monitor/src/event_journal.c" \
+    "$PHASE4_DIR/security_monitor/src/enforcement.c" \
+    "$PHASE4_DIR/security_monitor/src/event_collectors.c" \
+    "$PHASE4_DIR/security_monitor/src/rule_workers.c" \
+    "$PHASE4_DIR/security_monitor/src/ruleset.c" \
+    "$PHASE4_DIR/audit_sink/src/audit_sink.c" \
+    -I"$PHASE4_DIR/security_monitor/include" \
+    -I"$PHASE4_DIR/audit_sink/include" -pthread || {
+    echo "ERROR: Rule worker scaling benchmark compilation failed"
+    exit 1
+}
+
 echo "✅ All Phase 4 components compiled successfully"
 
 # Test basic functionality
@@ -60,10 +148,36 @@ cat > "$PHASE4_DIR/service_manager/test_services.conf" << 'CONF'
 test-service /bin/echo nobody nobody 3 1048576 100
 CONF
 
+# Scheduler regression: dependents released by an already running service
+# must not be queued a second time (heap overflow, caught by ASan)
+echo "Testing dependency-ordered startup..."
+gcc -g -fsanitize=address -o "$PHASE4_DIR/service_manager/test_scheduler_asan" \
+    "$PHASE4_DIR/service_manager/src/"*.c \
+    "$PHASE4_DIR/process_sandbox/src/spawn_launcher.c" \
+    -I"$PHASE4_DIR/service_manager/include" \
+    -I"$PHASE4_DIR/process_sandbox/include" -pthread || {
+    echo "ERROR: Service manager ASan build failed"
+    exit 1
+}
+SVC_USER="$(id -un) $(id -gn)"
+cat > "$PHASE4_DIR/service_manager/test_startup_order.conf" << CONF
+A /bin/sleep 30 $SVC_USER 3 0 0
+B /bin/sleep 30 $SVC_USER 3 0 0 after=A
+C /bin/sleep 30 $SVC_USER 3 0 0 after=A
+D /bin/sleep 30 $SVC_USER 3 0 0
+E /bin/sleep 30 $SVC_USER 3 0 0
+CONF
+"$PHASE4_DIR/service_manager/test_scheduler_asan" --start-all \
+    "$PHASE4_DIR/service_manager/test_startup_order.conf" A || {
+    echo "ERROR: Dependency-ordered startup failed"
+    exit 1
+}
+
 # Create test security rules
 cat > "$PHASE4_DIR/security_monitor/test_rules.conf" << 'RULES'
 1 1 suspicious 1 1
 2 5 escalation 2 1
+correlate 100 5 uid 5 10 1
 RULES
 
 echo "✅ Phase 4 validation completed successfully"
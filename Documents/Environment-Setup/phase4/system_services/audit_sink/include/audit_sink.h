@@ -0,0 +1,51 @@
+#ifndef AUDIT_SINK_H
+#define AUDIT_SINK_H
+
+#include <syslog.h>
+
+#define AUDIT_SINK_THREAD_SLOTS 256     // Queued records per thread; power of two
+#define AUDIT_SINK_TEXT_MAX 480         // Longer messages are truncated
+#define AUDIT_SINK_BATCH 64             // Records per sendmmsg()/writev()
+#define AUDIT_SINK_SOCKET "/dev/log"
+
+/* Asynchronous replacement for syslog() on hot paths. audit_log() formats
+ * the message into a buffer owned by the calling thread and returns; a
+ * background writer collects records from every thread's buffer and
+ * writes them in batches, as datagrams to the syslog socket (sendmmsg)
+ * or as lines appended to a file (writev). No lock is taken per record.
+ *
+ * Under back-pressure low-severity records go first: a thread's buffer
+ * only accepts LOG_INFO/LOG_DEBUG while under half full and
+ * LOG_NOTICE/LOG_WARNING while under three quarters full; LOG_ERR and
+ * above can use every slot. Drops are counted per level. */
+
+struct audit_sink_config {
+    const char *ident;          // Tag in front of every message
+    int facility;               // Used when a priority carries none
+    const char *path;           // Log file, or NULL for AUDIT_SINK_SOCKET
+};
+
+struct audit_sink_stats {
+    unsigned long long queued;
+    unsigned long long written;
+    unsigned long long dropped[8];  // Indexed by LOG_EMERG..LOG_DEBUG
+    unsigned long long errors;      // Records lost to failed writes
+};
+
+/* One sink per process, like openlog(). Until it is opened, audit_log()
+ * falls back to a synchronous vsyslog(). */
+int audit_sink_open(const struct audit_sink_config *config);
+
+/* Writes out everything queued, then stops the writer. Callers must have
+ * stopped logging. */
+void audit_sink_close(void);
+
+/* Returns once everything queued before the call has been written */
+int audit_sink_flush(void);
+
+/* 0 when queued (or logged synchronously), -EAGAIN when dropped */
+int audit_log(int priority, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+void audit_sink_get_stats(struct audit_sink_stats *stats);
+
+#endif /* AUDIT_SINK_H */
@@ -0,0 +1,494 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include "../include/audit_sink.h"
+
+/* Each thread owns a single-producer single-consumer ring: the thread
+ * advances head, the writer advances tail, so neither ever waits for the
+ * other. Buffers are linked into a list at the first audit_log() of a
+ * thread (the only time a producer takes sink_lock) and reclaimed by the
+ * writer once the thread has exited and its records are out. The writer
+ * sleeps on an eventfd; producers only signal it when it has said it is
+ * idle, so a busy sink costs no syscall per record. */
+
+#define AUDIT_SINK_IDLE_MS 1000
+#define AUDIT_LINE_MAX (AUDIT_SINK_TEXT_MAX + 128)
+
+struct audit_record {
+    int priority;
+    int len;
+    struct timespec time;
+    char text[AUDIT_SINK_TEXT_MAX];
+};
+
+struct audit_buffer {
+    _Atomic uint64_t head;
+    _Atomic unsigned long long dropped[8];
+    _Alignas(64) _Atomic uint64_t tail;
+    _Atomic int orphaned;               // Owning thread has exited
+    struct audit_buffer *next;
+    struct audit_record records[AUDIT_SINK_THREAD_SLOTS];
+};
+
+static pthread_mutex_t sink_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t flush_cond = PTHREAD_COND_INITIALIZER;
+static struct audit_buffer *buffers = NULL;
+static unsigned long long flush_requested = 0;
+static unsigned long long flush_completed = 0;
+static struct audit_sink_stats retired;    // Counters of reclaimed buffers
+
+static _Atomic int sink_open = 0;
+static _Atomic unsigned sink_generation = 0;
+static _Atomic int stopping = 0;
+static _Atomic int writer_idle = 0;
+static _Atomic unsigned long long written = 0;
+static _Atomic unsigned long long errors = 0;
+
+static pthread_t writer;
+static pthread_key_t buffer_key;
+static pthread_once_t key_once = PTHREAD_ONCE_INIT;
+static int wake_fd = -1;
+static int out_fd = -1;
+static int to_socket = 0;
+static char ident[64];
+static int default_facility = LOG_USER;
+static pid_t sink_pid;
+
+static __thread struct audit_buffer *local_buffer = NULL;
+static __thread unsigned local_generation = 0;
+
+static void wake_writer(void) {
+    uint64_t one = 1;
+    if (write(wake_fd, &one, sizeof(one)) < 0) {
+        // Counter already non-zero: the writer is being woken anyway
+    }
+}
+
+static void buffer_orphan(void *ptr) {
+    // The buffer may belong to a sink that has since been closed
+    if (ptr == local_buffer && local_generation == atomic_load(&sink_generation) &&
+        atomic_load(&sink_open)) {
+        atomic_store(&local_buffer->orphaned, 1);
+    }
+    local_buffer = NULL;
+}
+
+static void make_key(void) {
+    pthread_key_create(&buffer_key, buffer_orphan);
+}
+
+static struct audit_buffer *thread_buffer(void) {
+    unsigned generation = atomic_load(&sink_generation);
+
+    if (local_buffer && local_generation == generation) {
+        return local_buffer;
+    }
+
+    pthread_once(&key_once, make_key);
+    struct audit_buffer *buffer = aligned_alloc(64, sizeof(*buffer));
+    if (!buffer) {
+        return NULL;
+    }
+    memset(buffer, 0, sizeof(*buffer));
+
+    pthread_mutex_lock(&sink_lock);
+    buffer->next = buffers;
+    buffers = buffer;
+    pthread_mutex_unlock(&sink_lock);
+
+    local_buffer = buffer;
+    local_generation = generation;
+    pthread_setspecific(buffer_key, buffer);
+    return buffer;
+}
+
+int audit_log(int priority, const char *format, ...) {
+    va_list ap;
+
+    if (!atomic_load_explicit(&sink_open, memory_order_acquire)) {
+        va_start(ap, format);
+        vsyslog(priority, format, ap);
+        va_end(ap);
+        return 0;
+    }
+
+    struct audit_buffer *buffer = thread_buffer();
+    if (!buffer) {
+        va_start(ap, format);
+        vsyslog(priority, format, ap);
+        va_end(ap);
+        return 0;
+    }
+
+    int level = LOG_PRI(priority);
+    uint64_t head = atomic_load_explicit(&buffer->head, memory_order_relaxed);
+    uint64_t used = head - atomic_load_explicit(&buffer->tail, memory_order_acquire);
+    uint64_t limit = level <= LOG_ERR ? AUDIT_SINK_THREAD_SLOTS
+                   : level <= LOG_WARNING ? AUDIT_SINK_THREAD_SLOTS * 3 / 4
+                   : AUDIT_SINK_THREAD_SLOTS / 2;
+
+    if (used >= limit) {
+        atomic_fetch_add_explicit(&buffer->dropped[level], 1, memory_order_relaxed);
+        return -EAGAIN;
+    }
+
+    struct audit_record *record = &buffer->records[head & (AUDIT_SINK_THREAD_SLOTS - 1)];
+    record->priority = priority;
+    clock_gettime(CLOCK_REALTIME, &record->time);
+
+    va_start(ap, format);
+    int len = vsnprintf(record->text, sizeof(record->text), format, ap);
+    va_end(ap);
+    record->len = len < 0 ? 0 : len >= (int)sizeof(record->text) ? (int)sizeof(record->text) - 1 : len;
+
+    atomic_store_explicit(&buffer->head, head + 1, memory_order_release);
+
+    // Pairs with the fence in writer_main(): either it sees the record or we see it idle
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&writer_idle, memory_order_relaxed) &&
+        atomic_exchange(&writer_idle, 0)) {
+        wake_writer();
+    }
+    return 0;
+}
+
+static int connect_socket(void) {
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+
+    if (out_fd < 0) {
+        out_fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+        if (out_fd < 0) {
+            return -errno;
+        }
+    }
+
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", AUDIT_SINK_SOCKET);
+    if (connect(out_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        int ret = -errno;
+        close(out_fd);
+        out_fd = -1;
+        return ret;
+    }
+    return 0;
+}
+
+/* Sends the formatted lines; records that cannot be written are counted */
+static void write_batch(char lines[][AUDIT_LINE_MAX], const int *lengths, int count) {
+    struct iovec iov[AUDIT_SINK_BATCH];
+    int sent = 0;
+
+    for (int i = 0; i < count; i++) {
+        iov[i].iov_base = lines[i];
+        iov[i].iov_len = lengths[i];
+    }
+
+    if (to_socket) {
+        struct mmsghdr messages[AUDIT_SINK_BATCH];
+
+        memset(messages, 0, count * sizeof(*messages));
+        for (int i = 0; i < count; i++) {
+            messages[i].msg_hdr.msg_iov = &iov[i];
+            messages[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        // Reconnect lazily: syslogd may have been restarted
+        while (sent < count && (out_fd >= 0 || connect_socket() == 0)) {
+            int n = sendmmsg(out_fd, messages + sent, count - sent, 0);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                close(out_fd);
+                out_fd = -1;
+                break;
+            }
+            sent += n;
+        }
+    } else {
+        while (sent < count) {
+            ssize_t n = writev(out_fd, iov + sent, count - sent);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                break;
+            }
+            // Whole lines only; a short write leaves the rest of one behind
+            while (sent < count && (size_t)n >= iov[sent].iov_len) {
+                n -= iov[sent++].iov_len;
+            }
+            if (sent < count && n > 0) {
+                iov[sent].iov_base = (char *)iov[sent].iov_base + n;
+                iov[sent].iov_len -= n;
+            }
+        }
+    }
+
+    atomic_fetch_add_explicit(&written, sent, memory_order_relaxed);
+    atomic_fetch_add_explicit(&errors, count - sent, memory_order_relaxed);
+}
+
+static int format_record(const struct audit_record *record, char *line) {
+    static time_t cached_second = -1;
+    static char stamp[32];
+
+    if (record->time.tv_sec != cached_second) {
+        struct tm tm;
+        localtime_r(&record->time.tv_sec, &tm);
+        strftime(stamp, sizeof(stamp), "%b %e %H:%M:%S", &tm);
+        cached_second = record->time.tv_sec;
+    }
+
+    int priority = record->priority;
+    if (!(priority & LOG_FACMASK)) {
+        priority |= default_facility;
+    }
+
+    int len = to_socket
+        ? snprintf(line, AUDIT_LINE_MAX, "<%d>%s %s[%d]: %.*s", priority, stamp, ident,
+                   (int)sink_pid, record->len, record->text)
+        : snprintf(line, AUDIT_LINE_MAX, "%s %s[%d]: %.*s\n", stamp, ident, (int)sink_pid,
+                   record->len, record->text);
+    return len < AUDIT_LINE_MAX ? len : AUDIT_LINE_MAX - 1;
+}
+
+/* One pass over every buffer, up to the records published when it is
+ * reached. Returns the number of records moved. */
+static int drain_buffers(void) {
+    static char lines[AUDIT_SINK_BATCH][AUDIT_LINE_MAX];
+    int lengths[AUDIT_SINK_BATCH];
+    int count = 0, moved = 0;
+
+    pthread_mutex_lock(&sink_lock);
+    struct audit_buffer *buffer = buffers;
+    pthread_mutex_unlock(&sink_lock);
+
+    // Only the writer unlinks buffers, so walking the list needs no lock
+    while (buffer) {
+        struct audit_buffer *next = buffer->next;
+        uint64_t tail = atomic_load_explicit(&buffer->tail, memory_order_relaxed);
+        uint64_t head = atomic_load_explicit(&buffer->head, memory_order_acquire);
+
+        for (; tail != head; tail++) {
+            const struct audit_record *record =
+                &buffer->records[tail & (AUDIT_SINK_THREAD_SLOTS - 1)];
+            lengths[count] = format_record(record, lines[count]);
+            atomic_store_explicit(&buffer->tail, tail + 1, memory_order_release);
+            moved++;
+
+            if (++count == AUDIT_SINK_BATCH) {
+                write_batch(lines, lengths, count);
+                count = 0;
+            }
+        }
+
+        if (atomic_load(&buffer->orphaned) &&
+            atomic_load_explicit(&buffer->head, memory_order_acquire) == tail) {
+            pthread_mutex_lock(&sink_lock);
+            struct audit_buffer **link = &buffers;
+            while (*link != buffer) {
+                link = &(*link)->next;
+            }
+            *link = buffer->next;
+            retired.queued += tail;
+            for (int i = 0; i < 8; i++) {
+                retired.dropped[i] += atomic_load(&buffer->dropped[i]);
+            }
+            pthread_mutex_unlock(&sink_lock);
+            free(buffer);
+        }
+        buffer = next;
+    }
+
+    if (count) {
+        write_batch(lines, lengths, count);
+    }
+    return moved;
+}
+
+static int buffers_pending(void) {
+    pthread_mutex_lock(&sink_lock);
+    struct audit_buffer *buffer = buffers;
+    pthread_mutex_unlock(&sink_lock);
+
+    for (; buffer; buffer = buffer->next) {
+        if (atomic_load(&buffer->head) != atomic_load(&buffer->tail)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void *writer_main(void *arg) {
+    struct pollfd wake = { .fd = wake_fd, .events = POLLIN };
+    (void)arg;
+
+    for (;;) {
+        int stop = atomic_load(&stopping);
+
+        pthread_mutex_lock(&sink_lock);
+        unsigned long long request = flush_requested;
+        pthread_mutex_unlock(&sink_lock);
+
+        int moved = drain_buffers();
+
+        // Everything queued before this pass started is written now
+        pthread_mutex_lock(&sink_lock);
+        if (flush_completed < request) {
+            flush_completed = request;
+            pthread_cond_broadcast(&flush_cond);
+        }
+        pthread_mutex_unlock(&sink_lock);
+
+        if (moved) {
+            continue;
+        }
+        if (stop) {
+            break;
+        }
+
+        atomic_store(&writer_idle, 1);
+        atomic_thread_fence(memory_order_seq_cst);
+        if (!buffers_pending() && !atomic_load(&stopping)) {
+            poll(&wake, 1, AUDIT_SINK_IDLE_MS);
+        }
+        atomic_store(&writer_idle, 0);
+
+        uint64_t value;
+        if (read(wake_fd, &value, sizeof(value)) < 0) {
+            // Nothing pending
+        }
+    }
+
+    return NULL;
+}
+
+int audit_sink_open(const struct audit_sink_config *config) {
+    if (atomic_load(&sink_open)) {
+        return -EBUSY;
+    }
+
+    snprintf(ident, sizeof(ident), "%s",
+             config && config->ident ? config->ident : program_invocation_short_name);
+    default_facility = config && config->facility ? config->facility : LOG_USER;
+    sink_pid = getpid();
+
+    to_socket = !(config && config->path);
+    if (to_socket) {
+        connect_socket(); // Retried from the writer if syslogd is not up yet
+    } else {
+        out_fd = open(config->path, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0640);
+        if (out_fd < 0) {
+            return -errno;
+        }
+    }
+
+    wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (wake_fd < 0) {
+        int ret = -errno;
+        if (out_fd >= 0) {
+            close(out_fd);
+            out_fd = -1;
+        }
+        return ret;
+    }
+
+    atomic_store(&stopping, 0);
+    atomic_store(&writer_idle, 0);
+    int ret = pthread_create(&writer, NULL, writer_main, NULL);
+    if (ret) {
+        close(wake_fd);
+        wake_fd = -1;
+        if (out_fd >= 0) {
+            close(out_fd);
+            out_fd = -1;
+        }
+        return -ret;
+    }
+
+    // Buffers of an earlier sink are never reused
+    atomic_fetch_add(&sink_generation, 1);
+    atomic_store_explicit(&sink_open, 1, memory_order_release);
+    return 0;
+}
+
+void audit_sink_close(void) {
+    if (!atomic_load(&sink_open)) {
+        return;
+    }
+
+    atomic_store(&sink_open, 0);
+    atomic_store(&stopping, 1);
+    wake_writer();
+    pthread_join(writer, NULL);
+
+    pthread_mutex_lock(&sink_lock);
+    while (buffers) {
+        struct audit_buffer *buffer = buffers;
+        buffers = buffer->next;
+        retired.queued += atomic_load(&buffer->head);
+        for (int i = 0; i < 8; i++) {
+            retired.dropped[i] += atomic_load(&buffer->dropped[i]);
+        }
+        free(buffer);
+    }
+    flush_completed = flush_requested;
+    pthread_cond_broadcast(&flush_cond);
+    pthread_mutex_unlock(&sink_lock);
+
+    close(wake_fd);
+    wake_fd = -1;
+    if (out_fd >= 0) {
+        close(out_fd);
+        out_fd = -1;
+    }
+}
+
+int audit_sink_flush(void) {
+    if (!atomic_load(&sink_open)) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&sink_lock);
+    unsigned long long request = ++flush_requested;
+    pthread_mutex_unlock(&sink_lock);
+
+    wake_writer();
+
+    pthread_mutex_lock(&sink_lock);
+    while (flush_completed < request) {
+        pthread_cond_wait(&flush_cond, &sink_lock);
+    }
+    pthread_mutex_unlock(&sink_lock);
+    return 0;
+}
+
+void audit_sink_get_stats(struct audit_sink_stats *stats) {
+    pthread_mutex_lock(&sink_lock);
+    *stats = retired;
+    for (struct audit_buffer *buffer = buffers; buffer; buffer = buffer->next) {
+        stats->queued += atomic_load(&buffer->head);
+        for (int i = 0; i < 8; i++) {
+            stats->dropped[i] += atomic_load(&buffer->dropped[i]);
+        }
+    }
+    pthread_mutex_unlock(&sink_lock);
+
+    stats->written = atomic_load(&written);
+    stats->errors = atomic_load(&errors);
+}
@@ -6,6 +6,7 @@
 #include <sys/mount.h>
 #include <errno.h>
 #include <sched.h>
+#include "spawn_launcher.h"
 #include "../include/container_security.h"
 
 int validate_container_policy(struct container_policy *policy) {
@@ -28,11 +29,8 @@ int validate_container_policy(struct container_policy *policy) {
     return 0;
 }
 
-int apply_container_security(struct container_runtime *runtime) {
-    if (!runtime) {
-        return -EINVAL;
-    }
-    
+/* Writes the container's cgroup limits; safe to run in the launching parent */
+static void apply_container_limits(struct container_runtime *runtime) {
     // Apply cgroup limits
     char cgroup_path[256];
     snprintf(cgroup_path, sizeof(cgroup_path), 
@@ -43,6 +41,12 @@ int apply_container_security(struct container_runtime *runtime) {
         fprintf(memory_limit, "%lu", runtime->policy.memory_limit);
         fclose(memory_limit);
     }
+}
+
+/* Namespace setup for the container process itself - runs in the launcher
+ * child before exec, so it must stay async-signal-safe */
+static int apply_container_isolation(void *arg) {
+    struct container_runtime *runtime = arg;
     
     // Apply network isolation
     if (runtime->policy.network_isolation) {
@@ -55,6 +59,15 @@ int apply_container_security(struct container_runtime *runtime) {
     return 0;
 }
 
+int apply_container_security(struct container_runtime *runtime) {
+    if (!runtime) {
+        return -EINVAL;
+    }
+    
+    apply_container_limits(runtime);
+    return apply_container_isolation(runtime);
+}
+
 int create_container(struct container_policy *policy, const char *image_path) {
     if (!policy || !image_path) {
         return -EINVAL;
@@ -65,30 +78,23 @@ int create_container(struct container_policy *policy, const char *image_path) {
         return ret;
     }
     
-    pid_t pid = fork();
-    if (pid < 0) {
-        return -errno;
-    }
+    // Container initialization
+    struct container_runtime runtime;
+    memset(&runtime, 0, sizeof(runtime));
+    strncpy(runtime.container_id, policy->name, sizeof(runtime.container_id) - 1);
+    runtime.policy = *policy;
+    runtime.status = 1;
     
-    if (pid == 0) {
-        // Container initialization
-        struct container_runtime runtime;
-        strncpy(runtime.container_id, policy->name, sizeof(runtime.container_id) - 1);
-        runtime.container_pid = getpid();
-        runtime.policy = *policy;
-        runtime.status = 1;
-        
-        ret = apply_container_security(&runtime);
-        if (ret < 0) {
-            _exit(EXIT_FAILURE);
-        }
-        
-        // Execute container image
-        execl("/bin/sh", "sh", "-c", image_path, NULL);
-        _exit(EXIT_FAILURE);
-    }
+    apply_container_limits(&runtime);
+    
+    // Execute container image
+    struct spawn_request req;
+    memset(&req, 0, sizeof(req));
+    req.command = image_path;
+    req.setup = apply_container_isolation;
+    req.setup_arg = &runtime;
     
-    return pid;
+    return spawn_process(&req, NULL);
 }
 
 int monitor_container_security(struct container_runtime *runtime) {
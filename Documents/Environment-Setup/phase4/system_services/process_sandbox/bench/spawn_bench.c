@@ -0,0 +1,105 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/wait.h>
+#include "../include/spawn_launcher.h"
+
+/* Launch-rate benchmark: the historical fork() + /bin/sh -c path against
+ * the CLONE_VM|CLONE_VFORK launcher, for a plain command (direct exec) and
+ * one with shell metacharacters. --rss-mb inflates the parent first, since
+ * fork() cost grows with the page tables it has to copy.
+ *
+ * Usage: spawn_bench [--launches N] [--rss-mb MB] */
+
+static double elapsed_seconds(const struct timespec *start, const struct timespec *end) {
+    return (end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static double run_case(enum spawn_mode mode, const char *command, int launches) {
+    struct spawn_request req;
+    struct timespec start, end;
+
+    memset(&req, 0, sizeof(req));
+    req.command = command;
+    req.mode = mode;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < launches; i++) {
+        pid_t pid = spawn_process(&req, NULL);
+        if (pid < 0) {
+            fprintf(stderr, "spawn failed: %s\n", strerror(-pid));
+            return -1;
+        }
+        waitpid(pid, NULL, 0);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    return launches / elapsed_seconds(&start, &end);
+}
+
+int main(int argc, char *argv[]) {
+    int launches = 2000;
+    size_t rss_mb = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--launches") == 0 && i + 1 < argc) {
+            launches = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--rss-mb") == 0 && i + 1 < argc) {
+            rss_mb = strtoul(argv[++i], NULL, 10);
+        } else {
+            fprintf(stderr, "Usage: %s [--launches N] [--rss-mb MB]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (launches <= 0) {
+        return 1;
+    }
+
+    // Touch every page so fork() really has page tables to copy
+    char *ballast = NULL;
+    if (rss_mb > 0) {
+        ballast = malloc(rss_mb << 20);
+        if (!ballast) {
+            perror("malloc");
+            return 1;
+        }
+        memset(ballast, 1, rss_mb << 20);
+    }
+
+    static const struct {
+        const char *label;
+        const char *command;
+    } commands[] = {
+        { "direct", "/bin/true" },
+        { "shell", "/bin/true; :" },
+    };
+    static const struct {
+        const char *label;
+        enum spawn_mode mode;
+    } modes[] = {
+        { "fork+sh", SPAWN_MODE_FORK },
+        { "vfork", SPAWN_MODE_VFORK },
+    };
+
+    printf("SecureOS launcher benchmark: %d launches, %zu MB parent RSS\n", launches, rss_mb);
+    printf("%-10s %-8s %14s\n", "mode", "command", "launches/sec");
+
+    for (size_t c = 0; c < sizeof(commands) / sizeof(commands[0]); c++) {
+        for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+            double rate = run_case(modes[m].mode, commands[c].command, launches);
+            if (rate < 0) {
+                free(ballast);
+                return 1;
+            }
+            printf("%-10s %-8s %14.0f\n", modes[m].label, commands[c].label, rate);
+        }
+    }
+
+    free(ballast);
+    return 0;
+}
@@ -0,0 +1,50 @@
+#ifndef SPAWN_LAUNCHER_H
+#define SPAWN_LAUNCHER_H
+
+#include <sys/types.h>
+
+#define SPAWN_MAX_ARGS 64
+#define SPAWN_STACK_SIZE (64 * 1024)
+#define SPAWN_MODE_ENV "SECUREOS_SPAWN_MODE" // "fork" or "vfork"
+
+enum spawn_mode {
+    SPAWN_MODE_DEFAULT = 0, // spawn_default_mode()
+    SPAWN_MODE_FORK,        // fork() + /bin/sh -c, the historical path
+    SPAWN_MODE_VFORK        // clone(CLONE_VM|CLONE_VFORK) on a small stack,
+                            // direct exec when no shell is needed
+};
+
+/* Runs in the child before exec. In vfork mode it shares the parent's
+ * memory: only async-signal-safe calls, no stdio, no malloc. Returns 0 or
+ * -errno; a failure aborts the launch and is returned by spawn_process(). */
+typedef int (*spawn_setup_fn)(void *arg);
+
+struct spawn_request {
+    const char *command;        // Command line, used when argv is NULL
+    const char *path;           // Executable for argv launches
+    char *const *argv;
+    char *const *envp;          // NULL inherits the caller's environment
+    spawn_setup_fn setup;
+    void *setup_arg;
+    int drop_privileges;        // Switch to uid/gid before exec
+    uid_t uid;
+    gid_t gid;
+    int into_cgroup;            // Start the child inside cgroup_fd
+    int cgroup_fd;              // cgroup v2 directory fd
+    enum spawn_mode mode;
+};
+
+void spawn_set_default_mode(enum spawn_mode mode);
+enum spawn_mode spawn_default_mode(void);
+int spawn_command_needs_shell(const char *command);
+
+/* Returns the child PID or -errno. The child starts with an empty signal
+ * mask and default dispositions. If pidfd is non-NULL it receives a pidfd
+ * for the child, or -1 when the kernel cannot provide one. With
+ * into_cgroup the child is created directly in cgroup_fd through clone3
+ * CLONE_INTO_CGROUP (Linux 5.7+), falling back to a cgroup.procs write
+ * once it has exec'd; if that write fails the child is killed and reaped
+ * and its error returned. */
+pid_t spawn_process(const struct spawn_request *req, int *pidfd);
+
+#endif /* SPAWN_LAUNCHER_H */
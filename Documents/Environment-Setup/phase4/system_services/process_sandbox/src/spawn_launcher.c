@@ -0,0 +1,385 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <signal.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <sys/syscall.h>
+#include "../include/spawn_launcher.h"
+
+/* Process launcher shared by the service manager, container runtime and
+ * application sandbox. The fast path clones with CLONE_VM|CLONE_VFORK on a
+ * small private stack, so no page tables are copied however large the
+ * caller is, and execs the target directly unless the command line needs
+ * a shell. Setup or exec failures in the child are reported back to the
+ * caller instead of surfacing later as a mysterious exit status 127. */
+
+#ifndef CLONE_PIDFD
+#define CLONE_PIDFD 0x00001000
+#endif
+#ifndef CLONE_INTO_CGROUP
+#define CLONE_INTO_CGROUP 0x200000000ULL
+#endif
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open 434
+#endif
+#ifndef SYS_clone3
+#define SYS_clone3 435
+#endif
+#ifndef SYS_pidfd_send_signal
+#define SYS_pidfd_send_signal 424
+#endif
+
+/* struct clone_args up to CLONE_ARGS_SIZE_VER2, which added cgroup */
+struct spawn_clone_args {
+    uint64_t flags;
+    uint64_t pidfd;
+    uint64_t child_tid;
+    uint64_t parent_tid;
+    uint64_t exit_signal;
+    uint64_t stack;
+    uint64_t stack_size;
+    uint64_t tls;
+    uint64_t set_tid;
+    uint64_t set_tid_size;
+    uint64_t cgroup;
+};
+
+#define SHELL_METACHARACTERS "|&;<>()$`\\\"'*?[]#~=%{}!\n"
+#define DEFAULT_PATH "/usr/local/bin:/usr/bin:/bin"
+
+extern char **environ;
+
+struct spawn_child {
+    const struct spawn_request *req;
+    const char *path;
+    char *const *argv;
+    int error_fd;           // Fork mode: write end of the CLOEXEC error pipe
+    volatile int error;     // Vfork mode: written by the child, read by the parent
+};
+
+static enum spawn_mode default_mode = SPAWN_MODE_DEFAULT;
+
+void spawn_set_default_mode(enum spawn_mode mode) {
+    default_mode = mode;
+}
+
+enum spawn_mode spawn_default_mode(void) {
+    if (default_mode == SPAWN_MODE_DEFAULT) {
+        const char *env = getenv(SPAWN_MODE_ENV);
+        default_mode = (env && strcmp(env, "fork") == 0) ? SPAWN_MODE_FORK : SPAWN_MODE_VFORK;
+    }
+    return default_mode;
+}
+
+int spawn_command_needs_shell(const char *command) {
+    if (!command || !command[strspn(command, " \t")]) {
+        return 1;
+    }
+    return command[strcspn(command, SHELL_METACHARACTERS)] != '\0';
+}
+
+/* Splits in place on blanks; returns the word count or -E2BIG */
+static int split_words(char *line, char **argv) {
+    int argc = 0;
+
+    for (char *save = NULL, *word = strtok_r(line, " \t", &save); word;
+         word = strtok_r(NULL, " \t", &save)) {
+        if (argc >= SPAWN_MAX_ARGS) {
+            return -E2BIG;
+        }
+        argv[argc++] = word;
+    }
+
+    argv[argc] = NULL;
+    return argc;
+}
+
+/* PATH lookup happens in the parent so the child only has to execve() */
+static int resolve_executable(const char *name, char *out, size_t len) {
+    if (strchr(name, '/')) {
+        if ((size_t)snprintf(out, len, "%s", name) >= len) {
+            return -ENAMETOOLONG;
+        }
+        return 0;
+    }
+
+    const char *path = getenv("PATH");
+    if (!path || !*path) {
+        path = DEFAULT_PATH;
+    }
+
+    while (*path) {
+        size_t dir_len = strcspn(path, ":");
+        if (dir_len > 0 && (size_t)snprintf(out, len, "%.*s/%s", (int)dir_len, path, name) < len &&
+            access(out, X_OK) == 0) {
+            return 0;
+        }
+        path += dir_len;
+        if (*path == ':') {
+            path++;
+        }
+    }
+
+    return -ENOENT;
+}
+
+/* Common child body; returns a positive errno if the launch failed */
+static int child_run(struct spawn_child *child) {
+    const struct spawn_request *req = child->req;
+    sigset_t empty;
+
+    // Handlers installed by the parent must never run in the child
+    for (int sig = 1; sig < _NSIG; sig++) {
+        struct sigaction sa;
+        if (sig == SIGKILL || sig == SIGSTOP || sigaction(sig, NULL, &sa) < 0) {
+            continue;
+        }
+        if (sa.sa_handler == SIG_DFL || sa.sa_handler == SIG_IGN) {
+            continue;
+        }
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = SIG_DFL;
+        sigaction(sig, &sa, NULL);
+    }
+
+    if (req->setup) {
+        int ret = req->setup(req->setup_arg);
+        if (ret < 0) {
+            return -ret;
+        }
+    }
+
+    if (req->drop_privileges) {
+        // Raw syscalls: glibc's setuid() signals every thread it knows of,
+        // which for a CLONE_VM child are the parent's threads
+        if (syscall(SYS_setgid, req->gid) < 0 || syscall(SYS_setuid, req->uid) < 0) {
+            return errno;
+        }
+    }
+
+    sigemptyset(&empty);
+    sigprocmask(SIG_SETMASK, &empty, NULL);
+
+    execve(child->path, child->argv, req->envp ? req->envp : environ);
+    return errno;
+}
+
+static int vfork_entry(void *arg) {
+    struct spawn_child *child = arg;
+
+    child->error = child_run(child);
+    _exit(127);
+}
+
+static pid_t spawn_vfork(struct spawn_child *child, int *pidfd) {
+    void *stack = mmap(NULL, SPAWN_STACK_SIZE, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+    if (stack == MAP_FAILED) {
+        return -errno;
+    }
+
+    // The parent is suspended until the child execs or exits
+    int flags = CLONE_VM | CLONE_VFORK | SIGCHLD;
+    int fd = -1;
+    pid_t pid = clone(vfork_entry, (char *)stack + SPAWN_STACK_SIZE,
+                      flags | (pidfd ? CLONE_PIDFD : 0), child, &fd);
+    if (pid < 0 && pidfd && errno == EINVAL) {
+        // Pre-5.2 kernel without CLONE_PIDFD
+        fd = -1;
+        pid = clone(vfork_entry, (char *)stack + SPAWN_STACK_SIZE, flags, child);
+    }
+    int err = errno;
+
+    munmap(stack, SPAWN_STACK_SIZE);
+
+    if (pid < 0) {
+        return -err;
+    }
+
+    if (child->error) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        waitpid(pid, NULL, 0);
+        return -child->error;
+    }
+
+    if (pidfd) {
+        *pidfd = fd;
+    }
+    return pid;
+}
+
+/* fork(), or clone3() into a cgroup; the child reports errors over a pipe */
+static pid_t spawn_fork(struct spawn_child *child, int *pidfd, int cgroup_fd) {
+    int pipefd[2];
+    int fd = -1;
+    pid_t pid;
+
+    if (pipe2(pipefd, O_CLOEXEC) < 0) {
+        return -errno;
+    }
+
+    if (cgroup_fd >= 0) {
+        // No CLONE_VM: the child runs on a copy of this stack, so the raw
+        // syscall returning twice is as safe as fork()
+        struct spawn_clone_args args;
+        memset(&args, 0, sizeof(args));
+        args.flags = CLONE_INTO_CGROUP | CLONE_PIDFD;
+        args.pidfd = (uint64_t)(uintptr_t)&fd;
+        args.exit_signal = SIGCHLD;
+        args.cgroup = cgroup_fd;
+        pid = syscall(SYS_clone3, &args, sizeof(args));
+    } else {
+        pid = fork();
+    }
+
+    if (pid < 0) {
+        int err = -errno;
+        close(pipefd[0]);
+        close(pipefd[1]);
+        return err;
+    }
+
+    if (pid == 0) {
+        close(pipefd[0]);
+        child->error_fd = pipefd[1];
+
+        int err = child_run(child);
+        while (write(child->error_fd, &err, sizeof(err)) < 0 && errno == EINTR) {
+        }
+        _exit(127);
+    }
+
+    close(pipefd[1]);
+
+    // EOF means the CLOEXEC pipe was closed by a successful exec
+    int err = 0;
+    ssize_t n;
+    do {
+        n = read(pipefd[0], &err, sizeof(err));
+    } while (n < 0 && errno == EINTR);
+    close(pipefd[0]);
+
+    if (n == sizeof(err)) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        waitpid(pid, NULL, 0);
+        return -err;
+    }
+
+    if (pidfd) {
+        *pidfd = fd >= 0 ? fd : syscall(SYS_pidfd_open, pid, 0);
+        if (*pidfd < 0) {
+            *pidfd = -1;
+        }
+    } else if (fd >= 0) {
+        close(fd);
+    }
+    return pid;
+}
+
+/* Pre-5.7 kernels: move the already running child. It has exec'd by
+ * now (vfork returns after the exec, fork's error pipe waits for it), so
+ * it ran its first instructions outside the cgroup's limits; anything it
+ * forked before the move stays outside them too. */
+static int move_to_cgroup(int cgroup_fd, pid_t pid) {
+    char buf[32];
+    int len = snprintf(buf, sizeof(buf), "%d\n", (int)pid);
+
+    int fd = openat(cgroup_fd, "cgroup.procs", O_WRONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -errno;
+    }
+
+    int ret = write(fd, buf, len) == len ? 0 : -errno;
+    close(fd);
+    return ret;
+}
+
+pid_t spawn_process(const struct spawn_request *req, int *pidfd) {
+    char *shell_argv[] = { "sh", "-c", NULL, NULL };
+    char *words[SPAWN_MAX_ARGS + 1];
+    char resolved[PATH_MAX];
+    char *line = NULL;
+
+    if (pidfd) {
+        *pidfd = -1;
+    }
+
+    if (!req || (!req->command && (!req->path || !req->argv))) {
+        return -EINVAL;
+    }
+
+    enum spawn_mode mode = req->mode == SPAWN_MODE_DEFAULT ? spawn_default_mode() : req->mode;
+
+    struct spawn_child child;
+    memset(&child, 0, sizeof(child));
+    child.req = req;
+    child.error_fd = -1;
+
+    if (req->argv) {
+        child.path = req->path;
+        child.argv = req->argv;
+    } else if (mode == SPAWN_MODE_VFORK && !spawn_command_needs_shell(req->command) &&
+               (line = strdup(req->command)) != NULL &&
+               split_words(line, words) > 0 &&
+               resolve_executable(words[0], resolved, sizeof(resolved)) == 0) {
+        child.path = resolved;
+        child.argv = words;
+    } else {
+        // Metacharacters, or a name only the shell can resolve
+        shell_argv[2] = (char *)req->command;
+        child.path = "/bin/sh";
+        child.argv = shell_argv;
+    }
+
+    // Keep signal handlers out of the child until it has reset them
+    sigset_t all, saved;
+    sigfillset(&all);
+    sigprocmask(SIG_BLOCK, &all, &saved);
+
+    pid_t pid = -ENOSYS;
+    if (req->into_cgroup) {
+        // CLONE_INTO_CGROUP needs clone3, which cannot share our memory
+        // without an assembly trampoline - trade the page-table copy for
+        // never having to migrate the child afterwards
+        pid = spawn_fork(&child, pidfd, req->cgroup_fd);
+    }
+    if (pid == -ENOSYS || pid == -E2BIG) {
+        pid = mode == SPAWN_MODE_FORK ? spawn_fork(&child, pidfd, -1)
+                                      : spawn_vfork(&child, pidfd);
+        if (pid > 0 && req->into_cgroup) {
+            int ret = move_to_cgroup(req->cgroup_fd, pid);
+            if (ret < 0) {
+                // Never leave a limited child running unconfined; it is
+                // still unreaped, so the pid cannot have been reused
+                if (pidfd && *pidfd >= 0) {
+                    syscall(SYS_pidfd_send_signal, *pidfd, SIGKILL, NULL, 0);
+                    close(*pidfd);
+                    *pidfd = -1;
+                } else {
+                    kill(pid, SIGKILL);
+                }
+                waitpid(pid, NULL, 0);
+                fprintf(stderr, "spawn: cannot move PID %d into cgroup: %s\n",
+                        pid, strerror(-ret));
+                pid = ret;
+            }
+        }
+    }
+
+    sigprocmask(SIG_SETMASK, &saved, NULL);
+    free(line);
+
+    return pid;
+}
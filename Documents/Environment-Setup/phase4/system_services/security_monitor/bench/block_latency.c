@@ -0,0 +1,177 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <sys/wait.h>
+#include "../include/security_monitor.h"
+
+/* Block rule reaction latency: forks a victim, reports a matching event
+ * for it and times how long until the kernel reports it stopped (or dead
+ * with --kill), as seen by waitpid(). Optional producer threads flood the
+ * ring with non-matching events and a consumer thread runs the batch
+ * passes meanwhile, so the latency is measured under ingestion load.
+ *
+ * Usage: block_latency [--iterations N] [--load THREADS] [--kill] */
+
+static atomic_int running = 1;
+
+static double now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void *producer(void *arg) {
+    struct security_event event;
+
+    (void)arg;
+    memset(&event, 0, sizeof(event));
+    event.type = EVENT_FILE_ACCESS;
+    event.pid = getpid();
+    snprintf(event.process_name, sizeof(event.process_name), "load");
+    snprintf(event.details, sizeof(event.details), "open /var/lib/secureos/state");
+    while (atomic_load(&running)) {
+        add_security_event(&event);
+    }
+    return NULL;
+}
+
+static void *consumer(void *arg) {
+    (void)arg;
+    while (atomic_load(&running)) {
+        process_security_events();
+        check_security_violations();
+    }
+    return NULL;
+}
+
+static void report(const char *name, double *samples, int count) {
+    qsort(samples, count, sizeof(*samples), compare_double);
+    printf("%-18s %10.1f %10.1f %10.1f %10.1f\n", name, samples[count / 2],
+           samples[(int)(count * 0.99)], samples[(int)(count * 0.999)], samples[count - 1]);
+}
+
+int main(int argc, char *argv[]) {
+    int iterations = 1000;
+    int load = 0;
+    int action = 2;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+            iterations = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--load") == 0 && i + 1 < argc) {
+            load = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--kill") == 0) {
+            action = 3;
+        } else {
+            fprintf(stderr, "Usage: %s [--iterations N] [--load THREADS] [--kill]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (iterations <= 0 || load < 0) {
+        return 1;
+    }
+
+    char rules_path[] = "/tmp/block_latency_rules.XXXXXX";
+    int fd = mkstemp(rules_path);
+    if (fd < 0) {
+        perror("mkstemp");
+        return 1;
+    }
+    dprintf(fd, "1 %d exploit %d 1\n", EVENT_PRIVILEGE_ESCALATION, action);
+    close(fd);
+
+    if (init_security_monitor() < 0 || load_security_rules(rules_path) != 1) {
+        fprintf(stderr, "Security monitor setup failed\n");
+        unlink(rules_path);
+        return 1;
+    }
+    unlink(rules_path);
+
+    pthread_t threads[64];
+    int thread_count = 0;
+    if (load > 0) {
+        pthread_create(&threads[thread_count++], NULL, consumer, NULL);
+        for (int i = 0; i < load && thread_count < 64; i++) {
+            pthread_create(&threads[thread_count++], NULL, producer, NULL);
+        }
+    }
+
+    double *returned = calloc(iterations, sizeof(*returned));
+    double *stopped = calloc(iterations, sizeof(*stopped));
+    if (!returned || !stopped) {
+        perror("calloc");
+        return 1;
+    }
+
+    int failures = 0;
+    for (int i = 0; i < iterations; i++) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            perror("fork");
+            return 1;
+        }
+        if (pid == 0) {
+            for (;;) {
+                pause();
+            }
+        }
+
+        struct security_event event;
+        memset(&event, 0, sizeof(event));
+        event.type = EVENT_PRIVILEGE_ESCALATION;
+        event.pid = pid;
+        event.uid = getuid();
+        snprintf(event.process_name, sizeof(event.process_name), "victim");
+        snprintf(event.details, sizeof(event.details), "setuid exploit attempt %d", i);
+
+        int status;
+        double start = now_us();
+        add_security_event(&event);     // Enforces even when the ring is full
+        returned[i] = now_us() - start;
+        waitpid(pid, &status, WUNTRACED);
+        stopped[i] = now_us() - start;
+
+        if (action == 3 ? !WIFSIGNALED(status) : !WIFSTOPPED(status)) {
+            failures++;
+        }
+        if (WIFSTOPPED(status)) {
+            kill(pid, SIGKILL);
+            waitpid(pid, &status, 0);
+        }
+    }
+
+    atomic_store(&running, 0);
+    for (int i = 0; i < thread_count; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    struct security_monitor_stats stats;
+    get_security_monitor_stats(&stats);
+
+    printf("SecureOS block latency: %d iterations, %s, %d load threads\n", iterations,
+           action == 3 ? "kill" : "freeze", load);
+    printf("%-18s %10s %10s %10s %10s\n", "microseconds", "p50", "p99", "p99.9", "max");
+    report("event returned", returned, iterations);
+    report(action == 3 ? "victim dead" : "victim stopped", stopped, iterations);
+    printf("blocked %llu, failed %llu, load events %llu (dropped %llu)\n", stats.blocked,
+           stats.block_failed, stats.accepted, stats.dropped);
+
+    free(returned);
+    free(stopped);
+    if (failures > 0) {
+        fprintf(stderr, "%d victims were not stopped\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,190 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <time.h>
+#include <syslog.h>
+#include "../include/security_monitor.h"
+#include "audit_sink.h"
+
+/* Rule evaluation throughput against the number of rule workers: loads
+ * synthetic rules, then times process_security_events() over batches of
+ * events with long details from many pids, for 1, 2, 4... workers up to
+ * the online CPU count (or --max-workers). Alerts go to an audit sink log
+ * file. Every worker count must report the same number of rule hits.
+ *
+ * Usage: shard_bench [--rules N] [--events N] [--batch N] [--max-workers N] */
+
+#define EVENT_TYPES 7
+#define VOCABULARY 4096
+#define PIDS 512
+
+static uint64_t rng_state = 0x9e3779b97f4a7c15ULL;
+
+static uint32_t next_random(void) {
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return (uint32_t)((rng_state * 2685821657736338717ULL) >> 32);
+}
+
+static void random_word(char *word, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        word[i] = 'a' + next_random() % 26;
+    }
+    word[len] = '\0';
+}
+
+static double elapsed_seconds(const struct timespec *start, const struct timespec *end) {
+    return (end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+int main(int argc, char *argv[]) {
+    int rule_count = MAX_RULES;
+    int event_count = 200000;
+    int batch = 8192;
+    long max_workers = sysconf(_SC_NPROCESSORS_ONLN);
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--rules") == 0 && i + 1 < argc) {
+            rule_count = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--events") == 0 && i + 1 < argc) {
+            event_count = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+            batch = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--max-workers") == 0 && i + 1 < argc) {
+            max_workers = atol(argv[++i]);
+        } else {
+            fprintf(stderr, "Usage: %s [--rules N] [--events N] [--batch N] [--max-workers N]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+
+    // Batches must fit in both the ring and the store
+    if (rule_count <= 0 || rule_count > MAX_RULES || event_count <= 0 || batch <= 0 ||
+        batch > MAX_EVENTS || batch > SECURITY_EVENT_RING_SIZE) {
+        fprintf(stderr, "Invalid arguments\n");
+        return 1;
+    }
+    if (max_workers < 1) {
+        max_workers = 1;
+    }
+
+    static char vocabulary[VOCABULARY][16];
+    for (int i = 0; i < VOCABULARY; i++) {
+        random_word(vocabulary[i], 4 + next_random() % 8);
+    }
+
+    char rules_path[] = "/tmp/shard_bench_rules.XXXXXX";
+    int fd = mkstemp(rules_path);
+    if (fd < 0) {
+        perror("mkstemp");
+        return 1;
+    }
+    for (int i = 0; i < rule_count; i++) {
+        // Pairs of words rarely occur together, so most events match nothing
+        dprintf(fd, "%d %d %s%s %d 1\n", i + 1, (int)(next_random() % EVENT_TYPES),
+                vocabulary[next_random() % VOCABULARY],
+                i % 8 == 0 ? "" : vocabulary[next_random() % VOCABULARY], i % 2);
+    }
+    close(fd);
+
+    char log_path[] = "/tmp/shard_bench_log.XXXXXX";
+    fd = mkstemp(log_path);
+    if (fd < 0) {
+        perror("mkstemp");
+        unlink(rules_path);
+        return 1;
+    }
+    close(fd);
+
+    struct audit_sink_config sink = { "shard_bench", LOG_AUTH, log_path };
+    if (audit_sink_open(&sink) < 0 || init_security_monitor() < 0 ||
+        load_security_rules(rules_path) != rule_count) {
+        fprintf(stderr, "Security monitor setup failed\n");
+        unlink(rules_path);
+        unlink(log_path);
+        return 1;
+    }
+    unlink(rules_path);
+
+    // Pregenerated so the timed loop only measures evaluation
+    struct security_event *events = calloc(batch, sizeof(*events));
+    if (!events) {
+        perror("calloc");
+        return 1;
+    }
+    for (int i = 0; i < batch; i++) {
+        struct security_event *event = &events[i];
+        size_t len = 0;
+
+        event->type = next_random() % EVENT_TYPES;
+        event->pid = 1000 + next_random() % PIDS;
+        event->uid = 1000;
+        snprintf(event->process_name, sizeof(event->process_name), "worker%d", event->pid);
+        while (len < 200) {
+            const char *word = vocabulary[next_random() % VOCABULARY];
+            len += snprintf(event->details + len, sizeof(event->details) - len, "%s ", word);
+        }
+    }
+
+    printf("SecureOS rule workers: %d rules, %d events, batches of %d\n", rule_count,
+           event_count, batch);
+    printf("%8s %14s %10s %8s\n", "workers", "events/sec", "speedup", "hits");
+
+    double baseline = 0;
+    long long baseline_hits = -1;
+    int mismatch = 0;
+
+    for (long workers = 1; ; workers *= 2) {
+        if (workers > max_workers) {
+            workers = max_workers;
+        }
+        if (set_security_rule_workers((int)workers) < 0) {
+            fprintf(stderr, "Cannot start %ld workers\n", workers);
+            break;
+        }
+        process_security_events();  // Builds the per-worker matchers
+
+        long long hits = 0;
+        double seconds = 0;
+        for (int done = 0; done < event_count; done += batch) {
+            int count = event_count - done < batch ? event_count - done : batch;
+            struct timespec start, end;
+
+            for (int i = 0; i < count; i++) {
+                add_security_event(&events[i]);
+            }
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            hits += process_security_events();
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            seconds += elapsed_seconds(&start, &end);
+        }
+
+        double rate = event_count / seconds;
+        if (workers == 1) {
+            baseline = rate;
+            baseline_hits = hits;
+        } else if (hits != baseline_hits) {
+            mismatch = 1;
+        }
+        printf("%8ld %14.0f %9.2fx %8lld\n", workers, rate, rate / baseline, hits);
+
+        if (workers == max_workers) {
+            break;
+        }
+    }
+
+    set_security_rule_workers(1);
+    audit_sink_close();
+    unlink(log_path);
+    free(events);
+
+    if (mismatch) {
+        fprintf(stderr, "Rule hits differ between worker counts\n");
+        return 1;
+    }
+    return 0;
+}
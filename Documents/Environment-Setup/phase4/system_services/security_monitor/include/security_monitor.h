@@ -4,8 +4,13 @@
 #include <sys/types.h>
 #include <time.h>
 
-#define MAX_EVENTS 10000
+#define MAX_EVENTS 10000 // Consumed events kept for check_security_violations()
 #define MAX_RULES 1000
+#define SECURITY_EVENT_RING_SIZE 16384 // Pending events; power of two
+#define SECURITY_SHARD_MIN_BATCH 1024 // Smaller batches skip the rule worker pool
+#define SECURITY_BLOCK_CGROUP_ROOT "/sys/fs/cgroup/secureos.slice" // Service cgroups
+#define SECURITY_BLOCK_CGROUP_ROOT_ENV "SECUREOS_CGROUP_ROOT" // Overrides SECURITY_BLOCK_CGROUP_ROOT
+#define SECURITY_ENFORCE_MAX_AGE 5 // Seconds; older correlation hits are logged, not enforced
 
 enum security_event_type {
     EVENT_PROCESS_START = 1,
@@ -32,14 +37,115 @@ struct security_rule {
     int rule_id;
     enum security_event_type event_type;
     char pattern[256];
-    int action; // 0=log, 1=alert, 2=block
+    int action; // 0=log, 1=alert, 2=block (freeze), 3=kill
     int enabled;
 };
 
+/* Fires when threshold events of event_type arrive within window seconds
+ * from the same key: the uid, the pid, or both, per the key flags */
+#define SECURITY_CORRELATE_UID 0x1
+#define SECURITY_CORRELATE_PID 0x2
+
+struct security_correlation_rule {
+    int rule_id;
+    enum security_event_type event_type;
+    int key;        // SECURITY_CORRELATE_* flags
+    int threshold;
+    int window;     // Seconds
+    int action;     // As for security_rule
+};
+
+struct security_monitor_stats {
+    unsigned long long accepted;    // Queued by add_security_event()
+    unsigned long long dropped;     // Rejected because the ring was full
+    unsigned long long overwritten; // Evicted from history before rules ran on them
+    unsigned long long correlation_keys;    // Sliding windows currently tracked
+    unsigned long long correlation_evicted; // Windows reclaimed to make room
+    unsigned long long blocked;     // Processes frozen or killed by block/kill rules
+    unsigned long long block_failed;
+    unsigned long long kernel_lost; // Collector overruns (proc connector ENOBUFS, fanotify overflow)
+    unsigned long long journal_dropped; // Not journaled after a write error; a gap in journal seqs
+    unsigned long long rules_generation;    // Rule sets published so far, counting the initial empty one
+};
+
+/* A consumer's own read position in the event history. Events are
+ * numbered from 0 in arrival order; next is the first one not yet read,
+ * and missed counts those evicted before the cursor got to them. */
+struct security_event_cursor {
+    unsigned long long next;
+    unsigned long long missed;
+};
+
 int init_security_monitor(void);
+/* Safe to call from any number of threads; -EAGAIN when the ring is full.
+ * Block and kill rules are matched here, on the caller's thread, and the
+ * offending process is stopped before this returns, even if the event
+ * itself is dropped for want of room. A process in one of the service
+ * cgroups under SECURITY_BLOCK_CGROUP_ROOT is stopped with its whole
+ * cgroup (cgroup.freeze or cgroup.kill), any other with SIGSTOP or SIGKILL
+ * through a pidfd. Other rules run in process_security_events(). */
 int add_security_event(struct security_event *event);
+/* load_security_rules() adds a file's rules to those in force;
+ * reload_security_rules() replaces all of them, correlation rules
+ * included. Either compiles the new set on the caller's thread and swaps
+ * it in atomically, so event processing goes on meanwhile with the old
+ * set, and returns once the old set is freed. On error the old set stays
+ * in force. Callable from any thread but the consumer's pool workers. */
 int load_security_rules(const char *rules_file);
+int reload_security_rules(const char *rules_file);
+/* Also loaded from rules file lines of the form
+ * "correlate <id> <event_type> <uid|pid|uid+pid> <threshold> <window> <action>" */
+int add_correlation_rule(const struct security_correlation_rule *rule);
+/* Both only look at events that arrived since their previous call */
 int process_security_events(void);
+/* Rule evaluation threads for process_security_events(), the consumer
+ * thread included; 0 means one per online CPU. Events are sharded by pid,
+ * so one process's events are still evaluated in order, and each worker
+ * logs its alerts through the audit sink. Returns the count in use.
+ * Call it on the consumer thread, between process_security_events()
+ * calls: it stops and respawns the pool, which must not be running a
+ * batch meanwhile. */
+int set_security_rule_workers(int count);
 int check_security_violations(void);
+int get_security_monitor_stats(struct security_monitor_stats *stats);
+
+/* Independent readers (exporters, forwarders), on the consumer thread.
+ * A new cursor starts at the oldest event still held. security_event_next()
+ * returns 1 with the next event copied out, or 0 when caught up. */
+void security_event_cursor_init(struct security_event_cursor *cursor);
+int security_event_next(struct security_event_cursor *cursor, struct security_event *event);
+
+/* Kernel event sources, each on its own thread: the netlink proc
+ * connector for EVENT_PROCESS_START (fork, exec), EVENT_PROCESS_EXIT and
+ * EVENT_PRIVILEGE_ESCALATION (a uid change that gains root), and fanotify
+ * for EVENT_FILE_ACCESS (opens and writes on the mounts of watch_paths,
+ * NULL meaning "/"). event_types is a mask of SECURITY_EVENT_BIT()s;
+ * records of other types are filtered out in the kernel where possible,
+ * and a collector nothing in the mask needs is not started. Needs
+ * CAP_NET_ADMIN and CAP_SYS_ADMIN; all or nothing. */
+#define SECURITY_EVENT_BIT(type) (1u << (type))
+
+int start_security_collectors(unsigned int event_types, const char *const *watch_paths);
+void stop_security_collectors(void);
+
+/* Persists every event the consumer drains to an append-only journal of
+ * segment files in directory (created if missing), which outlives the
+ * in-memory history. Events are numbered on disk across restarts. NULL
+ * syncs and closes the journal. */
+int enable_security_journal(const char *directory);
+
+/* Read-only access to a journal, from any process; the segments are
+ * mapped, not loaded. security_journal_seek() positions the reader using
+ * the journal's sparse time index; security_journal_read() then returns 1
+ * with the next event at or after that time copied out (and its journal
+ * number in seq, if not NULL), or 0 at the end. Numbers skip the events
+ * a write error kept out of the journal (journal_dropped in the stats). */
+struct security_journal_reader;
+
+int security_journal_open(struct security_journal_reader **reader, const char *directory);
+int security_journal_seek(struct security_journal_reader *reader, time_t from);
+int security_journal_read(struct security_journal_reader *reader, struct security_event *event,
+                          unsigned long long *seq);
+void security_journal_close(struct security_journal_reader *reader);
 
 #endif /* SECURITY_MONITOR_H */
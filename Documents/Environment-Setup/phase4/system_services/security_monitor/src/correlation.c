@@ -0,0 +1,239 @@
+#include <string.h>
+#include <errno.h>
+#include "correlation.h"
+
+/* A window's buckets cover [slot - buckets + 1, slot], slot being the
+ * event timestamp divided by the bucket width; bucket i holds the count
+ * for the slots congruent to i. Moving to a later slot clears the buckets
+ * skipped over, at most CORRELATION_BUCKETS of them. The pool is threaded
+ * onto a doubly linked LRU list (most recent first) and hash chains, both
+ * by index; -1 ends a list. */
+
+#define TABLE_SIZE (CORRELATION_MAX_KEYS * 2)   // Power of two
+
+struct correlation_rule {
+    struct security_correlation_rule rule;
+    int64_t width;          // Seconds per bucket
+    int buckets;
+};
+
+struct correlation_window {
+    int32_t rule;           // Index into rules, -1 when the entry is free
+    uint32_t uid;
+    int32_t pid;
+    uint32_t sum;
+    int64_t slot;           // Slot of the newest bucket
+    int32_t lru_prev;
+    int32_t lru_next;
+    int32_t hash_next;
+    uint32_t counts[CORRELATION_BUCKETS];
+};
+
+static struct correlation_rule rules[CORRELATION_MAX_RULES];
+static int rule_count = 0;
+static struct correlation_window windows[CORRELATION_MAX_KEYS];
+static int32_t table[TABLE_SIZE];
+static int32_t lru_head = -1;
+static int32_t lru_tail = -1;
+static int window_count = 0;
+static unsigned long long evicted = 0;
+
+static void clear_windows(void) {
+    for (int i = 0; i < CORRELATION_MAX_KEYS; i++) {
+        windows[i].rule = -1;
+    }
+    for (int i = 0; i < TABLE_SIZE; i++) {
+        table[i] = -1;
+    }
+    lru_head = lru_tail = -1;
+    window_count = 0;
+}
+
+int correlation_init(void) {
+    memset(rules, 0, sizeof(rules));
+    rule_count = 0;
+    clear_windows();
+    evicted = 0;
+    return 0;
+}
+
+int correlation_check_rule(const struct security_correlation_rule *rule) {
+    if (!rule || rule->threshold <= 0 || rule->window <= 0 ||
+        (rule->key & ~(SECURITY_CORRELATE_UID | SECURITY_CORRELATE_PID))) {
+        return -EINVAL;
+    }
+    return 0;
+}
+
+int correlation_set_rules(const struct security_correlation_rule *new_rules, int count) {
+    if (count < 0 || count > CORRELATION_MAX_RULES) {
+        return -ENOSPC;
+    }
+    for (int i = 0; i < count; i++) {
+        if (correlation_check_rule(&new_rules[i]) < 0) {
+            return -EINVAL;
+        }
+    }
+
+    int same = count == rule_count;
+    for (int i = 0; same && i < count; i++) {
+        same = memcmp(&rules[i].rule, &new_rules[i], sizeof(new_rules[i])) == 0;
+    }
+    if (same) {
+        return 0;
+    }
+
+    clear_windows();
+    memset(rules, 0, sizeof(rules));
+    for (int i = 0; i < count; i++) {
+        struct correlation_rule *compiled = &rules[i];
+        compiled->rule = new_rules[i];
+        compiled->width = (new_rules[i].window + CORRELATION_BUCKETS - 1) / CORRELATION_BUCKETS;
+        compiled->buckets = (int)((new_rules[i].window + compiled->width - 1) / compiled->width);
+    }
+    rule_count = count;
+    return 0;
+}
+
+static uint32_t hash_key(int32_t rule, uint32_t uid, int32_t pid) {
+    uint64_t key = ((uint64_t)uid << 32) ^ (uint32_t)pid ^ ((uint64_t)rule << 56);
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    return (uint32_t)key & (TABLE_SIZE - 1);
+}
+
+static void lru_unlink(int32_t index) {
+    struct correlation_window *window = &windows[index];
+
+    if (window->lru_prev >= 0) {
+        windows[window->lru_prev].lru_next = window->lru_next;
+    } else {
+        lru_head = window->lru_next;
+    }
+    if (window->lru_next >= 0) {
+        windows[window->lru_next].lru_prev = window->lru_prev;
+    } else {
+        lru_tail = window->lru_prev;
+    }
+}
+
+static void lru_push_front(int32_t index) {
+    windows[index].lru_prev = -1;
+    windows[index].lru_next = lru_head;
+    if (lru_head >= 0) {
+        windows[lru_head].lru_prev = index;
+    } else {
+        lru_tail = index;
+    }
+    lru_head = index;
+}
+
+static void hash_unlink(int32_t index) {
+    struct correlation_window *window = &windows[index];
+    int32_t *link = &table[hash_key(window->rule, window->uid, window->pid)];
+
+    while (*link != index) {
+        link = &windows[*link].hash_next;
+    }
+    *link = window->hash_next;
+}
+
+/* Finds the key's window, taking a free entry or the least recently
+ * updated one when it has none. Leaves it at the front of the LRU list. */
+static struct correlation_window *lookup_window(int32_t rule, uint32_t uid, int32_t pid) {
+    uint32_t bucket = hash_key(rule, uid, pid);
+    int32_t index;
+
+    for (index = table[bucket]; index >= 0; index = windows[index].hash_next) {
+        struct correlation_window *window = &windows[index];
+        if (window->rule == rule && window->uid == uid && window->pid == pid) {
+            if (index != lru_head) {
+                lru_unlink(index);
+                lru_push_front(index);
+            }
+            return window;
+        }
+    }
+
+    if (window_count < CORRELATION_MAX_KEYS) {
+        index = window_count++;
+    } else {
+        index = lru_tail;
+        hash_unlink(index);
+        lru_unlink(index);
+        evicted++;
+    }
+
+    struct correlation_window *window = &windows[index];
+    memset(window->counts, 0, sizeof(window->counts));
+    window->rule = rule;
+    window->uid = uid;
+    window->pid = pid;
+    window->sum = 0;
+    window->slot = INT64_MIN;
+    window->hash_next = table[bucket];
+    table[bucket] = index;
+    lru_push_front(index);
+    return window;
+}
+
+/* Adds one event at slot; returns 1 when the window reaches threshold */
+static int window_count_event(struct correlation_window *window,
+                              const struct correlation_rule *rule, int64_t slot) {
+    int buckets = rule->buckets;
+
+    if (window->slot == INT64_MIN || slot - window->slot >= buckets) {
+        memset(window->counts, 0, sizeof(window->counts));
+        window->sum = 0;
+        window->slot = slot;
+    } else if (slot > window->slot) {
+        for (int64_t s = window->slot + 1; s <= slot; s++) {
+            uint32_t *count = &window->counts[s % buckets];
+            window->sum -= *count;
+            *count = 0;
+        }
+        window->slot = slot;
+    } else if (window->slot - slot >= buckets) {
+        return 0;   // Arrived after its window had already passed
+    }
+
+    window->counts[slot % buckets]++;
+    window->sum++;
+
+    if (window->sum >= (uint32_t)rule->rule.threshold) {
+        memset(window->counts, 0, sizeof(window->counts));
+        window->sum = 0;
+        return 1;
+    }
+    return 0;
+}
+
+int correlation_observe(const struct event_record *event,
+                        const struct security_correlation_rule **fired) {
+    int count = 0;
+    int64_t timestamp = event->timestamp < 0 ? 0 : event->timestamp;
+
+    for (int i = 0; i < rule_count; i++) {
+        const struct correlation_rule *rule = &rules[i];
+
+        if (rule->rule.event_type != event->type) {
+            continue;
+        }
+
+        uint32_t uid = (rule->rule.key & SECURITY_CORRELATE_UID) ? event->uid : 0;
+        int32_t pid = (rule->rule.key & SECURITY_CORRELATE_PID) ? event->pid : 0;
+        struct correlation_window *window = lookup_window(i, uid, pid);
+
+        if (window_count_event(window, rule, timestamp / rule->width)) {
+            fired[count++] = &rule->rule;
+        }
+    }
+
+    return count;
+}
+
+void correlation_stats(unsigned long long *keys, unsigned long long *evicted_keys) {
+    *keys = window_count;
+    *evicted_keys = evicted;
+}
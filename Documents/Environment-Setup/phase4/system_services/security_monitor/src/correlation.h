@@ -0,0 +1,39 @@
+#ifndef CORRELATION_H
+#define CORRELATION_H
+
+#include <stdint.h>
+#include "../include/security_monitor.h"
+#include "event_store.h"
+
+/* Streaming correlation for check_security_violations(). Every
+ * (rule, uid, pid) key seen gets a sliding window of its rule's length,
+ * split into at most CORRELATION_BUCKETS buckets of whole seconds with a
+ * running sum, so counting an event is O(1) and the window slides with
+ * bucket granularity. A rule that fires starts its key's window afresh.
+ *
+ * Windows live in a fixed pool of CORRELATION_MAX_KEYS entries, hashed by
+ * key and kept in LRU order; when the pool is full the least recently
+ * updated window is reused, which is normally one that has gone idle.
+ * Internal to the security monitor; called from the consumer thread. */
+
+#define CORRELATION_MAX_RULES 64
+#define CORRELATION_MAX_KEYS 4096
+#define CORRELATION_BUCKETS 16
+
+int correlation_init(void);
+/* 0 for a well-formed rule, -EINVAL otherwise */
+int correlation_check_rule(const struct security_correlation_rule *rule);
+/* Replaces the rules (CORRELATION_MAX_RULES at most, each checked). When
+ * they are the same as before, as after a reload that changed only match
+ * rules, the windows keep counting; otherwise they start afresh. */
+int correlation_set_rules(const struct security_correlation_rule *rules, int count);
+
+/* Counts event against every rule for its type. Returns how many rules
+ * fired, with pointers to them stored in fired[] (CORRELATION_MAX_RULES
+ * entries at most). */
+int correlation_observe(const struct event_record *event,
+                        const struct security_correlation_rule **fired);
+
+void correlation_stats(unsigned long long *keys, unsigned long long *evicted);
+
+#endif /* CORRELATION_H */
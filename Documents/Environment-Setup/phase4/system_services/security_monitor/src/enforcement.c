@@ -0,0 +1,184 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include "../include/security_monitor.h"
+#include "enforcement.h"
+
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open 434
+#endif
+#ifndef SYS_pidfd_send_signal
+#define SYS_pidfd_send_signal 424
+#endif
+
+#define ACTION_KILL 3
+
+static const char *cgroup_root_path(void) {
+    const char *root = getenv(SECURITY_BLOCK_CGROUP_ROOT_ENV);
+    return (root && *root) ? root : SECURITY_BLOCK_CGROUP_ROOT;
+}
+
+/* Directory fd of the service cgroup pid runs in, or -1. That is the
+ * child of the root its cgroup path passes through (never the root slice
+ * itself); the root's own path in the hierarchy is whatever tail of
+ * SECURITY_BLOCK_CGROUP_ROOT the process's path starts with, so the
+ * cgroup2 mount point does not matter. */
+static int open_service_cgroup(pid_t pid) {
+    char path[512], line[4096];
+    const char *root = cgroup_root_path();
+    size_t root_len = strlen(root);
+
+    snprintf(path, sizeof(path), "/proc/%d/cgroup", pid);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    ssize_t n = read(fd, line, sizeof(line) - 1);
+    close(fd);
+    if (n <= 0) {
+        return -1;
+    }
+    line[n] = '\0';
+
+    // The unified hierarchy's line is "0::<path>"
+    char *relative = strstr(line, "0::");
+    if (!relative || (relative != line && relative[-1] != '\n')) {
+        return -1;
+    }
+    relative += 3;
+    relative[strcspn(relative, "\n")] = '\0';
+
+    for (char *slash = strchr(relative + 1, '/'); slash; slash = strchr(slash + 1, '/')) {
+        size_t prefix = slash - relative;
+        if (prefix > root_len || strncmp(root + root_len - prefix, relative, prefix) != 0) {
+            continue;
+        }
+
+        size_t child = strcspn(slash + 1, "/");
+        if (child == 0 || (size_t)snprintf(path, sizeof(path), "%s/%.*s", root, (int)child,
+                                           slash + 1) >= sizeof(path)) {
+            return -1;
+        }
+        return open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    }
+    return -1;
+}
+
+static time_t boot_time = -1;
+static pthread_once_t boot_time_once = PTHREAD_ONCE_INIT;
+
+static void boot_time_init(void) {
+    char line[256];
+    FILE *stat = fopen("/proc/stat", "re");
+    if (!stat) {
+        return;
+    }
+    while (fgets(line, sizeof(line), stat)) {
+        long long btime;
+        if (sscanf(line, "btime %lld", &btime) == 1) {
+            boot_time = (time_t)btime;
+            break;
+        }
+    }
+    fclose(stat);
+}
+
+/* Wall-clock second pid started, or -1. Field 22 of /proc/<pid>/stat, in
+ * clock ticks since boot; the command name before it may hold spaces and
+ * parentheses, so parsing starts after the last ')'. */
+static time_t process_start_time(pid_t pid) {
+    char path[64], buf[1024];
+
+    pthread_once(&boot_time_once, boot_time_init);
+    long ticks = sysconf(_SC_CLK_TCK);
+    if (boot_time < 0 || ticks <= 0) {
+        return -1;
+    }
+
+    snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    ssize_t n = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (n <= 0) {
+        return -1;
+    }
+    buf[n] = '\0';
+
+    char *field = strrchr(buf, ')');
+    for (int i = 2; field && i < 22; i++) {
+        field = strchr(field + 1, ' ');
+    }
+    if (!field) {
+        return -1;
+    }
+    return boot_time + (time_t)(strtoull(field + 1, NULL, 10) / (unsigned long)ticks);
+}
+
+static int write_cgroup_file(int dir_fd, const char *file, const char *value) {
+    int fd = openat(dir_fd, file, O_WRONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -errno;
+    }
+
+    size_t len = strlen(value);
+    int ret = write(fd, value, len) == (ssize_t)len ? 0 : -errno;
+    close(fd);
+    return ret;
+}
+
+int enforce_process(pid_t pid, int action, time_t observed) {
+    int sig = action == ACTION_KILL ? SIGKILL : SIGSTOP;
+
+    if (pid <= 1 || pid == getpid()) {
+        return -EPERM;
+    }
+
+    int pidfd = syscall(SYS_pidfd_open, pid, 0);
+    if (pidfd < 0 && errno != ENOSYS) {
+        return -errno;          // ESRCH: already gone
+    }
+
+    // Read after pinning: a process started after the event is a new
+    // holder of a recycled pid. btime is rounded, so allow one second.
+    if (observed > 0) {
+        time_t started = process_start_time(pid);
+        if (started < 0 || started > observed + 1) {
+            if (pidfd >= 0) {
+                close(pidfd);
+            }
+            return -ESRCH;
+        }
+    }
+
+    if (pidfd < 0) {
+        return kill(pid, sig) < 0 ? -errno : 0;
+    }
+
+    int ret = -ENOENT;
+    int cgroup_fd = open_service_cgroup(pid);
+    if (cgroup_fd >= 0) {
+        // Still the process the cgroup was looked up for?
+        if (syscall(SYS_pidfd_send_signal, pidfd, 0, NULL, 0) == 0) {
+            ret = write_cgroup_file(cgroup_fd, action == ACTION_KILL ? "cgroup.kill" : "cgroup.freeze",
+                                    "1");
+        }
+        close(cgroup_fd);
+    }
+
+    // cgroup.kill needs Linux 5.14; a signal does for a single process
+    if (ret < 0) {
+        ret = syscall(SYS_pidfd_send_signal, pidfd, sig, NULL, 0) < 0 ? -errno : 0;
+    }
+    close(pidfd);
+    return ret;
+}
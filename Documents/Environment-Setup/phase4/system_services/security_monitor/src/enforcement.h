@@ -0,0 +1,20 @@
+#ifndef ENFORCEMENT_H
+#define ENFORCEMENT_H
+
+#include <sys/types.h>
+#include <time.h>
+
+/* Stops a process for a block (2) or kill (3) rule action. The process
+ * is pinned with a pidfd first, so the pid cannot be recycled between the
+ * cgroup lookup and the freeze or signal. That says nothing about an event
+ * that is already old: pass its timestamp as observed and a process that
+ * started after it (to /proc's one-second resolution) is refused with
+ * -ESRCH; 0 skips the check for an event reported as it happens. If the
+ * process runs in a service cgroup below SECURITY_BLOCK_CGROUP_ROOT, that
+ * whole cgroup is frozen or killed, which also catches anything it has
+ * forked; otherwise the pidfd gets SIGSTOP or SIGKILL. Safe to call from
+ * any thread; without observed, one open, one read and one write at most.
+ * Refuses pid 1 and the monitor itself. Internal to the security monitor. */
+int enforce_process(pid_t pid, int action, time_t observed);
+
+#endif /* ENFORCEMENT_H */
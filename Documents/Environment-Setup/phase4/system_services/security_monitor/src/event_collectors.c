@@ -0,0 +1,411 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <arpa/inet.h>
+#include <sys/eventfd.h>
+#include <sys/fanotify.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <linux/netlink.h>
+#include <linux/connector.h>
+#include <linux/cn_proc.h>
+#include <linux/filter.h>
+#include "../include/security_monitor.h"
+#include "event_collectors.h"
+
+/* The proc connector multicasts one netlink message per process event.
+ * A classic BPF filter on the socket drops, in the kernel, every record
+ * whose kind is not wanted and every per-thread record (a thread's fork,
+ * exec or exit carries a pid that differs from its tgid), so the
+ * collector only wakes for what it will report. fanotify marks carry only
+ * the FAN_OPEN/FAN_CLOSE_WRITE bits needed, and the monitor's own file
+ * activity (journal, rules) is skipped so it cannot feed back. */
+
+#define PROC_RCVBUF (1024 * 1024)
+#define FANOTIFY_BUFFER 8192
+#define PROC_EVENT_DATA (NLMSG_LENGTH(0) + sizeof(struct cn_msg))
+
+struct collector {
+    pthread_t thread;
+    int fd;
+    int running;
+};
+
+static struct collector proc_collector = { .fd = -1 };
+static struct collector file_collector = { .fd = -1 };
+static int stop_fd = -1;
+static unsigned int wanted_types = 0;
+static _Atomic unsigned long long lost = 0;
+
+static int wanted(enum security_event_type type) {
+    return (wanted_types & SECURITY_EVENT_BIT(type)) != 0;
+}
+
+/* Offset of a proc_event field within the netlink message */
+#define PROC_FIELD(field) (PROC_EVENT_DATA + offsetof(struct proc_event, field))
+
+/* Instruction indices in the filter below; jumps are relative */
+#define FILTER_FORK 5
+#define FILTER_PID 10
+#define FILTER_ACCEPT 15
+#define FILTER_DROP 16
+#define JUMP(from, to) ((to) - (from) - 1)
+
+static int proc_attach_filter(int fd) {
+    int fork_to = wanted(EVENT_PROCESS_START) ? FILTER_FORK : FILTER_DROP;
+    int exec_to = wanted(EVENT_PROCESS_START) ? FILTER_PID : FILTER_DROP;
+    int uid_to = wanted(EVENT_PRIVILEGE_ESCALATION) ? FILTER_PID : FILTER_DROP;
+    int exit_to = wanted(EVENT_PROCESS_EXIT) ? FILTER_PID : FILTER_DROP;
+    struct sock_filter code[] = {
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, PROC_FIELD(what)),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, htonl(PROC_EVENT_FORK), JUMP(1, fork_to), 0),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, htonl(PROC_EVENT_EXEC), JUMP(2, exec_to), 0),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, htonl(PROC_EVENT_UID), JUMP(3, uid_to), 0),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, htonl(PROC_EVENT_EXIT), JUMP(4, exit_to),
+                 JUMP(4, FILTER_DROP)),
+        // FILTER_FORK: keep new processes, not new threads
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, PROC_FIELD(event_data.fork.child_pid)),
+        BPF_STMT(BPF_ST, 0),
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, PROC_FIELD(event_data.fork.child_tgid)),
+        BPF_STMT(BPF_LDX | BPF_MEM, 0),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_X, 0, JUMP(9, FILTER_ACCEPT), JUMP(9, FILTER_DROP)),
+        // FILTER_PID: exec, uid and exit records all start with pid, tgid
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, PROC_FIELD(event_data.exec.process_pid)),
+        BPF_STMT(BPF_ST, 0),
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, PROC_FIELD(event_data.exec.process_tgid)),
+        BPF_STMT(BPF_LDX | BPF_MEM, 0),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_X, 0, JUMP(14, FILTER_ACCEPT), JUMP(14, FILTER_DROP)),
+        BPF_STMT(BPF_RET | BPF_K, 0xffffffff),     // FILTER_ACCEPT
+        BPF_STMT(BPF_RET | BPF_K, 0),              // FILTER_DROP
+    };
+    struct sock_fprog program = { .len = sizeof(code) / sizeof(code[0]), .filter = code };
+
+    return setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &program, sizeof(program)) < 0 ? -errno : 0;
+}
+
+static int proc_subscribe(int fd) {
+    struct {
+        struct nlmsghdr header;
+        struct cn_msg message;
+        enum proc_cn_mcast_op op;
+    } __attribute__((packed)) request;
+
+    memset(&request, 0, sizeof(request));
+    request.header.nlmsg_len = sizeof(request);
+    request.header.nlmsg_type = NLMSG_DONE;
+    request.header.nlmsg_pid = getpid();
+    request.message.id.idx = CN_IDX_PROC;
+    request.message.id.val = CN_VAL_PROC;
+    request.message.len = sizeof(request.op);
+    request.op = PROC_CN_MCAST_LISTEN;
+
+    return send(fd, &request, sizeof(request), 0) < 0 ? -errno : 0;
+}
+
+static int proc_open(void) {
+    int fd = socket(PF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, NETLINK_CONNECTOR);
+    if (fd < 0) {
+        return -errno;
+    }
+
+    struct sockaddr_nl address;
+    memset(&address, 0, sizeof(address));
+    address.nl_family = AF_NETLINK;
+    address.nl_groups = CN_IDX_PROC;
+
+    int size = PROC_RCVBUF;
+    if (setsockopt(fd, SOL_SOCKET, SO_RCVBUFFORCE, &size, sizeof(size)) < 0) {
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    }
+
+    int ret;
+    if (bind(fd, (struct sockaddr *)&address, sizeof(address)) < 0) {
+        ret = -errno;
+    } else if ((ret = proc_attach_filter(fd)) == 0) {
+        ret = proc_subscribe(fd);
+    }
+    if (ret < 0) {
+        close(fd);
+        return ret;
+    }
+    return fd;
+}
+
+/* Name and effective ids from /proc; the process may already be gone */
+static void describe_process(struct security_event *event, pid_t pid) {
+    char path[64];
+    struct stat st;
+
+    snprintf(path, sizeof(path), "/proc/%d", pid);
+    if (stat(path, &st) == 0) {
+        event->uid = st.st_uid;
+        event->gid = st.st_gid;
+    }
+
+    snprintf(path, sizeof(path), "/proc/%d/comm", pid);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd >= 0) {
+        ssize_t n = read(fd, event->process_name, sizeof(event->process_name) - 1);
+        if (n > 0) {
+            event->process_name[n - (event->process_name[n - 1] == '\n')] = '\0';
+        }
+        close(fd);
+    }
+}
+
+static void proc_record(const struct proc_event *record) {
+    struct security_event event;
+    pid_t pid;
+
+    memset(&event, 0, sizeof(event));
+    event.uid = event.gid = (uid_t)-1;     // Unless /proc still has the process
+    switch (record->what) {
+        case PROC_EVENT_FORK:
+            pid = record->event_data.fork.child_tgid;
+            event.type = EVENT_PROCESS_START;
+            event.severity = 1;
+            describe_process(&event, pid);
+            snprintf(event.details, sizeof(event.details), "fork parent %d",
+                     record->event_data.fork.parent_tgid);
+            break;
+
+        case PROC_EVENT_EXEC: {
+            char path[64];
+            pid = record->event_data.exec.process_tgid;
+            event.type = EVENT_PROCESS_START;
+            event.severity = 1;
+            describe_process(&event, pid);
+            memcpy(event.details, "exec ", 5);
+            snprintf(path, sizeof(path), "/proc/%d/exe", pid);
+            ssize_t n = readlink(path, event.details + 5, sizeof(event.details) - 6);
+            event.details[n > 0 ? 5 + n : 4] = '\0';
+            break;
+        }
+
+        case PROC_EVENT_UID:
+            // Dropping privileges is routine; only gaining root is reported
+            if (record->event_data.id.e.euid != 0 || record->event_data.id.r.ruid == 0) {
+                return;
+            }
+            pid = record->event_data.id.process_tgid;
+            event.type = EVENT_PRIVILEGE_ESCALATION;
+            event.severity = 6;
+            describe_process(&event, pid);
+            event.uid = record->event_data.id.r.ruid;
+            snprintf(event.details, sizeof(event.details), "setuid ruid %u euid %u",
+                     record->event_data.id.r.ruid, record->event_data.id.e.euid);
+            break;
+
+        case PROC_EVENT_EXIT:
+            pid = record->event_data.exit.process_tgid;
+            event.type = EVENT_PROCESS_EXIT;
+            event.severity = 1;
+            describe_process(&event, pid);
+            snprintf(event.details, sizeof(event.details), "exit code %u signal %u",
+                     record->event_data.exit.exit_code >> 8, record->event_data.exit.exit_code & 0x7f);
+            break;
+
+        default:
+            return;
+    }
+
+    event.pid = pid;
+    add_security_event(&event);
+}
+
+static void *proc_collect(void *arg) {
+    struct pollfd fds[2] = { { .fd = proc_collector.fd, .events = POLLIN },
+                             { .fd = stop_fd, .events = POLLIN } };
+    _Alignas(struct nlmsghdr) char buffer[4096];
+
+    (void)arg;
+    while (poll(fds, 2, -1) >= 0 || errno == EINTR) {
+        if (fds[1].revents) {
+            break;
+        }
+        if (!(fds[0].revents & POLLIN)) {
+            continue;
+        }
+
+        for (;;) {
+            ssize_t n = recv(proc_collector.fd, buffer, sizeof(buffer), 0);
+            if (n < 0) {
+                if (errno == ENOBUFS) {
+                    atomic_fetch_add_explicit(&lost, 1, memory_order_relaxed);
+                    continue;
+                }
+                break;      // EAGAIN: drained
+            }
+
+            for (struct nlmsghdr *header = (struct nlmsghdr *)buffer; NLMSG_OK(header, (size_t)n);
+                 header = NLMSG_NEXT(header, n)) {
+                struct cn_msg *message = NLMSG_DATA(header);
+                if (header->nlmsg_len < PROC_EVENT_DATA + sizeof(struct proc_event) ||
+                    message->id.idx != CN_IDX_PROC || message->id.val != CN_VAL_PROC) {
+                    continue;
+                }
+                proc_record((const struct proc_event *)message->data);
+            }
+        }
+    }
+    return NULL;
+}
+
+static int fanotify_open(const char *const *watch_paths) {
+    static const char *const root[] = { "/", NULL };
+    uint64_t mask = FAN_OPEN | FAN_CLOSE_WRITE;
+
+    int fd = fanotify_init(FAN_CLASS_NOTIF | FAN_CLOEXEC | FAN_NONBLOCK, O_RDONLY | O_LARGEFILE | O_CLOEXEC);
+    if (fd < 0) {
+        return -errno;
+    }
+
+    for (const char *const *path = watch_paths ? watch_paths : root; *path; path++) {
+        if (fanotify_mark(fd, FAN_MARK_ADD | FAN_MARK_MOUNT, mask, AT_FDCWD, *path) < 0) {
+            int ret = -errno;
+            close(fd);
+            return ret;
+        }
+    }
+    return fd;
+}
+
+static void file_record(const struct fanotify_event_metadata *record, pid_t self) {
+    struct security_event event;
+    char path[64];
+
+    if (record->pid == self) {
+        return;
+    }
+
+    memset(&event, 0, sizeof(event));
+    event.uid = event.gid = (uid_t)-1;
+    event.type = EVENT_FILE_ACCESS;
+    event.pid = record->pid;
+    event.severity = 1;
+    describe_process(&event, record->pid);
+
+    const char *verb = (record->mask & FAN_CLOSE_WRITE) ? "write " : "open ";
+    size_t prefix = strlen(verb);
+    memcpy(event.details, verb, prefix);
+    snprintf(path, sizeof(path), "/proc/self/fd/%d", record->fd);
+    ssize_t n = readlink(path, event.details + prefix, sizeof(event.details) - prefix - 1);
+    event.details[n > 0 ? prefix + n : prefix - 1] = '\0';
+
+    add_security_event(&event);
+}
+
+static void *file_collect(void *arg) {
+    struct pollfd fds[2] = { { .fd = file_collector.fd, .events = POLLIN },
+                             { .fd = stop_fd, .events = POLLIN } };
+    _Alignas(struct fanotify_event_metadata) char buffer[FANOTIFY_BUFFER];
+    pid_t self = getpid();
+
+    (void)arg;
+    while (poll(fds, 2, -1) >= 0 || errno == EINTR) {
+        if (fds[1].revents) {
+            break;
+        }
+        if (!(fds[0].revents & POLLIN)) {
+            continue;
+        }
+
+        ssize_t n;
+        while ((n = read(file_collector.fd, buffer, sizeof(buffer))) > 0) {
+            struct fanotify_event_metadata *record = (struct fanotify_event_metadata *)buffer;
+            for (; FAN_EVENT_OK(record, n); record = FAN_EVENT_NEXT(record, n)) {
+                if (record->vers != FANOTIFY_METADATA_VERSION) {
+                    continue;
+                }
+                if (record->mask & FAN_Q_OVERFLOW) {
+                    atomic_fetch_add_explicit(&lost, 1, memory_order_relaxed);
+                }
+                if (record->fd >= 0) {
+                    file_record(record, self);
+                    close(record->fd);
+                }
+            }
+        }
+    }
+    return NULL;
+}
+
+static int collector_start(struct collector *collector, int fd, void *(*run)(void *)) {
+    collector->fd = fd;
+    int ret = pthread_create(&collector->thread, NULL, run, NULL);
+    if (ret != 0) {
+        close(fd);
+        collector->fd = -1;
+        return -ret;
+    }
+    collector->running = 1;
+    return 0;
+}
+
+static void collector_stop(struct collector *collector) {
+    if (collector->running) {
+        pthread_join(collector->thread, NULL);
+        collector->running = 0;
+    }
+    if (collector->fd >= 0) {
+        close(collector->fd);
+        collector->fd = -1;
+    }
+}
+
+int event_collectors_start(unsigned int event_types, const char *const *watch_paths) {
+    int ret = 0;
+
+    if (stop_fd >= 0) {
+        return -EBUSY;
+    }
+
+    stop_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (stop_fd < 0) {
+        return -errno;
+    }
+    wanted_types = event_types;
+
+    if (wanted(EVENT_PROCESS_START) || wanted(EVENT_PROCESS_EXIT) ||
+        wanted(EVENT_PRIVILEGE_ESCALATION)) {
+        int fd = proc_open();
+        ret = fd < 0 ? fd : collector_start(&proc_collector, fd, proc_collect);
+    }
+
+    if (ret == 0 && wanted(EVENT_FILE_ACCESS)) {
+        int fd = fanotify_open(watch_paths);
+        ret = fd < 0 ? fd : collector_start(&file_collector, fd, file_collect);
+    }
+
+    if (ret < 0) {
+        event_collectors_stop();
+    }
+    return ret;
+}
+
+void event_collectors_stop(void) {
+    if (stop_fd < 0) {
+        return;
+    }
+
+    uint64_t one = 1;
+    if (write(stop_fd, &one, sizeof(one)) < 0) {
+        // Cannot fail on a fresh eventfd; the joins below would hang otherwise
+    }
+    collector_stop(&proc_collector);
+    collector_stop(&file_collector);
+    close(stop_fd);
+    stop_fd = -1;
+}
+
+unsigned long long event_collectors_lost(void) {
+    return atomic_load_explicit(&lost, memory_order_relaxed);
+}
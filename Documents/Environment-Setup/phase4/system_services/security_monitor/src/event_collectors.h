@@ -0,0 +1,13 @@
+#ifndef EVENT_COLLECTORS_H
+#define EVENT_COLLECTORS_H
+
+/* Producer threads behind start_security_collectors(). Each converts
+ * kernel records into a security_event on its own stack and hands it to
+ * add_security_event(): nothing is allocated per record. Internal to the
+ * security monitor. */
+
+int event_collectors_start(unsigned int event_types, const char *const *watch_paths);
+void event_collectors_stop(void);
+unsigned long long event_collectors_lost(void);
+
+#endif /* EVENT_COLLECTORS_H */
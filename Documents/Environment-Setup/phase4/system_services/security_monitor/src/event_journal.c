@@ -0,0 +1,771 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "../include/security_monitor.h"
+#include "event_journal.h"
+
+#define JOURNAL_PREFIX "events-"
+#define JOURNAL_SEGMENT_SUFFIX ".journal"
+#define JOURNAL_INDEX_SUFFIX ".index"
+#define JOURNAL_NAME_MAX 64
+#define INDEX_PENDING_MAX 64
+
+/* Writer state. segment_size counts the bytes of the current segment,
+ * buffered ones included, so it is also the offset of the next record. */
+struct journal_writer {
+    int dir_fd;                 // Holds the flock() that keeps out a second writer
+    int fd;
+    int index_fd;               // -1 after an index write failed
+    uint64_t next_seq;
+    uint64_t segment_size;
+    uint64_t segment_records;
+    int64_t max_timestamp;      // Over the current segment so far
+    unsigned char *buffer;
+    size_t buffered;
+    struct journal_index_entry pending[INDEX_PENDING_MAX];
+    int pending_count;
+    uint64_t unsynced;          // Records written since the last fdatasync()
+    struct timespec synced_at;
+};
+
+struct security_journal_reader {
+    int dir_fd;
+    uint64_t *segments;         // First seq of each segment, ascending
+    int segment_count;
+    int current;
+    unsigned char *map;
+    size_t map_size;
+    uint64_t offset;
+    int64_t from;
+};
+
+static struct journal_writer writer = { .dir_fd = -1, .fd = -1, .index_fd = -1 };
+static uint32_t crc_table[256];
+static pthread_once_t crc_once = PTHREAD_ONCE_INIT;
+
+static void crc_table_init(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xedb88320u & -(crc & 1));
+        }
+        crc_table[i] = crc;
+    }
+}
+
+uint32_t journal_crc32(uint32_t crc, const void *data, size_t len) {
+    const unsigned char *bytes = data;
+
+    pthread_once(&crc_once, crc_table_init);
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++) {
+        crc = crc_table[(crc ^ bytes[i]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+static size_t record_size(size_t name_len, size_t details_len) {
+    return (sizeof(struct journal_record) + name_len + details_len + 7) & ~(size_t)7;
+}
+
+static void segment_name(char *name, uint64_t first_seq, const char *suffix) {
+    snprintf(name, JOURNAL_NAME_MAX, JOURNAL_PREFIX "%016llx%s",
+             (unsigned long long)first_seq, suffix);
+}
+
+static int parse_segment_name(const char *name, uint64_t *first_seq) {
+    unsigned long long seq;
+    int end = 0;
+
+    if (sscanf(name, JOURNAL_PREFIX "%16llx" JOURNAL_SEGMENT_SUFFIX "%n", &seq, &end) != 1 ||
+        end == 0 || name[end] != '\0' || strlen(name) != strlen(JOURNAL_PREFIX) + 16 +
+        strlen(JOURNAL_SEGMENT_SUFFIX)) {
+        return -EINVAL;
+    }
+    *first_seq = seq;
+    return 0;
+}
+
+static int compare_seq(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+/* First seqs of every segment in the directory, ascending */
+static int list_segments(int dir_fd, uint64_t **segments, int *count) {
+    int fd = dup(dir_fd);
+    if (fd < 0) {
+        return -errno;
+    }
+
+    DIR *dir = fdopendir(fd);
+    if (!dir) {
+        int ret = -errno;
+        close(fd);
+        return ret;
+    }
+    rewinddir(dir);
+
+    uint64_t *list = NULL;
+    int used = 0, capacity = 0;
+    struct dirent *entry;
+
+    while ((entry = readdir(dir)) != NULL) {
+        uint64_t seq;
+        if (parse_segment_name(entry->d_name, &seq) < 0) {
+            continue;
+        }
+        if (used == capacity) {
+            capacity = capacity ? capacity * 2 : 16;
+            uint64_t *grown = realloc(list, capacity * sizeof(*list));
+            if (!grown) {
+                free(list);
+                closedir(dir);
+                return -ENOMEM;
+            }
+            list = grown;
+        }
+        list[used++] = seq;
+    }
+    closedir(dir);
+
+    if (used > 0) {
+        qsort(list, used, sizeof(*list), compare_seq);
+    }
+    *segments = list;
+    *count = used;
+    return 0;
+}
+
+static int header_valid(const unsigned char *base, size_t size) {
+    struct journal_header header;
+
+    if (size < sizeof(header)) {
+        return 0;
+    }
+    memcpy(&header, base, sizeof(header));
+    return memcmp(header.magic, JOURNAL_MAGIC, sizeof(header.magic)) == 0 &&
+           header.version == JOURNAL_VERSION && header.header_size == sizeof(header) &&
+           header.crc == journal_crc32(0, &header, offsetof(struct journal_header, crc));
+}
+
+/* Length of the intact record at offset, or 0 if there is none */
+static size_t record_valid(const unsigned char *base, size_t size, uint64_t offset) {
+    struct journal_record record;
+
+    if (offset + sizeof(record) > size) {
+        return 0;
+    }
+    memcpy(&record, base + offset, sizeof(record));
+    if (record.length % 8 != 0 || record.length > size - offset ||
+        record.length != record_size(record.name_len, record.details_len) ||
+        record.name_len >= EVENT_NAME_MAX || record.details_len >= EVENT_DETAILS_MAX) {
+        return 0;
+    }
+
+    size_t covered = sizeof(record) + record.name_len + record.details_len - sizeof(record.crc);
+    if (journal_crc32(0, base + offset + sizeof(record.crc), covered) != record.crc) {
+        return 0;
+    }
+    return record.length;
+}
+
+static int map_file(int dir_fd, const char *name, unsigned char **map, size_t *size) {
+    int fd = openat(dir_fd, name, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -errno;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        int ret = -errno;
+        close(fd);
+        return ret;
+    }
+
+    *map = NULL;
+    *size = st.st_size;
+    if (*size > 0) {
+        void *addr = mmap(NULL, *size, PROT_READ, MAP_SHARED, fd, 0);
+        if (addr == MAP_FAILED) {
+            int ret = -errno;
+            close(fd);
+            return ret;
+        }
+        *map = addr;
+    }
+    close(fd);
+    return 0;
+}
+
+/* Writes out buffered records, then the index entries that point into
+ * them. Unwritten bytes stay buffered for the next attempt. */
+static int writer_flush(void) {
+    size_t done = 0;
+    int ret = 0;
+
+    while (done < writer.buffered) {
+        ssize_t n = write(writer.fd, writer.buffer + done, writer.buffered - done);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ret = -errno;
+            break;
+        }
+        done += n;
+    }
+    memmove(writer.buffer, writer.buffer + done, writer.buffered - done);
+    writer.buffered -= done;
+    if (ret < 0) {
+        return ret;
+    }
+
+    if (writer.pending_count > 0 && writer.index_fd >= 0) {
+        size_t len = writer.pending_count * sizeof(writer.pending[0]);
+        if (write(writer.index_fd, writer.pending, len) != (ssize_t)len) {
+            // A torn index would mislead readers; without one they scan
+            close(writer.index_fd);
+            writer.index_fd = -1;
+        }
+    }
+    writer.pending_count = 0;
+    return 0;
+}
+
+static int writer_sync(void) {
+    if (writer.unsynced == 0) {
+        return 0;
+    }
+    if (fdatasync(writer.fd) < 0) {
+        return -errno;
+    }
+    writer.unsynced = 0;
+    clock_gettime(CLOCK_MONOTONIC, &writer.synced_at);
+    return 0;
+}
+
+static void add_index_entry(uint64_t offset) {
+    writer.pending[writer.pending_count].max_timestamp = writer.max_timestamp;
+    writer.pending[writer.pending_count].offset = offset;
+    writer.pending_count++;
+}
+
+static int segment_create(uint64_t first_seq) {
+    char name[JOURNAL_NAME_MAX];
+    struct journal_header header;
+
+    segment_name(name, first_seq, JOURNAL_SEGMENT_SUFFIX);
+    int fd = openat(writer.dir_fd, name, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0640);
+    if (fd < 0) {
+        return -errno;
+    }
+
+    segment_name(name, first_seq, JOURNAL_INDEX_SUFFIX);
+    writer.index_fd = openat(writer.dir_fd, name, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0640);
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, JOURNAL_MAGIC, sizeof(header.magic));
+    header.version = JOURNAL_VERSION;
+    header.header_size = sizeof(header);
+    header.first_seq = first_seq;
+    header.created = time(NULL);
+    header.crc = journal_crc32(0, &header, offsetof(struct journal_header, crc));
+
+    writer.fd = fd;
+    memcpy(writer.buffer, &header, sizeof(header));
+    writer.buffered = sizeof(header);
+    writer.segment_size = sizeof(header);
+    writer.segment_records = 0;
+    writer.max_timestamp = INT64_MIN;
+    writer.pending_count = 0;
+
+    // Make the new names durable before anything is written to them
+    fsync(writer.dir_fd);
+    return 0;
+}
+
+/* Flushes and syncs the current segment and records where its data ends */
+static int segment_seal(void) {
+    if (writer.segment_records > 0) {
+        if (writer.pending_count == INDEX_PENDING_MAX) {
+            int ret = writer_flush();
+            if (ret < 0) {
+                return ret;
+            }
+        }
+        add_index_entry(writer.segment_size);
+    }
+
+    int ret = writer_flush();
+    if (ret < 0) {
+        return ret;
+    }
+    if (fdatasync(writer.fd) < 0) {
+        return -errno;
+    }
+    writer.unsynced = 0;
+
+    close(writer.fd);
+    writer.fd = -1;
+    if (writer.index_fd >= 0) {
+        close(writer.index_fd);
+        writer.index_fd = -1;
+    }
+    return 0;
+}
+
+/* Seq to continue from: one past the last intact record, and always
+ * past the first seq of the newest segment so its name is never reused */
+static int recover_next_seq(uint64_t *next_seq) {
+    uint64_t *segments;
+    int count;
+    int ret = list_segments(writer.dir_fd, &segments, &count);
+    if (ret < 0) {
+        return ret;
+    }
+
+    *next_seq = 0;
+    if (count == 0) {
+        free(segments);
+        return 0;
+    }
+    *next_seq = segments[count - 1] + 1;
+
+    for (int i = count - 1; i >= 0; i--) {
+        char name[JOURNAL_NAME_MAX];
+        unsigned char *map = NULL;
+        size_t size = 0;
+
+        segment_name(name, segments[i], JOURNAL_SEGMENT_SUFFIX);
+        if (map_file(writer.dir_fd, name, &map, &size) < 0 || !header_valid(map, size)) {
+            if (map) {
+                munmap(map, size);
+            }
+            continue;
+        }
+
+        uint64_t offset = sizeof(struct journal_header);
+        size_t len;
+        while ((len = record_valid(map, size, offset)) > 0) {
+            struct journal_record record;
+            memcpy(&record, map + offset, sizeof(record));
+            if (record.seq + 1 > *next_seq) {
+                *next_seq = record.seq + 1;
+            }
+            offset += len;
+        }
+        munmap(map, size);
+        break;
+    }
+
+    free(segments);
+    return 0;
+}
+
+int event_journal_open(const char *directory) {
+    if (writer.dir_fd >= 0) {
+        return -EBUSY;
+    }
+
+    if (mkdir(directory, 0750) < 0 && errno != EEXIST) {
+        return -errno;
+    }
+
+    writer.dir_fd = open(directory, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (writer.dir_fd < 0) {
+        return -errno;
+    }
+
+    int ret;
+    if (flock(writer.dir_fd, LOCK_EX | LOCK_NB) < 0) {
+        ret = errno == EWOULDBLOCK ? -EBUSY : -errno;
+        goto fail;
+    }
+
+    writer.buffer = malloc(JOURNAL_BUFFER_SIZE);
+    if (!writer.buffer) {
+        ret = -ENOMEM;
+        goto fail;
+    }
+
+    ret = recover_next_seq(&writer.next_seq);
+    if (ret < 0) {
+        goto fail;
+    }
+
+    ret = segment_create(writer.next_seq);
+    if (ret < 0) {
+        goto fail;
+    }
+
+    writer.unsynced = 0;
+    clock_gettime(CLOCK_MONOTONIC, &writer.synced_at);
+    return 0;
+
+fail:
+    free(writer.buffer);
+    writer.buffer = NULL;
+    close(writer.dir_fd);
+    writer.dir_fd = -1;
+    return ret;
+}
+
+/* Open even between segments: a rotation whose segment_create() failed
+ * leaves no segment fd, and the next append or commit tries again */
+int event_journal_is_open(void) {
+    return writer.dir_fd >= 0;
+}
+
+static int writer_segment(void) {
+    if (writer.dir_fd < 0) {
+        return -EBADF;
+    }
+    return writer.fd >= 0 ? 0 : segment_create(writer.next_seq);
+}
+
+int event_journal_append(const struct event_entry *entry) {
+    size_t size = record_size(entry->name_len, entry->details_len);
+    int ret = writer_segment();
+    if (ret < 0) {
+        return ret;
+    }
+
+    if (writer.segment_records > 0 && writer.segment_size + size > JOURNAL_SEGMENT_SIZE) {
+        ret = segment_seal();
+        if (ret < 0) {
+            return ret;
+        }
+        ret = segment_create(writer.next_seq);
+        if (ret < 0) {
+            return ret;
+        }
+    }
+
+    if (writer.buffered + size > JOURNAL_BUFFER_SIZE || writer.pending_count == INDEX_PENDING_MAX) {
+        ret = writer_flush();
+        if (ret < 0) {
+            return ret;
+        }
+    }
+
+    if (writer.segment_records % JOURNAL_INDEX_STRIDE == 0 && writer.segment_records > 0) {
+        add_index_entry(writer.segment_size);
+    }
+
+    struct journal_record record;
+    unsigned char *out = writer.buffer + writer.buffered;
+
+    memset(&record, 0, sizeof(record));
+    record.length = size;
+    record.seq = writer.next_seq;
+    record.timestamp = entry->timestamp;
+    record.pid = entry->pid;
+    record.uid = entry->uid;
+    record.gid = entry->gid;
+    record.type = entry->type;
+    record.severity = entry->severity;
+    record.name_len = entry->name_len;
+    record.details_len = entry->details_len;
+
+    memcpy(out, &record, sizeof(record));
+    memcpy(out + sizeof(record), entry->strings, entry->name_len);
+    memcpy(out + sizeof(record) + entry->name_len, entry->strings + entry->name_len + 1,
+           entry->details_len);
+    size_t used = sizeof(record) + entry->name_len + entry->details_len;
+    memset(out + used, 0, size - used);
+
+    record.crc = journal_crc32(0, out + sizeof(record.crc), used - sizeof(record.crc));
+    memcpy(out, &record.crc, sizeof(record.crc));
+
+    writer.buffered += size;
+    writer.segment_size += size;
+    writer.segment_records++;
+    writer.next_seq++;
+    writer.unsynced++;
+    if (entry->timestamp > writer.max_timestamp) {
+        writer.max_timestamp = entry->timestamp;
+    }
+    return 0;
+}
+
+void event_journal_skip(void) {
+    writer.next_seq++;
+}
+
+int event_journal_commit(void) {
+    int ret = writer_segment();
+    if (ret < 0) {
+        return ret;
+    }
+
+    ret = writer_flush();
+    if (ret < 0 || writer.unsynced == 0) {
+        return ret;
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long elapsed_ms = (now.tv_sec - writer.synced_at.tv_sec) * 1000 +
+                      (now.tv_nsec - writer.synced_at.tv_nsec) / 1000000;
+
+    if (writer.unsynced >= JOURNAL_SYNC_EVENTS || elapsed_ms >= JOURNAL_SYNC_INTERVAL_MS) {
+        return writer_sync();
+    }
+    return 0;
+}
+
+void event_journal_close(void) {
+    if (writer.fd >= 0) {
+        segment_seal();
+        if (writer.fd >= 0) {
+            close(writer.fd);
+            writer.fd = -1;
+        }
+    }
+    if (writer.index_fd >= 0) {
+        close(writer.index_fd);
+        writer.index_fd = -1;
+    }
+    if (writer.dir_fd >= 0) {
+        close(writer.dir_fd);
+        writer.dir_fd = -1;
+    }
+    free(writer.buffer);
+    writer.buffer = NULL;
+    writer.buffered = 0;
+}
+
+int security_journal_open(struct security_journal_reader **reader, const char *directory) {
+    if (!reader || !directory) {
+        return -EINVAL;
+    }
+
+    struct security_journal_reader *r = calloc(1, sizeof(*r));
+    if (!r) {
+        return -ENOMEM;
+    }
+
+    r->dir_fd = open(directory, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (r->dir_fd < 0) {
+        int ret = -errno;
+        free(r);
+        return ret;
+    }
+
+    int ret = list_segments(r->dir_fd, &r->segments, &r->segment_count);
+    if (ret < 0) {
+        close(r->dir_fd);
+        free(r);
+        return ret;
+    }
+
+    r->from = INT64_MIN;
+    r->offset = sizeof(struct journal_header);
+    *reader = r;
+    return 0;
+}
+
+static void reader_unmap(struct security_journal_reader *reader) {
+    if (reader->map) {
+        munmap(reader->map, reader->map_size);
+        reader->map = NULL;
+    }
+    reader->map_size = 0;
+}
+
+/* Offset in segment i from which records may be at or after from. Sets
+ * *past when the segment is sealed and holds nothing that late. */
+static uint64_t index_lookup(struct security_journal_reader *reader, int i, int64_t from, int *past) {
+    char name[JOURNAL_NAME_MAX];
+    unsigned char *map;
+    size_t size;
+    uint64_t start = sizeof(struct journal_header);
+
+    *past = 0;
+    segment_name(name, reader->segments[i], JOURNAL_INDEX_SUFFIX);
+    if (map_file(reader->dir_fd, name, &map, &size) < 0) {
+        return start;
+    }
+
+    const struct journal_index_entry *entries = (const struct journal_index_entry *)map;
+    size_t count = size / sizeof(*entries);
+    size_t low = 0, high = count;
+
+    // Entries ascend in both fields: find the last with max < from
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (entries[mid].max_timestamp < from) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    if (low > 0) {
+        start = entries[low - 1].offset;
+        if (low == count) {
+            // Past the last entry: a sealed segment's ends its data
+            struct stat st;
+            segment_name(name, reader->segments[i], JOURNAL_SEGMENT_SUFFIX);
+            *past = fstatat(reader->dir_fd, name, &st, 0) == 0 && (uint64_t)st.st_size == start;
+        }
+    }
+
+    if (map) {
+        munmap(map, size);
+    }
+    return start;
+}
+
+int security_journal_seek(struct security_journal_reader *reader, time_t from) {
+    if (!reader) {
+        return -EINVAL;
+    }
+
+    reader_unmap(reader);
+    reader->from = from;
+    reader->current = 0;
+    reader->offset = sizeof(struct journal_header);
+
+    for (int i = 0; i < reader->segment_count; i++) {
+        int past;
+        reader->current = i;
+        reader->offset = index_lookup(reader, i, from, &past);
+        if (!past) {
+            break;
+        }
+    }
+    return 0;
+}
+
+/* Maps the current segment again if the writer has grown it; 1 if so */
+static int reader_remap(struct security_journal_reader *reader) {
+    char name[JOURNAL_NAME_MAX];
+    unsigned char *map = NULL;
+    size_t size = 0;
+
+    segment_name(name, reader->segments[reader->current], JOURNAL_SEGMENT_SUFFIX);
+    if (map_file(reader->dir_fd, name, &map, &size) < 0) {
+        return 0;
+    }
+    if (size <= reader->map_size || !header_valid(map, size)) {
+        if (map) {
+            munmap(map, size);
+        }
+        return 0;
+    }
+
+    reader_unmap(reader);
+    reader->map = map;
+    reader->map_size = size;
+    return 1;
+}
+
+/* Moves to the next segment, listing the directory again after the last
+ * known one in case the writer has rotated since; 0 when there is none */
+static int reader_advance(struct security_journal_reader *reader) {
+    if (reader->current + 1 < reader->segment_count) {
+        reader->current++;
+    } else {
+        uint64_t *segments;
+        int count;
+        if (list_segments(reader->dir_fd, &segments, &count) < 0) {
+            return 0;
+        }
+
+        int next = 0;
+        if (reader->segment_count > 0) {
+            uint64_t current = reader->segments[reader->current];
+            while (next < count && segments[next] <= current) {
+                next++;
+            }
+            if (next == count) {
+                free(segments);
+                return 0;
+            }
+        } else if (count == 0) {
+            free(segments);
+            return 0;
+        }
+
+        free(reader->segments);
+        reader->segments = segments;
+        reader->segment_count = count;
+        reader->current = next;
+    }
+
+    reader_unmap(reader);
+    reader->offset = sizeof(struct journal_header);
+    return 1;
+}
+
+int security_journal_read(struct security_journal_reader *reader, struct security_event *event,
+                          unsigned long long *seq) {
+    if (!reader || !event) {
+        return -EINVAL;
+    }
+
+    for (;;) {
+        if (reader->segment_count == 0) {
+            if (!reader_advance(reader)) {
+                return 0;
+            }
+        }
+
+        size_t len = reader->map ? record_valid(reader->map, reader->map_size, reader->offset) : 0;
+
+        if (len == 0) {
+            if (reader_remap(reader)) {
+                continue;
+            }
+            // Torn or missing data ends a segment unless it is the newest one
+            if (!reader_advance(reader)) {
+                return 0;
+            }
+            continue;
+        }
+
+        struct journal_record record;
+        const unsigned char *data = reader->map + reader->offset;
+        memcpy(&record, data, sizeof(record));
+        reader->offset += len;
+
+        if (record.timestamp < reader->from) {
+            continue;
+        }
+
+        memset(event, 0, sizeof(*event));
+        event->type = (enum security_event_type)record.type;
+        event->timestamp = record.timestamp;
+        event->pid = record.pid;
+        event->uid = record.uid;
+        event->gid = record.gid;
+        event->severity = record.severity;
+        memcpy(event->process_name, data + sizeof(record), record.name_len);
+        memcpy(event->details, data + sizeof(record) + record.name_len, record.details_len);
+        if (seq) {
+            *seq = record.seq;
+        }
+        return 1;
+    }
+}
+
+void security_journal_close(struct security_journal_reader *reader) {
+    if (!reader) {
+        return;
+    }
+    reader_unmap(reader);
+    close(reader->dir_fd);
+    free(reader->segments);
+    free(reader);
+}
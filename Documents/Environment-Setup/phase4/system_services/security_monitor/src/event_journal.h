@@ -0,0 +1,78 @@
+#ifndef EVENT_JOURNAL_H
+#define EVENT_JOURNAL_H
+
+#include <stdint.h>
+#include "event_store.h"
+
+/* On-disk event journal. A journal directory holds segments named
+ * events-<first seq, 16 hex digits>.journal, each a fixed header followed
+ * by records, and next to each segment a sparse index, the same name with
+ * .index. A record is a fixed header, then the name and details without
+ * NULs, padded to 8 bytes; its CRC-32 covers everything after the crc
+ * field. A torn record at the end of a segment (crash mid-write) fails
+ * the CRC and ends that segment for readers; the writer always starts a
+ * new segment when it opens a journal.
+ *
+ * Index entry i says that every record before offset has a timestamp of
+ * at most max_timestamp. One is written every JOURNAL_INDEX_STRIDE records
+ * and a last one, offset at the end of the data, when a segment is sealed
+ * by rotation or close. The index is only a hint: a reader without it
+ * scans the segment from the start. */
+
+#define JOURNAL_MAGIC "SOSJRNL1"
+#define JOURNAL_VERSION 1
+#define JOURNAL_SEGMENT_SIZE (64 * 1024 * 1024)
+#define JOURNAL_INDEX_STRIDE 256
+#define JOURNAL_BUFFER_SIZE (256 * 1024)
+#define JOURNAL_SYNC_EVENTS 4096        // fdatasync at least this often...
+#define JOURNAL_SYNC_INTERVAL_MS 1000   // ...and this long after an unsynced write
+
+struct journal_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint64_t first_seq;
+    int64_t created;
+    uint8_t reserved[28];
+    uint32_t crc;               // Of the bytes before it
+};
+
+struct journal_record {
+    uint32_t crc;
+    uint32_t length;            // Whole record, padding included
+    uint64_t seq;
+    int64_t timestamp;
+    int32_t pid;
+    uint32_t uid;
+    uint32_t gid;
+    uint8_t type;
+    uint8_t severity;
+    uint16_t name_len;
+    uint16_t details_len;
+    uint16_t reserved16;
+    uint32_t reserved32;
+};
+
+struct journal_index_entry {
+    int64_t max_timestamp;
+    uint64_t offset;
+};
+
+/* Writer, on the consumer thread. event_journal_append() only buffers;
+ * event_journal_commit() writes the buffer out and calls fdatasync() when
+ * JOURNAL_SYNC_EVENTS or JOURNAL_SYNC_INTERVAL_MS have gone by since the
+ * last one. Both return -errno after a failed write; records already
+ * buffered are retried on later calls, as is a rotation that could not
+ * create the next segment, and the journal stays open meanwhile. An
+ * event whose append failed is not buffered: the caller drops it with
+ * event_journal_skip(), which burns its seq so readers see the gap. */
+int event_journal_open(const char *directory);
+int event_journal_append(const struct event_entry *entry);
+void event_journal_skip(void);
+int event_journal_commit(void);
+int event_journal_is_open(void);
+void event_journal_close(void);
+
+uint32_t journal_crc32(uint32_t crc, const void *data, size_t len);
+
+#endif /* EVENT_JOURNAL_H */
@@ -0,0 +1,115 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "event_ring.h"
+
+/* Each slot starts with a sequence number. For slot i in lap n it reads
+ * i + n*capacity when free, +1 once a producer has published into it;
+ * producers claim positions with a CAS on enqueue_pos, so the only shared
+ * write on the fast path is that one cache line. */
+
+struct event_slot {
+    _Atomic uint64_t sequence;
+    unsigned char payload[];
+};
+
+static struct event_slot *slot_at(const struct event_ring *ring, uint64_t pos) {
+    return (struct event_slot *)(ring->slots + (pos & ring->mask) * ring->slot_size);
+}
+
+int event_ring_init(struct event_ring *ring, size_t capacity, size_t elem_size) {
+    if (!ring || capacity < 2 || (capacity & (capacity - 1)) || elem_size == 0) {
+        return -EINVAL;
+    }
+
+    memset(ring, 0, sizeof(*ring));
+
+    // Whole cache lines per slot: neighbouring producers never share one
+    size_t slot_size = sizeof(struct event_slot) + elem_size;
+    slot_size = (slot_size + EVENT_RING_CACHELINE - 1) & ~(size_t)(EVENT_RING_CACHELINE - 1);
+
+    ring->slots = aligned_alloc(EVENT_RING_CACHELINE, capacity * slot_size);
+    if (!ring->slots) {
+        return -ENOMEM;
+    }
+
+    ring->slot_size = slot_size;
+    ring->mask = capacity - 1;
+    for (size_t i = 0; i < capacity; i++) {
+        atomic_init(&slot_at(ring, i)->sequence, i);
+    }
+    atomic_init(&ring->enqueue_pos, 0);
+    atomic_init(&ring->dropped, 0);
+    ring->dequeue_pos = 0;
+    return 0;
+}
+
+void event_ring_destroy(struct event_ring *ring) {
+    if (ring) {
+        free(ring->slots);
+        ring->slots = NULL;
+    }
+}
+
+void *event_ring_reserve(struct event_ring *ring, uint64_t *ticket) {
+    uint64_t pos = atomic_load_explicit(&ring->enqueue_pos, memory_order_relaxed);
+
+    for (;;) {
+        struct event_slot *slot = slot_at(ring, pos);
+        uint64_t seq = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        int64_t diff = (int64_t)(seq - pos);
+
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&ring->enqueue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                *ticket = pos;
+                return slot->payload;
+            }
+            // Lost the race; pos now holds the current value
+        } else if (diff < 0) {
+            // The consumer has not released this slot from the previous lap
+            atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+            return NULL;
+        } else {
+            pos = atomic_load_explicit(&ring->enqueue_pos, memory_order_relaxed);
+        }
+    }
+}
+
+void event_ring_commit(struct event_ring *ring, uint64_t ticket) {
+    atomic_store_explicit(&slot_at(ring, ticket)->sequence, ticket + 1, memory_order_release);
+}
+
+int event_ring_push(struct event_ring *ring, const void *elem, size_t len) {
+    uint64_t ticket;
+
+    void *payload = event_ring_reserve(ring, &ticket);
+    if (!payload) {
+        return -EAGAIN;
+    }
+
+    memcpy(payload, elem, len);
+    event_ring_commit(ring, ticket);
+    return 0;
+}
+
+void *event_ring_peek(struct event_ring *ring) {
+    struct event_slot *slot = slot_at(ring, ring->dequeue_pos);
+    uint64_t seq = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+
+    // Empty, or the producer that claimed this slot has not published yet
+    return seq == ring->dequeue_pos + 1 ? slot->payload : NULL;
+}
+
+void event_ring_release(struct event_ring *ring) {
+    struct event_slot *slot = slot_at(ring, ring->dequeue_pos);
+
+    atomic_store_explicit(&slot->sequence, ring->dequeue_pos + ring->mask + 1,
+                          memory_order_release);
+    ring->dequeue_pos++;
+}
+
+uint64_t event_ring_dropped(const struct event_ring *ring) {
+    return atomic_load_explicit((_Atomic uint64_t *)&ring->dropped, memory_order_relaxed);
+}
@@ -0,0 +1,38 @@
+#ifndef EVENT_RING_H
+#define EVENT_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+/* Bounded lock-free multi-producer single-consumer ring (Vyukov's
+ * sequence-numbered slots). Producers never block: a full ring counts a
+ * drop and returns -EAGAIN. Slots are reused as soon as the consumer
+ * releases them. Internal to the security monitor. */
+
+#define EVENT_RING_CACHELINE 64
+
+struct event_ring {
+    _Alignas(EVENT_RING_CACHELINE) _Atomic uint64_t enqueue_pos;
+    _Alignas(EVENT_RING_CACHELINE) uint64_t dequeue_pos;    // Consumer only
+    _Atomic uint64_t dropped;
+    uint64_t mask;
+    size_t slot_size;
+    unsigned char *slots;
+};
+
+int event_ring_init(struct event_ring *ring, size_t capacity, size_t elem_size);
+void event_ring_destroy(struct event_ring *ring);
+
+/* Producer: claim a slot, fill it in place, then publish it */
+void *event_ring_reserve(struct event_ring *ring, uint64_t *ticket);
+void event_ring_commit(struct event_ring *ring, uint64_t ticket);
+int event_ring_push(struct event_ring *ring, const void *elem, size_t len);
+
+/* Consumer: look at the oldest published element, then hand its slot back */
+void *event_ring_peek(struct event_ring *ring);
+void event_ring_release(struct event_ring *ring);
+
+uint64_t event_ring_dropped(const struct event_ring *ring);
+
+#endif /* EVENT_RING_H */
@@ -0,0 +1,261 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "event_store.h"
+
+/* Details slab layout: each entry is a 16-bit length, the text and its
+ * NUL, padded to an even size so the next length is aligned. An entry
+ * never wraps; the unused tail of the slab is marked with SLAB_PAD and
+ * skipped. slab_head and slab_tail are absolute byte counts, so the slab
+ * is full when head - tail would exceed its size. */
+
+#define SLAB_PAD 0xffff
+#define NAME_ARENA_MIN (64 * 1024)
+#define NAME_REF_EMPTY 0            // "" lives at offset 0 of every arena
+
+struct name_slot {
+    uint32_t hash;
+    uint32_t ref;                   // Arena offset + 1, 0 when empty
+};
+
+struct name_arena {
+    char *data;
+    size_t size;
+    size_t used;
+    struct name_slot *table;        // Power of two, at most 70% full
+    size_t table_size;
+    size_t table_used;
+};
+
+static struct event_record records[MAX_EVENTS];
+static uint64_t first = 0;
+static uint64_t total = 0;
+static _Alignas(uint16_t) unsigned char slab[EVENT_DETAILS_SLAB_SIZE];
+static uint64_t slab_head = 0;
+static uint64_t slab_tail = 0;
+static struct name_arena names;
+
+void event_entry_pack(struct event_entry *entry, const struct security_event *event) {
+    size_t name_len = strnlen(event->process_name, EVENT_NAME_MAX - 1);
+    size_t details_len = strnlen(event->details, EVENT_DETAILS_MAX - 1);
+
+    entry->timestamp = event->timestamp;
+    entry->pid = event->pid;
+    entry->uid = event->uid;
+    entry->gid = event->gid;
+    entry->type = (uint8_t)event->type;
+    entry->severity = event->severity < 0 ? 0 : event->severity > 255 ? 255 : event->severity;
+    entry->name_len = (uint16_t)name_len;
+    entry->details_len = (uint16_t)details_len;
+
+    memcpy(entry->strings, event->process_name, name_len);
+    entry->strings[name_len] = '\0';
+    memcpy(entry->strings + name_len + 1, event->details, details_len);
+    entry->strings[name_len + 1 + details_len] = '\0';
+}
+
+static uint32_t hash_string(const char *str, size_t len) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char)str[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static int arena_create(struct name_arena *arena, size_t size) {
+    size_t table_size = 256;
+    while (table_size < size / 16) {
+        table_size *= 2;
+    }
+
+    arena->data = malloc(size);
+    arena->table = calloc(table_size, sizeof(*arena->table));
+    if (!arena->data || !arena->table) {
+        free(arena->data);
+        free(arena->table);
+        return -ENOMEM;
+    }
+
+    arena->size = size;
+    arena->table_size = table_size;
+    arena->table_used = 0;
+    arena->data[NAME_REF_EMPTY] = '\0';
+    arena->used = 1;
+    return 0;
+}
+
+static void arena_free(struct name_arena *arena) {
+    free(arena->data);
+    free(arena->table);
+    memset(arena, 0, sizeof(*arena));
+}
+
+/* Returns the offset of name in the arena, adding it if needed; -ENOSPC
+ * when the arena or its table is full */
+static int64_t arena_intern(struct name_arena *arena, const char *name, size_t len) {
+    if (len == 0) {
+        return NAME_REF_EMPTY;
+    }
+
+    uint32_t hash = hash_string(name, len);
+    size_t mask = arena->table_size - 1;
+    size_t pos = hash & mask;
+
+    for (; arena->table[pos].ref; pos = (pos + 1) & mask) {
+        const char *candidate = arena->data + arena->table[pos].ref - 1;
+        if (arena->table[pos].hash == hash && memcmp(candidate, name, len) == 0 &&
+            candidate[len] == '\0') {
+            return arena->table[pos].ref - 1;
+        }
+    }
+
+    if (arena->used + len + 1 > arena->size ||
+        (arena->table_used + 1) * 10 > arena->table_size * 7) {
+        return -ENOSPC;
+    }
+
+    uint32_t ref = (uint32_t)arena->used;
+    memcpy(arena->data + ref, name, len);
+    arena->data[ref + len] = '\0';
+    arena->used += len + 1;
+    arena->table[pos].hash = hash;
+    arena->table[pos].ref = ref + 1;
+    arena->table_used++;
+    return ref;
+}
+
+/* Copies the names still referenced by retained records into a new arena
+ * of the given size, dropping those only evicted records used */
+static int arena_rebuild(size_t size) {
+    struct name_arena fresh;
+
+    int ret = arena_create(&fresh, size);
+    if (ret < 0) {
+        return ret;
+    }
+
+    for (uint64_t seq = first; seq < total; seq++) {
+        struct event_record *record = &records[seq % MAX_EVENTS];
+        const char *name = names.data + record->name_ref;
+        int64_t ref = arena_intern(&fresh, name, strlen(name));
+        if (ref < 0) {
+            arena_free(&fresh);
+            return (int)ref;
+        }
+        record->name_ref = (uint32_t)ref;
+    }
+
+    arena_free(&names);
+    names = fresh;
+    return 0;
+}
+
+static uint32_t intern_name(const char *name, size_t len) {
+    int64_t ref = arena_intern(&names, name, len);
+    if (ref != -ENOSPC) {
+        return (uint32_t)ref;
+    }
+
+    // Compact first; grow as well when live names fill over half of it
+    size_t size = names.size;
+    int ret;
+    while ((ret = arena_rebuild(size)) == -ENOSPC || (ret == 0 && names.used * 2 > names.size)) {
+        if (size > UINT32_MAX / 2) {
+            break;
+        }
+        size *= 2;
+    }
+
+    ref = arena_intern(&names, name, len);
+    // Out of memory: keep the event, lose only its process name
+    return ref < 0 ? NAME_REF_EMPTY : (uint32_t)ref;
+}
+
+static uint16_t slab_read_len(uint64_t pos) {
+    uint16_t len;
+    memcpy(&len, &slab[pos % EVENT_DETAILS_SLAB_SIZE], sizeof(len));
+    return len;
+}
+
+static size_t slab_entry_size(size_t len) {
+    return (sizeof(uint16_t) + len + 1 + 1) & ~(size_t)1;
+}
+
+static void evict_oldest(void) {
+    if (slab_read_len(slab_tail) == SLAB_PAD) {
+        slab_tail += EVENT_DETAILS_SLAB_SIZE - slab_tail % EVENT_DETAILS_SLAB_SIZE;
+    }
+    slab_tail += slab_entry_size(slab_read_len(slab_tail));
+    first++;
+}
+
+int event_store_init(void) {
+    first = total = 0;
+    slab_head = slab_tail = 0;
+
+    arena_free(&names);
+    return arena_create(&names, NAME_ARENA_MIN);
+}
+
+void event_store_append(const struct event_entry *entry) {
+    if (total - first == MAX_EVENTS) {
+        evict_oldest();
+    }
+
+    size_t size = slab_entry_size(entry->details_len);
+    size_t offset = slab_head % EVENT_DETAILS_SLAB_SIZE;
+    size_t pad = offset + size > EVENT_DETAILS_SLAB_SIZE ? EVENT_DETAILS_SLAB_SIZE - offset : 0;
+
+    // Long details cost history depth rather than memory
+    while (slab_head + pad + size - slab_tail > EVENT_DETAILS_SLAB_SIZE) {
+        evict_oldest();
+    }
+
+    if (pad) {
+        uint16_t marker = SLAB_PAD;
+        memcpy(&slab[offset], &marker, sizeof(marker));
+        slab_head += pad;
+        offset = 0;
+    }
+
+    uint16_t len = entry->details_len;
+    memcpy(&slab[offset], &len, sizeof(len));
+    memcpy(&slab[offset + sizeof(len)], entry->strings + entry->name_len + 1, len + 1);
+    slab_head += size;
+
+    struct event_record *record = &records[total % MAX_EVENTS];
+    record->timestamp = entry->timestamp;
+    record->pid = entry->pid;
+    record->uid = entry->uid;
+    record->gid = entry->gid;
+    record->type = entry->type;
+    record->severity = entry->severity;
+    record->details_len = len;
+    record->details_ref = (uint32_t)(offset + sizeof(len));
+    total++;
+
+    // Interned last: a rebuild walks the retained records, this one included
+    record->name_ref = NAME_REF_EMPTY;
+    record->name_ref = intern_name(entry->strings, entry->name_len);
+}
+
+uint64_t event_store_first(void) {
+    return first;
+}
+
+uint64_t event_store_total(void) {
+    return total;
+}
+
+const struct event_record *event_store_get(uint64_t seq) {
+    return &records[seq % MAX_EVENTS];
+}
+
+const char *event_store_name(const struct event_record *record) {
+    return names.data + record->name_ref;
+}
+
+const char *event_store_details(const struct event_record *record) {
+    return (const char *)&slab[record->details_ref];
+}
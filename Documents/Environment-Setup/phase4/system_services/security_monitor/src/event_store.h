@@ -0,0 +1,60 @@
+#ifndef EVENT_STORE_H
+#define EVENT_STORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "../include/security_monitor.h"
+
+/* Compact storage for the security monitor's event history. A record is
+ * 32 bytes of fixed fields plus references: process names are interned
+ * once in a shared arena (a handful of daemons produce most events) and
+ * details live in a circular, length-prefixed slab that is reclaimed in
+ * the same FIFO order as the records. Internal to the security monitor. */
+
+#define EVENT_NAME_MAX 256      // Matches security_event.process_name
+#define EVENT_DETAILS_MAX 512   // Matches security_event.details
+#define EVENT_DETAILS_SLAB_SIZE (1024 * 1024)
+
+/* What producers put in the ring: fixed fields followed by the name and
+ * details back to back, each NUL-terminated. Only the used bytes of
+ * strings[] are written. */
+struct event_entry {
+    int64_t timestamp;
+    int32_t pid;
+    uint32_t uid;
+    uint32_t gid;
+    uint8_t type;
+    uint8_t severity;
+    uint16_t name_len;
+    uint16_t details_len;
+    char strings[EVENT_NAME_MAX + EVENT_DETAILS_MAX];
+};
+
+struct event_record {
+    int64_t timestamp;
+    int32_t pid;
+    uint32_t uid;
+    uint32_t gid;
+    uint8_t type;
+    uint8_t severity;
+    uint16_t details_len;
+    uint32_t name_ref;      // Offset into the name arena
+    uint32_t details_ref;   // Offset of the details text in the slab
+};
+
+void event_entry_pack(struct event_entry *entry, const struct security_event *event);
+
+int event_store_init(void);
+
+/* Appends one drained entry, evicting the oldest records when the history
+ * or the details slab is full. Records are numbered from 0 in arrival
+ * order; [event_store_first(), event_store_total()) are retained. */
+void event_store_append(const struct event_entry *entry);
+uint64_t event_store_first(void);
+uint64_t event_store_total(void);
+
+const struct event_record *event_store_get(uint64_t seq);
+const char *event_store_name(const struct event_record *record);
+const char *event_store_details(const struct event_record *record);
+
+#endif /* EVENT_STORE_H */
@@ -0,0 +1,776 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "rule_dfa.h"
+
+/* The NFA is built Thompson-style; a fragment's dangling exits are chained
+ * through the exits themselves (state << 1, | 1 for out1) until patched.
+ * A DFA state is identified by the sorted list of NFA states it stands
+ * for, counting only states that consume a byte or accept. */
+
+enum nfa_kind {
+    NFA_BYTES,          // Consumes one byte from sets[arg]
+    NFA_SPLIT,
+    NFA_EMPTY,
+    NFA_ACCEPT,         // Rule arg matches
+    NFA_ACCEPT_END      // Rule arg matches if the text ends here
+};
+
+struct nfa_state {
+    int32_t kind;
+    int32_t out;
+    int32_t out1;
+    int32_t arg;
+};
+
+struct dfa_state {
+    uint32_t hash;
+    uint32_t set;       // Pool offsets and lengths
+    uint32_t set_len;
+    uint32_t accept;
+    uint32_t accept_len;
+    uint32_t accept_end;
+    uint32_t accept_end_len;
+};
+
+struct fragment {
+    int32_t start;
+    int32_t exits;
+};
+
+struct parser {
+    struct rule_dfa *dfa;
+    const char *p;
+    const char *end;
+    int glob;
+    int error;
+};
+
+#define TABLE_SIZE (RULE_DFA_CACHE_STATES * 2)
+#define POOL_MIN 65536
+
+static int32_t new_state(struct parser *ps, int32_t kind, int32_t out, int32_t out1, int32_t arg) {
+    struct rule_dfa *dfa = ps->dfa;
+
+    if (dfa->nfa_count == dfa->nfa_capacity) {
+        int capacity = dfa->nfa_capacity ? dfa->nfa_capacity * 2 : 64;
+        struct nfa_state *nfa = realloc(dfa->nfa, capacity * sizeof(*nfa));
+        if (!nfa) {
+            ps->error = -ENOMEM;
+            return -1;
+        }
+        dfa->nfa = nfa;
+        dfa->nfa_capacity = capacity;
+    }
+
+    struct nfa_state *state = &dfa->nfa[dfa->nfa_count];
+    state->kind = kind;
+    state->out = out;
+    state->out1 = out1;
+    state->arg = arg;
+    return dfa->nfa_count++;
+}
+
+static int32_t new_set(struct parser *ps, const uint8_t bits[32]) {
+    struct rule_dfa *dfa = ps->dfa;
+
+    if (dfa->set_count == dfa->set_capacity) {
+        int capacity = dfa->set_capacity ? dfa->set_capacity * 2 : 32;
+        uint8_t (*sets)[32] = realloc(dfa->sets, capacity * sizeof(*sets));
+        if (!sets) {
+            ps->error = -ENOMEM;
+            return -1;
+        }
+        dfa->sets = sets;
+        dfa->set_capacity = capacity;
+    }
+
+    memcpy(dfa->sets[dfa->set_count], bits, 32);
+    return dfa->set_count++;
+}
+
+static int32_t *exit_slot(struct rule_dfa *dfa, int32_t exit) {
+    struct nfa_state *state = &dfa->nfa[exit >> 1];
+    return (exit & 1) ? &state->out1 : &state->out;
+}
+
+static void patch(struct rule_dfa *dfa, int32_t exits, int32_t target) {
+    while (exits != -1) {
+        int32_t *slot = exit_slot(dfa, exits);
+        exits = *slot;
+        *slot = target;
+    }
+}
+
+static int32_t append_exits(struct rule_dfa *dfa, int32_t first, int32_t second) {
+    if (first == -1) {
+        return second;
+    }
+
+    int32_t exit = first;
+    while (*exit_slot(dfa, exit) != -1) {
+        exit = *exit_slot(dfa, exit);
+    }
+    *exit_slot(dfa, exit) = second;
+    return first;
+}
+
+static void set_bit(uint8_t bits[32], unsigned char byte) {
+    bits[byte >> 3] |= 1u << (byte & 7);
+}
+
+static int test_bit(const uint8_t bits[32], unsigned char byte) {
+    return bits[byte >> 3] & (1u << (byte & 7));
+}
+
+static void set_range(uint8_t bits[32], int lo, int hi) {
+    for (int b = lo; b <= hi; b++) {
+        set_bit(bits, (unsigned char)b);
+    }
+}
+
+/* \d \w \s and their negations; returns 0 if c is not a class escape */
+static int escape_class(char c, uint8_t bits[32]) {
+    uint8_t class[32] = { 0 };
+
+    switch (c | 0x20) {
+        case 'd':
+            set_range(class, '0', '9');
+            break;
+        case 'w':
+            set_range(class, '0', '9');
+            set_range(class, 'a', 'z');
+            set_range(class, 'A', 'Z');
+            set_bit(class, '_');
+            break;
+        case 's':
+            set_range(class, '\t', '\r');
+            set_bit(class, ' ');
+            break;
+        default:
+            return 0;
+    }
+
+    int negate = c >= 'A' && c <= 'Z';
+    for (int i = 0; i < 32; i++) {
+        bits[i] |= negate ? (uint8_t)~class[i] : class[i];
+    }
+    return 1;
+}
+
+static unsigned char escape_literal(char c) {
+    switch (c) {
+        case 'n': return '\n';
+        case 't': return '\t';
+        case 'r': return '\r';
+        default: return (unsigned char)c;
+    }
+}
+
+static struct fragment byte_fragment(struct parser *ps, const uint8_t bits[32]) {
+    struct fragment frag = { -1, -1 };
+    int32_t set = new_set(ps, bits);
+    if (set < 0) {
+        return frag;
+    }
+
+    frag.start = new_state(ps, NFA_BYTES, -1, -1, set);
+    frag.exits = frag.start << 1;
+    return frag;
+}
+
+static struct fragment parse_class(struct parser *ps) {
+    uint8_t bits[32] = { 0 };
+    struct fragment none = { -1, -1 };
+
+    ps->p++; // '['
+    int negate = ps->p < ps->end && (*ps->p == '^' || (ps->glob && *ps->p == '!'));
+    if (negate) {
+        ps->p++;
+    }
+
+    for (int first = 1; ps->p < ps->end && (*ps->p != ']' || first); first = 0) {
+        unsigned char lo = (unsigned char)*ps->p++;
+        if (lo == '\\' && ps->p < ps->end) {
+            char c = *ps->p++;
+            if (!ps->glob && escape_class(c, bits)) {
+                continue;
+            }
+            lo = ps->glob ? (unsigned char)c : escape_literal(c);
+        }
+
+        unsigned char hi = lo;
+        if (ps->p + 1 < ps->end && ps->p[0] == '-' && ps->p[1] != ']') {
+            hi = (unsigned char)ps->p[1];
+            ps->p += 2;
+            if (hi == '\\' && ps->p < ps->end) {
+                char c = *ps->p++;
+                hi = ps->glob ? (unsigned char)c : escape_literal(c);
+            }
+            if (lo > hi) {
+                ps->error = -EINVAL;
+                return none;
+            }
+        }
+        set_range(bits, lo, hi);
+    }
+
+    if (ps->p >= ps->end) {
+        ps->error = -EINVAL; // Unterminated class
+        return none;
+    }
+    ps->p++; // ']'
+
+    if (negate) {
+        for (int i = 0; i < 32; i++) {
+            bits[i] = (uint8_t)~bits[i];
+        }
+    }
+    return byte_fragment(ps, bits);
+}
+
+static struct fragment parse_alternation(struct parser *ps);
+
+static struct fragment parse_atom(struct parser *ps) {
+    uint8_t bits[32] = { 0 };
+    struct fragment none = { -1, -1 };
+    char c = *ps->p;
+
+    switch (c) {
+        case '(': {
+            ps->p++;
+            struct fragment frag = parse_alternation(ps);
+            if (ps->error) {
+                return none;
+            }
+            if (ps->p >= ps->end || *ps->p != ')') {
+                ps->error = -EINVAL;
+                return none;
+            }
+            ps->p++;
+            return frag;
+        }
+        case '[':
+            return parse_class(ps);
+        case '.':
+            memset(bits, 0xff, sizeof(bits));
+            ps->p++;
+            return byte_fragment(ps, bits);
+        case '*':
+        case '+':
+        case '?':
+            ps->error = -EINVAL; // Nothing to repeat
+            return none;
+        case '^':
+        case '$':
+            ps->error = -EINVAL; // Anchors only open or close a top-level branch
+            return none;
+        case '\\':
+            if (ps->p + 1 >= ps->end) {
+                ps->error = -EINVAL;
+                return none;
+            }
+            c = ps->p[1];
+            ps->p += 2;
+            if (!escape_class(c, bits)) {
+                set_bit(bits, escape_literal(c));
+            }
+            return byte_fragment(ps, bits);
+        default:
+            set_bit(bits, (unsigned char)c);
+            ps->p++;
+            return byte_fragment(ps, bits);
+    }
+}
+
+static struct fragment parse_repeat(struct parser *ps) {
+    struct fragment frag = parse_atom(ps);
+
+    while (!ps->error && ps->p < ps->end &&
+           (*ps->p == '*' || *ps->p == '+' || *ps->p == '?')) {
+        char op = *ps->p++;
+        int32_t split = new_state(ps, NFA_SPLIT, frag.start, -1, 0);
+        if (split < 0) {
+            break;
+        }
+
+        if (op == '*') {
+            patch(ps->dfa, frag.exits, split);
+            frag.start = split;
+            frag.exits = split << 1 | 1;
+        } else if (op == '+') {
+            patch(ps->dfa, frag.exits, split);
+            frag.exits = split << 1 | 1;
+        } else {
+            frag.start = split;
+            frag.exits = append_exits(ps->dfa, frag.exits, split << 1 | 1);
+        }
+    }
+
+    return frag;
+}
+
+static struct fragment parse_concatenation(struct parser *ps) {
+    struct fragment frag = { -1, -1 };
+
+    while (!ps->error && ps->p < ps->end && *ps->p != '|' && *ps->p != ')' && *ps->p != '$') {
+        struct fragment next = parse_repeat(ps);
+        if (ps->error) {
+            break;
+        }
+        if (frag.start < 0) {
+            frag = next;
+        } else {
+            patch(ps->dfa, frag.exits, next.start);
+            frag.exits = next.exits;
+        }
+    }
+
+    if (!ps->error && frag.start < 0) {
+        frag.start = new_state(ps, NFA_EMPTY, -1, -1, 0);
+        frag.exits = frag.start << 1;
+    }
+    return frag;
+}
+
+static struct fragment parse_alternation(struct parser *ps) {
+    struct fragment frag = parse_concatenation(ps);
+
+    while (!ps->error && ps->p < ps->end && *ps->p == '|') {
+        ps->p++;
+        struct fragment other = parse_concatenation(ps);
+        if (ps->error) {
+            break;
+        }
+        int32_t split = new_state(ps, NFA_SPLIT, frag.start, other.start, 0);
+        frag.start = split;
+        frag.exits = append_exits(ps->dfa, frag.exits, other.exits);
+    }
+
+    return frag;
+}
+
+/* A glob is a plain concatenation: * loops on any byte, ? is any byte */
+static struct fragment parse_glob(struct parser *ps) {
+    struct fragment frag = { -1, -1 };
+    uint8_t any[32];
+
+    memset(any, 0xff, sizeof(any));
+    while (!ps->error && ps->p < ps->end) {
+        struct fragment next;
+        uint8_t bits[32] = { 0 };
+
+        switch (*ps->p) {
+            case '*': {
+                ps->p++;
+                struct fragment loop = byte_fragment(ps, any);
+                int32_t split = new_state(ps, NFA_SPLIT, loop.start, -1, 0);
+                if (split < 0) {
+                    return frag;
+                }
+                patch(ps->dfa, loop.exits, split);
+                next.start = split;
+                next.exits = split << 1 | 1;
+                break;
+            }
+            case '?':
+                ps->p++;
+                next = byte_fragment(ps, any);
+                break;
+            case '[':
+                next = parse_class(ps);
+                break;
+            case '\\':
+                if (ps->p + 1 < ps->end) {
+                    ps->p++;
+                }
+                /* fall through */
+            default:
+                set_bit(bits, (unsigned char)*ps->p++);
+                next = byte_fragment(ps, bits);
+                break;
+        }
+        if (ps->error) {
+            break;
+        }
+
+        if (frag.start < 0) {
+            frag = next;
+        } else {
+            patch(ps->dfa, frag.exits, next.start);
+            frag.exits = next.exits;
+        }
+    }
+
+    if (!ps->error && frag.start < 0) {
+        frag.start = new_state(ps, NFA_EMPTY, -1, -1, 0);
+        frag.exits = frag.start << 1;
+    }
+    return frag;
+}
+
+static int push_start(int32_t **list, int *count, int32_t state) {
+    int32_t *grown = realloc(*list, (*count + 1) * sizeof(*grown));
+    if (!grown) {
+        return -ENOMEM;
+    }
+    grown[(*count)++] = state;
+    *list = grown;
+    return 0;
+}
+
+int rule_pattern_is_dfa(const char *pattern) {
+    return strncmp(pattern, RULE_PATTERN_REGEX, strlen(RULE_PATTERN_REGEX)) == 0 ||
+           strncmp(pattern, RULE_PATTERN_GLOB, strlen(RULE_PATTERN_GLOB)) == 0;
+}
+
+/* Gives a parsed branch its accept state and enters it at offset 0 only
+ * or before every byte */
+static void add_branch(struct parser *ps, struct fragment frag, int rule,
+                       int anchored_start, int anchored_end) {
+    int32_t accept = new_state(ps, anchored_end ? NFA_ACCEPT_END : NFA_ACCEPT, -1, -1, rule);
+    if (ps->error) {
+        return;
+    }
+
+    struct rule_dfa *dfa = ps->dfa;
+    patch(dfa, frag.exits, accept);
+    ps->error = anchored_start ? push_start(&dfa->starts, &dfa->start_count, frag.start)
+                               : push_start(&dfa->floating, &dfa->floating_count, frag.start);
+}
+
+/* As in POSIX ERE, ^ and $ bind to their own top-level branch: each branch
+ * becomes a separate start with its own accept state. An anchor anywhere
+ * else, inside a group or mid-branch, is rejected rather than guessed at. */
+static void parse_regex(struct parser *ps, int rule) {
+    for (;;) {
+        int anchored_start = ps->p < ps->end && *ps->p == '^';
+        if (anchored_start) {
+            ps->p++;
+        }
+
+        struct fragment frag = parse_concatenation(ps);
+        if (ps->error) {
+            return;
+        }
+
+        int anchored_end = ps->p < ps->end && *ps->p == '$';
+        if (anchored_end) {
+            ps->p++;
+        }
+        if (ps->p < ps->end && *ps->p != '|') {
+            ps->error = -EINVAL; // Unbalanced ')' or text after $
+            return;
+        }
+
+        add_branch(ps, frag, rule, anchored_start, anchored_end);
+        if (ps->error || ps->p == ps->end) {
+            return;
+        }
+        ps->p++; // '|'
+    }
+}
+
+int rule_dfa_add(struct rule_dfa *dfa, const char *pattern, int rule) {
+    struct parser ps = { .dfa = dfa };
+
+    int saved_nfa = dfa->nfa_count;
+    int saved_sets = dfa->set_count;
+    int saved_starts = dfa->start_count;
+    int saved_floating = dfa->floating_count;
+
+    if (strncmp(pattern, RULE_PATTERN_GLOB, strlen(RULE_PATTERN_GLOB)) == 0) {
+        ps.p = pattern + strlen(RULE_PATTERN_GLOB);
+        ps.end = ps.p + strlen(ps.p);
+        ps.glob = 1;
+        struct fragment frag = parse_glob(&ps);
+        if (!ps.error) {
+            add_branch(&ps, frag, rule, 1, 1);
+        }
+    } else if (strncmp(pattern, RULE_PATTERN_REGEX, strlen(RULE_PATTERN_REGEX)) == 0) {
+        ps.p = pattern + strlen(RULE_PATTERN_REGEX);
+        ps.end = ps.p + strlen(ps.p);
+        parse_regex(&ps, rule);
+    } else {
+        return -EINVAL;
+    }
+
+    if (ps.error) {
+        dfa->nfa_count = saved_nfa;
+        dfa->set_count = saved_sets;
+        dfa->start_count = saved_starts;
+        dfa->floating_count = saved_floating;
+        return ps.error;
+    }
+    return 0;
+}
+
+int rule_pattern_check(const char *pattern) {
+    struct rule_dfa dfa;
+
+    memset(&dfa, 0, sizeof(dfa));
+    int ret = rule_dfa_add(&dfa, pattern, 0);
+    rule_dfa_free(&dfa);
+    return ret;
+}
+
+static void cache_flush(struct rule_dfa *dfa) {
+    dfa->state_count = 0;
+    dfa->pool_used = 0;
+    dfa->start_state = -1;
+    memset(dfa->table, 0xff, TABLE_SIZE * sizeof(*dfa->table));
+    dfa->flushes++;
+}
+
+/* Byte classes: the coarsest partition no NFA byte set splits */
+static void compute_classes(struct rule_dfa *dfa) {
+    int map[256][2];
+
+    memset(dfa->classes, 0, sizeof(dfa->classes));
+    dfa->class_count = 1;
+
+    for (int s = 0; s < dfa->set_count; s++) {
+        int count = 0;
+        memset(map, 0xff, sizeof(map));
+        for (int b = 0; b < 256; b++) {
+            int *id = &map[dfa->classes[b]][test_bit(dfa->sets[s], (unsigned char)b) ? 1 : 0];
+            if (*id < 0) {
+                *id = count++;
+            }
+            dfa->classes[b] = (uint8_t)*id;
+        }
+        dfa->class_count = count;
+    }
+
+    for (int b = 255; b >= 0; b--) {
+        dfa->representative[dfa->classes[b]] = (uint8_t)b;
+    }
+}
+
+int rule_dfa_finish(struct rule_dfa *dfa) {
+    if (dfa->nfa_count == 0) {
+        return 0;
+    }
+
+    compute_classes(dfa);
+
+    // Room for the largest possible state even right after a flush
+    dfa->pool_capacity = POOL_MIN + 2 * (size_t)dfa->nfa_count;
+    dfa->states = malloc(RULE_DFA_CACHE_STATES * sizeof(*dfa->states));
+    dfa->rows = malloc((size_t)RULE_DFA_CACHE_STATES * dfa->class_count * sizeof(*dfa->rows));
+    dfa->pool = malloc(dfa->pool_capacity * sizeof(*dfa->pool));
+    dfa->table = malloc(TABLE_SIZE * sizeof(*dfa->table));
+    dfa->scratch = malloc(dfa->nfa_count * sizeof(*dfa->scratch));
+    dfa->stack = malloc(dfa->nfa_count * sizeof(*dfa->stack));
+    dfa->marks = calloc(dfa->nfa_count, sizeof(*dfa->marks));
+    if (!dfa->states || !dfa->rows || !dfa->pool || !dfa->table || !dfa->scratch ||
+        !dfa->stack || !dfa->marks) {
+        return -ENOMEM;
+    }
+
+    cache_flush(dfa);
+    dfa->flushes = 0;
+    return 0;
+}
+
+void rule_dfa_free(struct rule_dfa *dfa) {
+    free(dfa->nfa);
+    free(dfa->sets);
+    free(dfa->starts);
+    free(dfa->floating);
+    free(dfa->states);
+    free(dfa->rows);
+    free(dfa->pool);
+    free(dfa->table);
+    free(dfa->scratch);
+    free(dfa->stack);
+    free(dfa->marks);
+    memset(dfa, 0, sizeof(*dfa));
+}
+
+static void next_mark_generation(struct rule_dfa *dfa) {
+    if (++dfa->mark_generation == 0) {
+        memset(dfa->marks, 0, dfa->nfa_count * sizeof(*dfa->marks));
+        dfa->mark_generation = 1;
+    }
+}
+
+/* Adds the byte-consuming and accepting states reachable from state
+ * through empty transitions to the scratch set */
+static void add_closure(struct rule_dfa *dfa, int32_t state, int *count) {
+    int depth = 0;
+
+    if (dfa->marks[state] == dfa->mark_generation) {
+        return;
+    }
+    dfa->marks[state] = dfa->mark_generation;
+    dfa->stack[depth++] = state;
+
+    while (depth > 0) {
+        const struct nfa_state *nfa = &dfa->nfa[dfa->stack[--depth]];
+        int32_t next[2] = { -1, -1 };
+
+        switch (nfa->kind) {
+            case NFA_SPLIT:
+                next[1] = nfa->out1;
+                /* fall through */
+            case NFA_EMPTY:
+                next[0] = nfa->out;
+                break;
+            default:
+                dfa->scratch[(*count)++] = (int32_t)(nfa - dfa->nfa);
+                break;
+        }
+
+        for (int i = 0; i < 2; i++) {
+            if (next[i] >= 0 && dfa->marks[next[i]] != dfa->mark_generation) {
+                dfa->marks[next[i]] = dfa->mark_generation;
+                dfa->stack[depth++] = next[i];
+            }
+        }
+    }
+}
+
+static int compare_states(const void *a, const void *b) {
+    int32_t x = *(const int32_t *)a, y = *(const int32_t *)b;
+    return (x > y) - (x < y);
+}
+
+/* Finds or creates the DFA state for the scratch set; sets *flushed when
+ * the cache had to be emptied to make room */
+static int32_t intern_state(struct rule_dfa *dfa, int count, int *flushed) {
+    uint32_t hash = 2166136261u;
+
+    qsort(dfa->scratch, count, sizeof(*dfa->scratch), compare_states);
+    for (int i = 0; i < count; i++) {
+        hash = (hash ^ (uint32_t)dfa->scratch[i]) * 16777619u;
+    }
+
+    size_t pos = hash & (TABLE_SIZE - 1);
+    for (; dfa->table[pos] >= 0; pos = (pos + 1) & (TABLE_SIZE - 1)) {
+        const struct dfa_state *state = &dfa->states[dfa->table[pos]];
+        if (state->hash == hash && state->set_len == (uint32_t)count &&
+            memcmp(&dfa->pool[state->set], dfa->scratch, count * sizeof(*dfa->scratch)) == 0) {
+            return dfa->table[pos];
+        }
+    }
+
+    if (dfa->state_count == RULE_DFA_CACHE_STATES ||
+        dfa->pool_used + 2 * (size_t)count > dfa->pool_capacity) {
+        cache_flush(dfa);
+        *flushed = 1;
+        pos = hash & (TABLE_SIZE - 1);
+    }
+
+    int32_t index = dfa->state_count++;
+    struct dfa_state *state = &dfa->states[index];
+    uint32_t *pool = dfa->pool;
+
+    state->hash = hash;
+    state->set = (uint32_t)dfa->pool_used;
+    state->set_len = (uint32_t)count;
+    memcpy(&pool[dfa->pool_used], dfa->scratch, count * sizeof(*dfa->scratch));
+    dfa->pool_used += count;
+
+    state->accept = (uint32_t)dfa->pool_used;
+    for (int i = 0; i < count; i++) {
+        if (dfa->nfa[dfa->scratch[i]].kind == NFA_ACCEPT) {
+            pool[dfa->pool_used++] = (uint32_t)dfa->nfa[dfa->scratch[i]].arg;
+        }
+    }
+    state->accept_len = (uint32_t)dfa->pool_used - state->accept;
+
+    state->accept_end = (uint32_t)dfa->pool_used;
+    for (int i = 0; i < count; i++) {
+        if (dfa->nfa[dfa->scratch[i]].kind == NFA_ACCEPT_END) {
+            pool[dfa->pool_used++] = (uint32_t)dfa->nfa[dfa->scratch[i]].arg;
+        }
+    }
+    state->accept_end_len = (uint32_t)dfa->pool_used - state->accept_end;
+
+    memset(&dfa->rows[(size_t)index * dfa->class_count], 0xff,
+           dfa->class_count * sizeof(*dfa->rows));
+    dfa->table[pos] = index;
+    return index;
+}
+
+static int32_t start_state(struct rule_dfa *dfa) {
+    int count = 0, flushed = 0;
+
+    if (dfa->start_state < 0) {
+        next_mark_generation(dfa);
+        for (int i = 0; i < dfa->start_count; i++) {
+            add_closure(dfa, dfa->starts[i], &count);
+        }
+        for (int i = 0; i < dfa->floating_count; i++) {
+            add_closure(dfa, dfa->floating[i], &count);
+        }
+        dfa->start_state = intern_state(dfa, count, &flushed);
+    }
+    return dfa->start_state;
+}
+
+static int32_t step(struct rule_dfa *dfa, int32_t from, int class, int *flushed) {
+    const struct dfa_state *state = &dfa->states[from];
+    unsigned char byte = dfa->representative[class];
+    int count = 0;
+
+    next_mark_generation(dfa);
+    for (uint32_t i = 0; i < state->set_len; i++) {
+        const struct nfa_state *nfa = &dfa->nfa[dfa->pool[state->set + i]];
+        if (nfa->kind == NFA_BYTES && test_bit(dfa->sets[nfa->arg], byte)) {
+            add_closure(dfa, nfa->out, &count);
+        }
+    }
+    for (int i = 0; i < dfa->floating_count; i++) {
+        add_closure(dfa, dfa->floating[i], &count);
+    }
+
+    return intern_state(dfa, count, flushed);
+}
+
+static int fire(const struct rule_dfa *dfa, uint32_t offset, uint32_t len,
+                uint32_t *seen, uint32_t generation, int *hits, int found) {
+    for (uint32_t i = 0; i < len; i++) {
+        uint32_t rule = dfa->pool[offset + i];
+        if (seen[rule] != generation) {
+            seen[rule] = generation;
+            hits[found++] = (int)rule;
+        }
+    }
+    return found;
+}
+
+int rule_dfa_match(struct rule_dfa *dfa, const char *text, size_t len,
+                   uint32_t *seen, uint32_t generation, int *hits, int found) {
+    if (!dfa->states) {
+        return found;
+    }
+
+    const size_t width = (size_t)dfa->class_count;
+    int32_t current = start_state(dfa);
+    const struct dfa_state *state = &dfa->states[current];
+
+    found = fire(dfa, state->accept, state->accept_len, seen, generation, hits, found);
+
+    for (size_t i = 0; i < len && state->set_len; i++) {
+        int class = dfa->classes[(unsigned char)text[i]];
+        int32_t next = dfa->rows[current * width + class];
+
+        if (next < 0) {
+            int flushed = 0;
+            next = step(dfa, current, class, &flushed);
+            if (!flushed) {
+                dfa->rows[current * width + class] = next;
+            }
+        }
+
+        current = next;
+        state = &dfa->states[current];
+        if (state->accept_len) {
+            found = fire(dfa, state->accept, state->accept_len, seen, generation, hits, found);
+        }
+    }
+
+    return fire(dfa, state->accept_end, state->accept_end_len, seen, generation, hits, found);
+}
@@ -0,0 +1,76 @@
+#ifndef RULE_DFA_H
+#define RULE_DFA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Regex and glob rule patterns. A pattern written "re:<regex>" matches
+ * when the regex matches somewhere in the details (a ^ opening or $
+ * closing a top-level branch anchors that branch; anchors elsewhere are
+ * rejected, write \^ and \$ for the literal characters);
+ * "glob:<glob>" must match the whole details, fnmatch-style, with * ? and
+ * [...]. Supported regex syntax: literals, ., [...] and [^...] classes,
+ * \d \w \s (and upper-case negations), * + ?, | and grouping.
+ *
+ * All such patterns of one event type are compiled into one Thompson NFA
+ * that is determinized lazily while matching: each DFA state is built the
+ * first time an input byte leads to it and cached, so matching is linear
+ * in the length of the details. The cache holds RULE_DFA_CACHE_STATES
+ * states and is flushed when full, which bounds memory for patterns
+ * whose full DFA would blow up. Internal to the security monitor. */
+
+#define RULE_PATTERN_REGEX "re:"
+#define RULE_PATTERN_GLOB "glob:"
+#define RULE_DFA_CACHE_STATES 1024
+
+struct nfa_state;
+struct dfa_state;
+
+struct rule_dfa {
+    struct nfa_state *nfa;
+    int nfa_count;
+    int nfa_capacity;
+    uint8_t (*sets)[32];        // Byte bitmaps referenced by NFA states
+    int set_count;
+    int set_capacity;
+    int32_t *starts;            // Entered at offset 0 only
+    int start_count;
+    int32_t *floating;          // Unanchored: re-entered before every byte
+    int floating_count;
+
+    uint8_t classes[256];       // Bytes no set tells apart share a class
+    uint8_t representative[256];
+    int class_count;
+
+    struct dfa_state *states;
+    int state_count;
+    int32_t *rows;              // state * class_count + class -> state, -1 unknown
+    uint32_t *pool;             // NFA state sets and accept lists
+    size_t pool_used;
+    size_t pool_capacity;
+    int32_t *table;             // Hash of state sets -> state
+    int32_t start_state;        // -1 until built (again, after a flush)
+    unsigned long flushes;
+
+    int32_t *scratch;           // Set under construction
+    int32_t *stack;
+    uint32_t *marks;
+    uint32_t mark_generation;
+};
+
+int rule_pattern_is_dfa(const char *pattern);
+
+/* -EINVAL for a malformed pattern; safe to call on a zeroed rule_dfa */
+int rule_dfa_add(struct rule_dfa *dfa, const char *pattern, int rule);
+int rule_dfa_finish(struct rule_dfa *dfa);
+void rule_dfa_free(struct rule_dfa *dfa);
+
+/* Appends the rules that match text to hits (skipping those already
+ * stamped with generation in seen) and returns the new count */
+int rule_dfa_match(struct rule_dfa *dfa, const char *text, size_t len,
+                   uint32_t *seen, uint32_t generation, int *hits, int found);
+
+/* Syntax check for load_security_rules() */
+int rule_pattern_check(const char *pattern);
+
+#endif /* RULE_DFA_H */
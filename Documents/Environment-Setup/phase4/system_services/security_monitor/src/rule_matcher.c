@@ -0,0 +1,278 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "rule_matcher.h"
+
+/* During construction delta holds state numbers and zero means "no trie
+ * edge": no edge of the trie leads back to the root, so 0 is free to mean
+ * that until the breadth-first pass fills in the failure transitions. The
+ * final pass rewrites every entry as a row offset plus MATCH_FLAG. */
+
+#define MATCH_FLAG 0x80000000u
+
+static void free_group(struct match_group *group) {
+    free(group->delta);
+    free(group->emit);
+    free(group->dict);
+    free(group->first_output);
+    free(group->outputs);
+    free(group->always);
+    rule_dfa_free(&group->dfa);
+}
+
+static struct match_group *find_group(const struct rule_matcher *matcher, int event_type) {
+    for (int i = 0; i < matcher->group_count; i++) {
+        if (matcher->groups[i].event_type == event_type) {
+            return &matcher->groups[i];
+        }
+    }
+    return NULL;
+}
+
+static int build_group(struct match_group *group, const struct security_rule *rules, int count) {
+    int used[256] = { 0 };
+    size_t total_len = 0;
+
+    for (int i = 0; i < count; i++) {
+        if (!rules[i].enabled || (int)rules[i].event_type != group->event_type) {
+            continue;
+        }
+        if (rule_pattern_is_dfa(rules[i].pattern)) {
+            int ret = rule_dfa_add(&group->dfa, rules[i].pattern, i);
+            if (ret == -ENOMEM) {
+                return ret;
+            }
+            group->rule_count += ret == 0; // Malformed patterns never match
+            continue;
+        }
+        for (const unsigned char *p = (const unsigned char *)rules[i].pattern; *p; p++) {
+            used[*p] = 1;
+        }
+        total_len += strlen(rules[i].pattern);
+        group->rule_count++;
+    }
+
+    // Class 0 is every byte no pattern contains; NUL never does
+    group->class_count = 1;
+    for (int b = 0; b < 256; b++) {
+        group->classes[b] = used[b] ? (uint8_t)group->class_count++ : 0;
+    }
+
+    size_t capacity = total_len + 1;
+    size_t width = (size_t)group->class_count;
+    if (capacity * width >= MATCH_FLAG) {
+        return -E2BIG;
+    }
+
+    int32_t *fail = malloc(capacity * sizeof(*fail));
+    int32_t *queue = malloc(capacity * sizeof(*queue));
+    group->delta = calloc(capacity * width, sizeof(*group->delta));
+    group->emit = malloc(capacity * sizeof(*group->emit));
+    group->dict = malloc(capacity * sizeof(*group->dict));
+    group->first_output = malloc(capacity * sizeof(*group->first_output));
+    group->outputs = malloc(group->rule_count * sizeof(*group->outputs) + 1);
+    group->always = malloc(group->rule_count * sizeof(*group->always) + 1);
+    if (!fail || !queue || !group->delta || !group->emit || !group->dict ||
+        !group->first_output || !group->outputs || !group->always) {
+        free(fail);
+        free(queue);
+        return -ENOMEM;
+    }
+
+    // Trie of all patterns
+    int32_t states = 1;
+    int32_t output_count = 0;
+    memset(group->first_output, 0xff, capacity * sizeof(*group->first_output));
+    for (int i = 0; i < count; i++) {
+        if (!rules[i].enabled || (int)rules[i].event_type != group->event_type) {
+            continue;
+        }
+        if (rule_pattern_is_dfa(rules[i].pattern)) {
+            continue;
+        }
+        if (!rules[i].pattern[0]) {
+            group->always[group->always_count++] = i;
+            continue;
+        }
+
+        int32_t state = 0;
+        for (const unsigned char *p = (const unsigned char *)rules[i].pattern; *p; p++) {
+            uint32_t *edge = &group->delta[state * width + group->classes[*p]];
+            if (!*edge) {
+                *edge = states++;
+            }
+            state = *edge;
+        }
+        group->outputs[output_count].rule = i;
+        group->outputs[output_count].next = group->first_output[state];
+        group->first_output[state] = output_count++;
+        group->literal_count++;
+    }
+
+    // Breadth-first: failure links, then missing edges borrowed from them
+    size_t head = 0, tail = 0;
+    group->dict[0] = -1;
+    group->emit[0] = -1;
+    for (size_t c = 0; c < width; c++) {
+        uint32_t child = group->delta[c];
+        if (child) {
+            fail[child] = 0;
+            group->dict[child] = -1;
+            queue[tail++] = child;
+        }
+    }
+
+    while (head < tail) {
+        int32_t state = queue[head++];
+        uint32_t *row = &group->delta[state * width];
+        const uint32_t *fallback = &group->delta[fail[state] * width];
+
+        for (size_t c = 0; c < width; c++) {
+            uint32_t child = row[c];
+            if (!child) {
+                row[c] = fallback[c];
+                continue;
+            }
+            uint32_t target = fallback[c];
+            fail[child] = target;
+            group->dict[child] = group->first_output[target] >= 0 ? (int32_t)target : group->dict[target];
+            queue[tail++] = child;
+        }
+        group->emit[state] = group->first_output[state] >= 0 ? state : group->dict[state];
+    }
+
+    free(fail);
+    free(queue);
+
+    uint32_t *delta = realloc(group->delta, (size_t)states * width * sizeof(*delta));
+    if (delta) {
+        group->delta = delta;
+    }
+
+    for (size_t i = 0; i < (size_t)states * width; i++) {
+        uint32_t target = group->delta[i];
+        group->delta[i] = (uint32_t)(target * width) | (group->emit[target] >= 0 ? MATCH_FLAG : 0);
+    }
+
+    return rule_dfa_finish(&group->dfa);
+}
+
+int rule_matcher_build(struct rule_matcher *matcher, const struct security_rule *rules, int count) {
+    struct rule_matcher fresh;
+    int ret = 0;
+
+    memset(&fresh, 0, sizeof(fresh));
+    fresh.rule_count = count;
+    fresh.seen = calloc(count + 1, sizeof(*fresh.seen));
+    fresh.hits = malloc((count + 1) * sizeof(*fresh.hits));
+    if (!fresh.seen || !fresh.hits) {
+        ret = -ENOMEM;
+        goto out;
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (!rules[i].enabled || find_group(&fresh, rules[i].event_type)) {
+            continue;
+        }
+
+        struct match_group *groups = realloc(fresh.groups,
+                                             (fresh.group_count + 1) * sizeof(*groups));
+        if (!groups) {
+            ret = -ENOMEM;
+            goto out;
+        }
+        fresh.groups = groups;
+
+        struct match_group *group = &fresh.groups[fresh.group_count++];
+        memset(group, 0, sizeof(*group));
+        group->event_type = rules[i].event_type;
+        ret = build_group(group, rules, count);
+        if (ret < 0) {
+            goto out;
+        }
+    }
+
+out:
+    if (ret < 0) {
+        rule_matcher_free(&fresh);
+        return ret; // The previous rule set stays in force
+    }
+
+    rule_matcher_free(matcher);
+    *matcher = fresh;
+    return 0;
+}
+
+void rule_matcher_free(struct rule_matcher *matcher) {
+    for (int i = 0; i < matcher->group_count; i++) {
+        free_group(&matcher->groups[i]);
+    }
+    free(matcher->groups);
+    free(matcher->seen);
+    free(matcher->hits);
+    memset(matcher, 0, sizeof(*matcher));
+}
+
+int rule_matcher_match(struct rule_matcher *matcher, int event_type, const char *text,
+                       size_t len, const int **hits) {
+    struct match_group *group = find_group(matcher, event_type);
+    int found = 0;
+
+    *hits = matcher->hits;
+    if (!group) {
+        return 0;
+    }
+
+    if (++matcher->generation == 0) {
+        memset(matcher->seen, 0, sizeof(*matcher->seen) * (size_t)matcher->rule_count);
+        matcher->generation = 1;
+    }
+    uint32_t generation = matcher->generation;
+
+    for (int i = 0; i < group->always_count; i++) {
+        matcher->hits[found++] = group->always[i];
+    }
+
+    const uint32_t *delta = group->delta;
+    const uint8_t *classes = group->classes;
+    uint32_t row = 0;
+
+    for (size_t i = 0; i < len && group->literal_count; i++) {
+        row = delta[row + classes[(unsigned char)text[i]]];
+        if (!(row & MATCH_FLAG)) {
+            continue;
+        }
+
+        row &= ~MATCH_FLAG;
+        int32_t state = (int32_t)(row / (uint32_t)group->class_count);
+        for (int32_t at = group->emit[state]; at >= 0; at = group->dict[at]) {
+            for (int32_t o = group->first_output[at]; o >= 0; o = group->outputs[o].next) {
+                int rule = group->outputs[o].rule;
+                if (matcher->seen[rule] != generation) {
+                    matcher->seen[rule] = generation;
+                    matcher->hits[found++] = rule;
+                }
+            }
+        }
+        if (found == group->rule_count) {
+            break; // Every rule of this type has fired
+        }
+    }
+
+    if (found < group->rule_count) {
+        found = rule_dfa_match(&group->dfa, text, len, matcher->seen, generation,
+                               matcher->hits, found);
+    }
+
+    // Report in rule order, as the nested loop did
+    for (int i = 1; i < found; i++) {
+        int rule = matcher->hits[i];
+        int j = i;
+        for (; j > 0 && matcher->hits[j - 1] > rule; j--) {
+            matcher->hits[j] = matcher->hits[j - 1];
+        }
+        matcher->hits[j] = rule;
+    }
+
+    return found;
+}
@@ -0,0 +1,59 @@
+#ifndef RULE_MATCHER_H
+#define RULE_MATCHER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "../include/security_monitor.h"
+#include "rule_dfa.h"
+
+/* Compiled form of the rule set. Enabled rules are grouped by event type
+ * and every group's patterns go into one Aho-Corasick automaton, so an
+ * event's details are scanned once however many rules there are. The
+ * automaton is a dense DFA over byte classes: bytes that appear in no
+ * pattern share class 0, which keeps rows short. Transitions hold the
+ * target's row offset rather than its number, with the top bit set when
+ * some pattern ends there, so the scan loop is one load and one test per
+ * byte. Regex and glob patterns go to a lazily built DFA instead (see
+ * rule_dfa.h). Internal to the security
+ * monitor; not thread-safe (the consumer thread owns it). */
+
+struct match_output {
+    int32_t rule;           // Index into the rules array
+    int32_t next;           // Next output of the same state, -1 at the end
+};
+
+struct match_group {
+    int event_type;
+    int rule_count;
+    int literal_count;      // Patterns in the automaton
+    int class_count;
+    uint8_t classes[256];
+    uint32_t *delta;        // Row offset + class -> row offset of the next state
+    int32_t *emit;          // First state on the suffix chain with outputs, or -1
+    int32_t *dict;          // Next such state below this one, or -1
+    int32_t *first_output;  // Head of this state's outputs, or -1
+    struct match_output *outputs;
+    int *always;            // Empty patterns match every event
+    int always_count;
+    struct rule_dfa dfa;    // re: and glob: patterns
+};
+
+struct rule_matcher {
+    struct match_group *groups;
+    int group_count;
+    uint32_t *seen;         // Per rule: generation it last matched in
+    uint32_t generation;
+    int rule_count;
+    int *hits;
+};
+
+int rule_matcher_build(struct rule_matcher *matcher, const struct security_rule *rules, int count);
+void rule_matcher_free(struct rule_matcher *matcher);
+
+/* Indices of the enabled rules for event_type whose pattern occurs in
+ * text, in ascending order (the order the rules were loaded in). The
+ * array stays valid until the next call. */
+int rule_matcher_match(struct rule_matcher *matcher, int event_type, const char *text,
+                       size_t len, const int **hits);
+
+#endif /* RULE_MATCHER_H */
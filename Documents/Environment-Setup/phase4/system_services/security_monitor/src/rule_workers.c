@@ -0,0 +1,106 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "rule_workers.h"
+
+static pthread_t threads[RULE_WORKERS_MAX];
+static int worker_count = 1;
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t start_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t done_cond = PTHREAD_COND_INITIALIZER;
+static uint64_t generation = 0;     // Bumped for every job
+static uint64_t spawn_generation;   // Jobs up to this one predate the workers
+static int pending = 0;             // Workers still on the current job
+static int stopping = 0;
+static rule_work_fn job;
+static void *job_arg;
+
+static void *worker_main(void *arg) {
+    int shard = (int)(intptr_t)arg;
+    uint64_t seen;
+
+    pthread_mutex_lock(&pool_lock);
+    seen = spawn_generation;
+    for (;;) {
+        while (generation == seen && !stopping) {
+            pthread_cond_wait(&start_cond, &pool_lock);
+        }
+        if (stopping) {
+            break;
+        }
+        seen = generation;
+        rule_work_fn work = job;
+        void *work_arg = job_arg;
+        int shards = worker_count;
+        pthread_mutex_unlock(&pool_lock);
+
+        work(shard, shards, work_arg);
+
+        pthread_mutex_lock(&pool_lock);
+        if (--pending == 0) {
+            pthread_cond_signal(&done_cond);
+        }
+    }
+    pthread_mutex_unlock(&pool_lock);
+    return NULL;
+}
+
+static void stop_threads(void) {
+    pthread_mutex_lock(&pool_lock);
+    stopping = 1;
+    pthread_cond_broadcast(&start_cond);
+    pthread_mutex_unlock(&pool_lock);
+
+    for (int i = 1; i < worker_count; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    worker_count = 1;
+    stopping = 0;
+}
+
+int rule_workers_resize(int count) {
+    if (count < 1 || count > RULE_WORKERS_MAX) {
+        return -EINVAL;
+    }
+
+    stop_threads();
+    spawn_generation = generation;
+    for (int i = 1; i < count; i++) {
+        int ret = pthread_create(&threads[i], NULL, worker_main, (void *)(intptr_t)i);
+        if (ret != 0) {
+            stop_threads();
+            return -ret;
+        }
+        worker_count = i + 1;
+    }
+    return 0;
+}
+
+int rule_workers_count(void) {
+    return worker_count;
+}
+
+void rule_workers_run(rule_work_fn work, void *arg) {
+    if (worker_count == 1) {
+        work(0, 1, arg);
+        return;
+    }
+
+    pthread_mutex_lock(&pool_lock);
+    job = work;
+    job_arg = arg;
+    pending = worker_count - 1;
+    generation++;
+    pthread_cond_broadcast(&start_cond);
+    pthread_mutex_unlock(&pool_lock);
+
+    work(0, worker_count, arg);
+
+    pthread_mutex_lock(&pool_lock);
+    while (pending > 0) {
+        pthread_cond_wait(&done_cond, &pool_lock);
+    }
+    pthread_mutex_unlock(&pool_lock);
+}
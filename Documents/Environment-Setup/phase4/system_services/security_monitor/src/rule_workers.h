@@ -0,0 +1,19 @@
+#ifndef RULE_WORKERS_H
+#define RULE_WORKERS_H
+
+/* Fork-join pool for process_security_events(). rule_workers_run() hands
+ * the same job to every worker, the calling thread included as shard 0,
+ * and returns once all of them have finished it, so the event store is
+ * never written while workers read it. Internal to the security monitor;
+ * driven from the consumer thread only. */
+
+#define RULE_WORKERS_MAX 64
+
+typedef void (*rule_work_fn)(int shard, int shards, void *arg);
+
+/* count threads in all, the caller counting as one; 1 stops the pool */
+int rule_workers_resize(int count);
+int rule_workers_count(void);
+void rule_workers_run(rule_work_fn work, void *arg);
+
+#endif /* RULE_WORKERS_H */
@@ -0,0 +1,149 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include "ruleset.h"
+
+struct reader_stripe {
+    _Atomic long readers[2];        // By epoch parity
+} __attribute__((aligned(64)));
+
+static struct reader_stripe stripes[RULESET_STRIPES];
+static _Atomic unsigned int epoch = 0;
+static _Atomic(struct ruleset *) current = NULL;
+static _Atomic unsigned int next_stripe = 0;
+static __thread int thread_stripe = -1;
+static uint64_t generation = 0;     // Of the last set published
+
+int ruleset_build(struct ruleset **set, const struct security_rule *rules, int rule_count,
+                  const struct security_correlation_rule *correlations,
+                  int correlation_count, int workers) {
+    struct ruleset *fresh = calloc(1, sizeof(*fresh));
+    uint32_t types = 0;
+    int ret = -ENOMEM;
+
+    if (!fresh) {
+        return -ENOMEM;
+    }
+    pthread_mutex_init(&fresh->block_lock, NULL);
+
+    // One spare element each, so that empty sets still allocate
+    fresh->rules = malloc((rule_count + 1) * sizeof(*rules));
+    fresh->correlations = malloc((correlation_count + 1) * sizeof(*correlations));
+    fresh->block_rules = malloc((rule_count + 1) * sizeof(*rules));
+    if (!fresh->rules || !fresh->correlations || !fresh->block_rules) {
+        goto fail;
+    }
+    if (rule_count > 0) {
+        memcpy(fresh->rules, rules, rule_count * sizeof(*rules));
+    }
+    if (correlation_count > 0) {
+        memcpy(fresh->correlations, correlations, correlation_count * sizeof(*correlations));
+    }
+    fresh->rule_count = rule_count;
+    fresh->correlation_count = correlation_count;
+
+    for (; fresh->matcher_count < workers; fresh->matcher_count++) {
+        ret = rule_matcher_build(&fresh->matchers[fresh->matcher_count], fresh->rules,
+                                 rule_count);
+        if (ret < 0) {
+            goto fail;
+        }
+    }
+
+    int count = 0;
+    for (int i = 0; i < rule_count; i++) {
+        if (rules[i].enabled && rules[i].action >= 2) {
+            fresh->block_rules[count++] = rules[i];
+            if ((unsigned)rules[i].event_type < 32) {
+                types |= 1u << rules[i].event_type;
+            }
+        }
+    }
+    ret = rule_matcher_build(&fresh->block_matcher, fresh->block_rules, count);
+    if (ret < 0) {
+        goto fail;
+    }
+    fresh->block_types = types;
+
+    *set = fresh;
+    return 0;
+
+fail:
+    ruleset_free(fresh);
+    return ret;
+}
+
+void ruleset_free(struct ruleset *set) {
+    if (!set) {
+        return;
+    }
+    for (int i = 0; i < set->matcher_count; i++) {
+        rule_matcher_free(&set->matchers[i]);
+    }
+    rule_matcher_free(&set->block_matcher);
+    pthread_mutex_destroy(&set->block_lock);
+    free(set->block_rules);
+    free(set->correlations);
+    free(set->rules);
+    free(set);
+}
+
+static int my_stripe(void) {
+    if (thread_stripe < 0) {
+        thread_stripe = (int)(atomic_fetch_add_explicit(&next_stripe, 1, memory_order_relaxed) %
+                              RULESET_STRIPES);
+    }
+    return thread_stripe;
+}
+
+/* The increment is ordered before the pointer load (both seq_cst), so a
+ * writer that sees this stripe drained also sees the reader done with
+ * any set it could have loaded */
+struct ruleset *ruleset_read_lock(int *token) {
+    int stripe = my_stripe();
+    int parity = atomic_load(&epoch) & 1;
+
+    atomic_fetch_add(&stripes[stripe].readers[parity], 1);
+    *token = stripe * 2 + parity;
+    return atomic_load(&current);
+}
+
+void ruleset_read_unlock(int token) {
+    atomic_fetch_sub_explicit(&stripes[token / 2].readers[token % 2], 1, memory_order_release);
+}
+
+static long parity_readers(int parity) {
+    long sum = 0;
+
+    for (int i = 0; i < RULESET_STRIPES; i++) {
+        sum += atomic_load(&stripes[i].readers[parity]);
+    }
+    return sum;
+}
+
+/* Returns once every reader that might still see the old set is done */
+static void wait_for_readers(void) {
+    for (int flip = 0; flip < 2; flip++) {
+        int parity = atomic_fetch_add(&epoch, 1) & 1;
+
+        while (parity_readers(parity) != 0) {
+            sched_yield();
+        }
+    }
+}
+
+void ruleset_publish(struct ruleset *set) {
+    set->generation = ++generation;
+    struct ruleset *old = atomic_exchange(&current, set);
+
+    if (old) {
+        wait_for_readers();
+        ruleset_free(old);
+    }
+}
+
+struct ruleset *ruleset_current(void) {
+    return atomic_load_explicit(&current, memory_order_acquire);
+}
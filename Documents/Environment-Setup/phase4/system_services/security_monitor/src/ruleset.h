@@ -0,0 +1,63 @@
+#ifndef RULESET_H
+#define RULESET_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include "../include/security_monitor.h"
+#include "rule_matcher.h"
+#include "rule_workers.h"
+
+/* Compiled rule set. A set is built off to the side, published with one
+ * atomic pointer store, and never changed afterwards; the matchers'
+ * per-scan scratch is the only state written through it, each matcher
+ * being used by one thread at a time (its rule worker, or whoever holds
+ * block_lock). Readers bracket their use with ruleset_read_lock() and
+ * ruleset_read_unlock(), which take no lock and never wait.
+ *
+ * Reclamation is epoch based. Readers count themselves in one of two
+ * parities of per-stripe counters, picked by the low bit of a global
+ * epoch. ruleset_publish() swaps the pointer, then twice flips the epoch
+ * and waits for the parity it left to drain; only then does it free the
+ * old set, since a reader that saw it had registered in one of the two
+ * parities before the swap. New readers go to the new parity, so a busy
+ * stream of them cannot hold the writer off. Internal to the security
+ * monitor. */
+
+#define RULESET_STRIPES 64
+
+struct ruleset {
+    uint64_t generation;
+    struct security_rule *rules;
+    int rule_count;
+    struct security_correlation_rule *correlations;
+    int correlation_count;
+    struct rule_matcher matchers[RULE_WORKERS_MAX];    // One per rule worker
+    int matcher_count;
+
+    // Block and kill rules, matched by producers as events arrive
+    pthread_mutex_t block_lock;     // Guards block_matcher's scratch, nothing else
+    struct rule_matcher block_matcher;
+    struct security_rule *block_rules;
+    uint32_t block_types;           // Bit per event type with block rules
+};
+
+/* Copies the rules and compiles them, with matchers for workers rule
+ * workers. The new set has no generation until it is published. */
+int ruleset_build(struct ruleset **set, const struct security_rule *rules, int rule_count,
+                  const struct security_correlation_rule *correlations,
+                  int correlation_count, int workers);
+void ruleset_free(struct ruleset *set);
+
+/* Writers must be serialized by the caller. Returns once the previous
+ * set, if any, has been freed. */
+void ruleset_publish(struct ruleset *set);
+
+/* The current set, for writers only: stable while they hold their lock */
+struct ruleset *ruleset_current(void);
+
+/* The set stays valid until the matching unlock. Sections may nest, but
+ * a thread must not publish from inside one. */
+struct ruleset *ruleset_read_lock(int *token);
+void ruleset_read_unlock(int token);
+
+#endif /* RULESET_H */
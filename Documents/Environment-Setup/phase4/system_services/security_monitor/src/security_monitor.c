@@ -5,38 +5,168 @@
 #include <time.h>
 #include <errno.h>
 #include <syslog.h>
+#include <pthread.h>
+#include "audit_sink.h"
 #include "../include/security_monitor.h"
+#include "event_ring.h"
+#include "event_store.h"
+#include "rule_matcher.h"
+#include "correlation.h"
+#include "event_journal.h"
+#include "enforcement.h"
+#include "event_collectors.h"
+#include "rule_workers.h"
+#include "ruleset.h"
 
-static struct security_event events[MAX_EVENTS];
-static struct security_rule rules[MAX_RULES];
-static int event_count = 0;
-static int rule_count = 0;
+/* Producers queue events into a lock-free MPSC ring; the consumer side
+ * (process_security_events(), check_security_violations() and cursor
+ * readers, all called from one thread) drains it into the compact event
+ * store, which keeps up to the last MAX_EVENTS events. Every consumer
+ * reads through its own cursor, so each pass only looks at events that
+ * arrived since its previous one. */
+
+static struct event_ring event_ring;
+static struct security_event_cursor rule_cursor;
+static struct security_event_cursor violation_cursor;
+static int journal_error = 0;   // Last journal failure, logged once
 static int monitor_initialized = 0;
 
+/* Rules live in the published ruleset (see ruleset.h): loads and reloads
+ * compile a new one under rules_lock, while producers and the consumer
+ * keep reading the old one until it is swapped out. Block and kill rules
+ * are matched by producers as events arrive; the block matcher keeps
+ * per-scan scratch, so producers take turns with the set's block_lock.
+ * block_types lets events of every other type skip it. */
+static pthread_mutex_t rules_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t correlation_generation = 0;    // Set whose correlation rules are applied
+static _Atomic uint32_t block_types = 0;   // Bit per event type with block rules
+static _Atomic unsigned long long blocked = 0;
+static _Atomic unsigned long long block_failed = 0;
+static _Atomic unsigned long long journal_dropped = 0;
+
 int init_security_monitor(void) {
     if (monitor_initialized) {
         return 0;
     }
     
+    int ret = event_ring_init(&event_ring, SECURITY_EVENT_RING_SIZE,
+                              sizeof(struct event_entry));
+    if (ret < 0) {
+        return ret;
+    }
+    
+    ret = event_store_init();
+    if (ret < 0) {
+        event_ring_destroy(&event_ring);
+        return ret;
+    }
+    
+    // Rule hits and alerts are logged from the event path: never block on /dev/log
     openlog("secureos-monitor", LOG_PID | LOG_CONS, LOG_DAEMON);
+    struct audit_sink_config audit = { .ident = "secureos-monitor", .facility = LOG_DAEMON };
+    ret = audit_sink_open(&audit);
+    if (ret < 0 && ret != -EBUSY) {
+        syslog(LOG_WARNING, "Audit sink unavailable (%s), logging synchronously", strerror(-ret));
+    }
+    
+    correlation_init();
+    security_event_cursor_init(&rule_cursor);
+    security_event_cursor_init(&violation_cursor);
     
-    memset(events, 0, sizeof(events));
-    memset(rules, 0, sizeof(rules));
-    event_count = 0;
-    rule_count = 0;
+    // Readers always find a set, if an empty one
+    struct ruleset *set;
+    ret = ruleset_build(&set, NULL, 0, NULL, 0, rule_workers_count());
+    if (ret < 0) {
+        event_ring_destroy(&event_ring);
+        return ret;
+    }
+    ruleset_publish(set);
     
     monitor_initialized = 1;
-    syslog(LOG_INFO, "Security monitor initialized");
+    audit_log(LOG_INFO, "Security monitor initialized");
     
     return 0;
 }
 
+static void record_enforcement(int rule_id, int action, pid_t pid, int ret) {
+    if (ret == 0) {
+        atomic_fetch_add_explicit(&blocked, 1, memory_order_relaxed);
+        audit_log(LOG_CRIT, "SECURITY %s - Rule %d: PID %d %s", action == 3 ? "KILL" : "BLOCK",
+               rule_id, pid, action == 3 ? "killed" : "frozen");
+    } else {
+        atomic_fetch_add_explicit(&block_failed, 1, memory_order_relaxed);
+        audit_log(LOG_CRIT, "SECURITY %s - Rule %d: cannot stop PID %d: %s",
+               action == 3 ? "KILL" : "BLOCK", rule_id, pid, strerror(-ret));
+    }
+}
+
+/* A correlation hit can come from an event the window and consumer lag
+ * have left far behind; its pid may belong to another process by now */
+static void enforce_correlation(const struct security_correlation_rule *rule,
+                                const struct event_record *event) {
+    time_t age = time(NULL) - (time_t)event->timestamp;
+
+    if (age > SECURITY_ENFORCE_MAX_AGE) {
+        atomic_fetch_add_explicit(&block_failed, 1, memory_order_relaxed);
+        audit_log(LOG_CRIT, "SECURITY %s - Rule %d: PID %d not stopped, event is %ld s old",
+               rule->action == 3 ? "KILL" : "BLOCK", rule->rule_id, event->pid, (long)age);
+        return;
+    }
+    record_enforcement(rule->rule_id, rule->action, event->pid,
+                       enforce_process(event->pid, rule->action, (time_t)event->timestamp));
+}
+
+/* Runs on the producer's thread. The strongest action among the rules
+ * that match wins: one kill rule outweighs any number of block rules. */
+static void enforce_block_rules(const struct security_event *event) {
+    size_t len = strnlen(event->details, sizeof(event->details) - 1);
+    int action = 0, rule_id = 0, token;
+    const int *hits;
+    
+    struct ruleset *set = ruleset_read_lock(&token);
+    pthread_mutex_lock(&set->block_lock);
+    int count = rule_matcher_match(&set->block_matcher, event->type, event->details, len, &hits);
+    for (int i = 0; i < count; i++) {
+        if (set->block_rules[hits[i]].action > action) {
+            action = set->block_rules[hits[i]].action;
+            rule_id = set->block_rules[hits[i]].rule_id;
+        }
+    }
+    pthread_mutex_unlock(&set->block_lock);
+    ruleset_read_unlock(token);
+    
+    if (count > 0) {
+        // Reported by the producer as it happens: the pid is current
+        record_enforcement(rule_id, action, event->pid, enforce_process(event->pid, action, 0));
+    }
+}
+
+/* Compiles these rules into a new set and swaps it in; on failure the
+ * current set stays in force. Callers hold rules_lock. */
+static int publish_rules(const struct security_rule *rules, int rule_count,
+                         const struct security_correlation_rule *correlations,
+                         int correlation_count) {
+    struct ruleset *set;
+    int ret = ruleset_build(&set, rules, rule_count, correlations, correlation_count,
+                            rule_workers_count());
+    if (ret < 0) {
+        return ret;
+    }
+    
+    // Producers still on the old set need its types until it is retired
+    atomic_store_explicit(&block_types, set->block_types | ruleset_current()->block_types,
+                          memory_order_release);
+    ruleset_publish(set);
+    atomic_store_explicit(&block_types, set->block_types, memory_order_release);
+    return 0;
+}
+
 int add_security_event(struct security_event *event) {
     if (!monitor_initialized) {
         return -EINVAL;
     }
     
-    if (!event || event_count >= MAX_EVENTS) {
+    if (!event) {
         return -EINVAL;
     }
     
@@ -45,92 +175,370 @@ int add_security_event(struct security_event *event) {
         event->timestamp = time(NULL);
     }
     
-    // Copy event to buffer
-    memcpy(&events[event_count], event, sizeof(struct security_event));
-    event_count++;
+    // Enforcement waits neither for the next process_security_events()
+    // pass nor for room in the ring
+    uint32_t types = atomic_load_explicit(&block_types, memory_order_acquire);
+    if ((unsigned)event->type < 32 && (types & (1u << event->type))) {
+        enforce_block_rules(event);
+    }
+    
+    // Pack the event straight into its ring slot, copying only the string
+    // bytes in use; a full ring is counted, not silently lost
+    uint64_t ticket;
+    struct event_entry *entry = event_ring_reserve(&event_ring, &ticket);
+    if (!entry) {
+        return -EAGAIN;
+    }
+    event_entry_pack(entry, event);
+    event_ring_commit(&event_ring, ticket);
     
     // Log high severity events immediately
     if (event->severity >= 8) {
-        syslog(LOG_ALERT, "High severity security event: %s (PID: %d, UID: %d)",
+        audit_log(LOG_ALERT, "High severity security event: %s (PID: %d, UID: %d)",
                event->details, event->pid, event->uid);
     }
     
     return 0;
 }
 
-int load_security_rules(const char *rules_file) {
+int add_correlation_rule(const struct security_correlation_rule *rule) {
     if (!monitor_initialized) {
         return -EINVAL;
     }
     
+    int ret = correlation_check_rule(rule);
+    if (ret < 0) {
+        return ret;
+    }
+    
+    pthread_mutex_lock(&rules_lock);
+    struct ruleset *current = ruleset_current();
+    struct security_correlation_rule correlations[CORRELATION_MAX_RULES];
+    int count = current->correlation_count;
+    
+    if (count >= CORRELATION_MAX_RULES) {
+        ret = -ENOSPC;
+    } else {
+        memcpy(correlations, current->correlations, count * sizeof(*correlations));
+        correlations[count++] = *rule;
+        ret = publish_rules(current->rules, current->rule_count, correlations, count);
+    }
+    pthread_mutex_unlock(&rules_lock);
+    
+    return ret;
+}
+
+static void load_correlation_rule(const char *line, struct security_correlation_rule *correlations,
+                                  int *count) {
+    struct security_correlation_rule rule;
+    int event_type_int;
+    char key[16];
+    
+    memset(&rule, 0, sizeof(rule));
+    if (sscanf(line, "correlate %d %d %15s %d %d %d", &rule.rule_id, &event_type_int, key,
+               &rule.threshold, &rule.window, &rule.action) != 6) {
+        audit_log(LOG_WARNING, "Malformed correlation rule skipped: %.*s",
+                  (int)strcspn(line, "\n"), line);
+        return;
+    }
+    
+    rule.event_type = (enum security_event_type)event_type_int;
+    if (strcmp(key, "uid") == 0) {
+        rule.key = SECURITY_CORRELATE_UID;
+    } else if (strcmp(key, "pid") == 0) {
+        rule.key = SECURITY_CORRELATE_PID;
+    } else if (strcmp(key, "uid+pid") == 0) {
+        rule.key = SECURITY_CORRELATE_UID | SECURITY_CORRELATE_PID;
+    } else {
+        rule.key = -1;
+    }
+    
+    int ret = *count >= CORRELATION_MAX_RULES ? -ENOSPC : correlation_check_rule(&rule);
+    if (ret < 0) {
+        audit_log(LOG_WARNING, "Correlation rule %d skipped: %s", rule.rule_id, strerror(-ret));
+        return;
+    }
+    correlations[(*count)++] = rule;
+}
+
+/* Parses rules_file into a new set, on top of the current rules unless
+ * replace is set, and publishes it */
+static int read_rules_file(const char *rules_file, int replace) {
     FILE *file = fopen(rules_file, "r");
     if (!file) {
         return -errno;
     }
     
+    struct security_rule *rules = malloc(MAX_RULES * sizeof(*rules));
+    if (!rules) {
+        fclose(file);
+        return -ENOMEM;
+    }
+    
+    pthread_mutex_lock(&rules_lock);
+    struct ruleset *current = ruleset_current();
+    struct security_correlation_rule correlations[CORRELATION_MAX_RULES];
+    int rule_count = 0, correlation_count = 0;
+    
+    if (!replace) {
+        rule_count = current->rule_count;
+        memcpy(rules, current->rules, rule_count * sizeof(*rules));
+        correlation_count = current->correlation_count;
+        memcpy(correlations, current->correlations, correlation_count * sizeof(*correlations));
+    }
+    
     char line[512];
     while (fgets(line, sizeof(line), file) && rule_count < MAX_RULES) {
         struct security_rule *rule = &rules[rule_count];
         
+        if (strncmp(line, "correlate", 9) == 0) {
+            load_correlation_rule(line, correlations, &correlation_count);
+            continue;
+        }
+        
         int event_type_int;
+        memset(rule, 0, sizeof(*rule));
         if (sscanf(line, "%d %d %255s %d %d",
                    &rule->rule_id, &event_type_int, rule->pattern,
                    &rule->action, &rule->enabled) == 5) {
             
             rule->event_type = (enum security_event_type)event_type_int;
+            if (rule_pattern_is_dfa(rule->pattern) && rule_pattern_check(rule->pattern) < 0) {
+                audit_log(LOG_WARNING, "Rule %d: invalid pattern %s, skipped",
+                       rule->rule_id, rule->pattern);
+                continue;
+            }
             rule_count++;
         }
     }
-    
     fclose(file);
-    syslog(LOG_INFO, "Loaded %d security rules", rule_count);
+    
+    int ret = publish_rules(rules, rule_count, correlations, correlation_count);
+    pthread_mutex_unlock(&rules_lock);
+    free(rules);
+    
+    if (ret < 0) {
+        audit_log(LOG_ERR, "Cannot compile rules from %s (%s), previous ones stay in force",
+               rules_file, strerror(-ret));
+        return ret;
+    }
+    audit_log(LOG_INFO, "%s %d security rules", replace ? "Reloaded" : "Loaded", rule_count);
     
     return rule_count;
 }
 
-static int match_rule_pattern(const char *pattern, const char *text) {
-    // Simple pattern matching - could be enhanced with regex
-    return strstr(text, pattern) != NULL;
+int load_security_rules(const char *rules_file) {
+    if (!monitor_initialized) {
+        return -EINVAL;
+    }
+    
+    return read_rules_file(rules_file, 0);
 }
 
-int process_security_events(void) {
+int reload_security_rules(const char *rules_file) {
     if (!monitor_initialized) {
         return -EINVAL;
     }
     
+    return read_rules_file(rules_file, 1);
+}
+
+static void journal_failed(int ret) {
+    if (ret < 0 && ret != journal_error) {
+        audit_log(LOG_ERR, "Security journal write failed: %s", strerror(-ret));
+    }
+    journal_error = ret;
+}
+
+/* Moves everything published so far into the store (and the journal, if
+ * enabled), recycling ring slots */
+static void drain_events(void) {
+    struct event_entry *entry;
+    int journal = event_journal_is_open();
+    int ret = 0;
+    
+    while ((entry = event_ring_peek(&event_ring)) != NULL) {
+        event_store_append(entry);
+        if (journal && ret == 0) {
+            ret = event_journal_append(entry);
+        }
+        if (journal && ret < 0) {
+            // Rest of the batch too: the writer is in error until the commit
+            event_journal_skip();
+            atomic_fetch_add_explicit(&journal_dropped, 1, memory_order_relaxed);
+        }
+        event_ring_release(&event_ring);
+    }
+    
+    // One write, and at most one fdatasync(), per drained batch
+    if (journal) {
+        journal_failed(ret < 0 ? ret : event_journal_commit());
+    }
+}
+
+int start_security_collectors(unsigned int event_types, const char *const *watch_paths) {
+    if (!monitor_initialized) {
+        return -EINVAL;
+    }
+    
+    int ret = event_collectors_start(event_types, watch_paths);
+    if (ret < 0) {
+        audit_log(LOG_ERR, "Cannot start kernel event collectors: %s", strerror(-ret));
+        return ret;
+    }
+    audit_log(LOG_INFO, "Kernel event collectors started (event types 0x%x)", event_types);
+    return 0;
+}
+
+void stop_security_collectors(void) {
+    event_collectors_stop();
+}
+
+int enable_security_journal(const char *directory) {
+    if (!monitor_initialized) {
+        return -EINVAL;
+    }
+    
+    drain_events();
+    event_journal_close();
+    journal_error = 0;
+    if (!directory) {
+        return 0;
+    }
+    
+    int ret = event_journal_open(directory);
+    if (ret < 0) {
+        audit_log(LOG_ERR, "Cannot open security journal %s: %s", directory, strerror(-ret));
+        return ret;
+    }
+    audit_log(LOG_INFO, "Security journal enabled in %s", directory);
+    return 0;
+}
+
+/* Skips a cursor over events the store has evicted, counting them */
+static void cursor_catch_up(struct security_event_cursor *cursor) {
+    uint64_t first = event_store_first();
+    
+    if (cursor->next < first) {
+        cursor->missed += first - cursor->next;
+        cursor->next = first;
+    }
+}
+
+/* Events of one pid always go to the same shard, so each process's
+ * events are still evaluated in arrival order */
+static int pid_shard(pid_t pid, int shards) {
+    return (int)(((uint64_t)((uint32_t)pid * 2654435761u) * shards) >> 32);
+}
+
+struct rule_batch {
+    struct ruleset *set;
+    uint64_t first;
+    uint64_t end;
+    int processed[RULE_WORKERS_MAX];
+};
+
+static void evaluate_shard(int shard, int shards, void *arg) {
+    struct rule_batch *batch = arg;
+    struct rule_matcher *matcher = &batch->set->matchers[shard];
     int processed = 0;
     
-    for (int i = 0; i < event_count; i++) {
-        struct security_event *event = &events[i];
+    for (uint64_t seq = batch->first; seq < batch->end; seq++) {
+        const struct event_record *event = event_store_get(seq);
+        if (shards > 1 && pid_shard(event->pid, shards) != shard) {
+            continue;
+        }
         
-        for (int j = 0; j < rule_count; j++) {
-            struct security_rule *rule = &rules[j];
-            
-            if (!rule->enabled || rule->event_type != event->type) {
-                continue;
-            }
+        const char *details = event_store_details(event);
+        const int *hits;
+        
+        // One scan of details finds every enabled rule of this type that matches
+        int count = rule_matcher_match(matcher, event->type, details, event->details_len, &hits);
+        for (int j = 0; j < count; j++) {
+            const struct security_rule *rule = &batch->set->rules[hits[j]];
             
-            if (match_rule_pattern(rule->pattern, event->details)) {
-                switch (rule->action) {
-                    case 0: // Log
-                        syslog(LOG_WARNING, "Security rule %d triggered: %s",
-                               rule->rule_id, event->details);
-                        break;
-                    case 1: // Alert
-                        syslog(LOG_ALERT, "SECURITY ALERT - Rule %d: %s",
-                               rule->rule_id, event->details);
-                        break;
-                    case 2: // Block
-                        syslog(LOG_CRIT, "SECURITY BLOCK - Rule %d: %s",
-                               rule->rule_id, event->details);
-                        // Could implement blocking logic here
-                        break;
-                }
-                processed++;
+            switch (rule->action) {
+                case 0: // Log
+                    audit_log(LOG_WARNING, "Security rule %d triggered: %s",
+                           rule->rule_id, details);
+                    break;
+                case 1: // Alert
+                    audit_log(LOG_ALERT, "SECURITY ALERT - Rule %d: %s",
+                           rule->rule_id, details);
+                    break;
+                case 2: // Block
+                case 3: // Kill
+                    // Enforced by add_security_event() when the event arrived
+                    audit_log(LOG_CRIT, "SECURITY %s - Rule %d: %s",
+                           rule->action == 3 ? "KILL" : "BLOCK", rule->rule_id, details);
+                    break;
             }
+            processed++;
         }
     }
     
+    batch->processed[shard] = processed;
+}
+
+int set_security_rule_workers(int count) {
+    if (!monitor_initialized) {
+        return -EINVAL;
+    }
+    
+    if (count <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        count = cpus > 0 ? (int)cpus : 1;
+    }
+    if (count > RULE_WORKERS_MAX) {
+        count = RULE_WORKERS_MAX;
+    }
+    
+    // The pool only changes size with a set compiled for it on the way
+    pthread_mutex_lock(&rules_lock);
+    int ret = rule_workers_resize(count);
+    struct ruleset *current = ruleset_current();
+    int rebuilt = publish_rules(current->rules, current->rule_count, current->correlations,
+                                current->correlation_count);
+    pthread_mutex_unlock(&rules_lock);
+    
+    if (ret < 0) {
+        audit_log(LOG_ERR, "Cannot start %d rule workers: %s", count, strerror(-ret));
+        return ret;
+    }
+    return rebuilt < 0 ? rebuilt : count;
+}
+
+int process_security_events(void) {
+    if (!monitor_initialized) {
+        return -EINVAL;
+    }
+    
+    drain_events();
+    cursor_catch_up(&rule_cursor);
+    
+    struct rule_batch batch;
+    int token;
+    batch.set = ruleset_read_lock(&token);
+    batch.first = rule_cursor.next;
+    batch.end = event_store_total();
+    rule_cursor.next = batch.end;
+    
+    // Waking the pool costs more than a small batch takes on one thread;
+    // a set built for another pool size (a resize that failed) is too
+    int shards = rule_workers_count();
+    if (batch.end - batch.first < SECURITY_SHARD_MIN_BATCH || batch.set->matcher_count != shards) {
+        evaluate_shard(0, 1, &batch);
+        ruleset_read_unlock(token);
+        return batch.processed[0];
+    }
+    
+    rule_workers_run(evaluate_shard, &batch);
+    ruleset_read_unlock(token);
+    
+    int processed = 0;
+    for (int i = 0; i < shards; i++) {
+        processed += batch.processed[i];
+    }
     return processed;
 }
 
@@ -140,37 +548,117 @@ int check_security_violations(void) {
     }
     
     int violations = 0;
-    time_t current_time = time(NULL);
     
-    // Check for suspicious patterns
-    for (int i = 0; i < event_count; i++) {
-        struct security_event *event = &events[i];
+    drain_events();
+    cursor_catch_up(&violation_cursor);
+    uint64_t total = event_store_total();
+    
+    // Correlation state belongs to this thread: pick up reloaded rules here
+    int token;
+    struct ruleset *set = ruleset_read_lock(&token);
+    if (set->generation != correlation_generation) {
+        correlation_set_rules(set->correlations, set->correlation_count);
+        correlation_generation = set->generation;
+    }
+    ruleset_read_unlock(token);
+    
+    // Check new events for suspicious patterns
+    for (; violation_cursor.next < total; violation_cursor.next++) {
+        const struct event_record *event = event_store_get(violation_cursor.next);
         
         // Check for privilege escalation attempts
         if (event->type == EVENT_PRIVILEGE_ESCALATION) {
             violations++;
-            syslog(LOG_ALERT, "Privilege escalation detected: PID %d, UID %d",
+            audit_log(LOG_ALERT, "Privilege escalation detected: PID %d, UID %d",
                    event->pid, event->uid);
         }
         
         // Check for policy violations
         if (event->type == EVENT_POLICY_VIOLATION) {
             violations++;
-            syslog(LOG_WARNING, "Policy violation: %s", event->details);
+            audit_log(LOG_WARNING, "Policy violation: %s", event_store_details(event));
         }
         
         // Check for anomalies
         if (event->type == EVENT_ANOMALY_DETECTED) {
             violations++;
-            syslog(LOG_NOTICE, "Anomaly detected: %s", event->details);
+            audit_log(LOG_NOTICE, "Anomaly detected: %s", event_store_details(event));
+        }
+        
+        // Sliding-window rules, keyed by uid and/or pid
+        const struct security_correlation_rule *fired[CORRELATION_MAX_RULES];
+        int count = correlation_observe(event, fired);
+        for (int j = 0; j < count; j++) {
+            int priority = fired[j]->action >= 2 ? LOG_CRIT :
+                           fired[j]->action == 1 ? LOG_ALERT : LOG_WARNING;
+            violations++;
+            audit_log(priority, "Correlation rule %d: %d events of type %d within %d s (PID %d, UID %d)",
+                   fired[j]->rule_id, fired[j]->threshold, event->type, fired[j]->window,
+                   event->pid, event->uid);
+            if (fired[j]->action >= 2) {
+                enforce_correlation(fired[j], event);
+            }
         }
     }
     
     return violations;
 }
 
+int get_security_monitor_stats(struct security_monitor_stats *stats) {
+    if (!monitor_initialized || !stats) {
+        return -EINVAL;
+    }
+    
+    stats->accepted = atomic_load_explicit(&event_ring.enqueue_pos, memory_order_relaxed);
+    stats->dropped = event_ring_dropped(&event_ring);
+    stats->overwritten = rule_cursor.missed;
+    correlation_stats(&stats->correlation_keys, &stats->correlation_evicted);
+    stats->blocked = atomic_load_explicit(&blocked, memory_order_relaxed);
+    stats->block_failed = atomic_load_explicit(&block_failed, memory_order_relaxed);
+    stats->kernel_lost = event_collectors_lost();
+    stats->journal_dropped = atomic_load_explicit(&journal_dropped, memory_order_relaxed);
+    
+    int token;
+    stats->rules_generation = ruleset_read_lock(&token)->generation;
+    ruleset_read_unlock(token);
+    return 0;
+}
+
+void security_event_cursor_init(struct security_event_cursor *cursor) {
+    // Events evicted before the cursor existed were never its to miss
+    cursor->next = event_store_first();
+    cursor->missed = 0;
+}
+
+int security_event_next(struct security_event_cursor *cursor, struct security_event *event) {
+    if (!monitor_initialized || !cursor || !event) {
+        return -EINVAL;
+    }
+    
+    drain_events();
+    cursor_catch_up(cursor);
+    if (cursor->next >= event_store_total()) {
+        return 0;
+    }
+    
+    const struct event_record *record = event_store_get(cursor->next++);
+    memset(event, 0, sizeof(*event));
+    event->type = (enum security_event_type)record->type;
+    event->timestamp = record->timestamp;
+    event->pid = record->pid;
+    event->uid = record->uid;
+    event->gid = record->gid;
+    event->severity = record->severity;
+    snprintf(event->process_name, sizeof(event->process_name), "%s", event_store_name(record));
+    memcpy(event->details, event_store_details(record), record->details_len + 1);
+    
+    return 1;
+}
+
+#ifndef SECURITY_MONITOR_NO_MAIN
 /* Test main function for compilation validation */
 int main(int argc, char *argv[]) {
     printf("SecureOS Security Monitor - Compilation Test Passed\n");
     return 0;
 }
+#endif
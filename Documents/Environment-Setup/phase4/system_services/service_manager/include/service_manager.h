@@ -2,10 +2,23 @@
 #define SERVICE_MANAGER_H
 
 #include <sys/types.h>
+#include <stdint.h>
+#include <time.h>
 
-#define MAX_SERVICES 256
 #define MAX_SERVICE_NAME 64
 #define MAX_COMMAND_LEN 512
+#define MAX_SERVICE_DEPS 16
+#define MAX_SERVICE_FIELDS 256 // Words per service definition line
+#define SERVICE_STOP_TIMEOUT 5 // Seconds between SIGTERM and SIGKILL
+#define SERVICE_START_TIMEOUT 90 // Seconds a notify service has to report READY=1
+#define SERVICE_NOTIFY_ENV "NOTIFY_SOCKET"
+#define SERVICE_CGROUP_ROOT "/sys/fs/cgroup/secureos.slice"
+#define SERVICE_CGROUP_ROOT_ENV "SECUREOS_CGROUP_ROOT" // Overrides SERVICE_CGROUP_ROOT
+#define SERVICE_CGROUP_POOL_SIZE 16 // Idle cgroups kept ready for launches
+#define SERVICE_RESTART_DELAY_MS 100 // First automatic restart delay, doubled per failure
+#define SERVICE_RESTART_MAX_DELAY_MS 30000
+#define SERVICE_RESTART_BURST 10 // Automatic restarts allowed per window
+#define SERVICE_RESTART_WINDOW 60 // Seconds; also the uptime that resets the backoff
 
 enum service_state {
     SERVICE_STOPPED = 0,
@@ -15,6 +28,11 @@ enum service_state {
     SERVICE_FAILED
 };
 
+enum service_type {
+    SERVICE_TYPE_SIMPLE = 0, // Ready as soon as it has been spawned
+    SERVICE_TYPE_NOTIFY      // Ready once it sends READY=1 to NOTIFY_SOCKET
+};
+
 struct service_config {
     char name[MAX_SERVICE_NAME];
     char command[MAX_COMMAND_LEN];
@@ -24,8 +42,13 @@ struct service_config {
     gid_t gid;
     int auto_restart;
     int security_level;
-    unsigned long memory_limit;
-    unsigned long cpu_limit;
+    unsigned long memory_limit; // Bytes, 0 for no limit
+    unsigned long cpu_limit;    // Percent of one CPU, 0 for no limit
+    enum service_type type;
+    char after[MAX_SERVICE_DEPS][MAX_SERVICE_NAME];    // Ordering only
+    int after_count;
+    char requires[MAX_SERVICE_DEPS][MAX_SERVICE_NAME]; // Ordering + must succeed
+    int requires_count;
 };
 
 struct service {
@@ -34,6 +57,23 @@ struct service {
     enum service_state state;
     time_t start_time;
     int restart_count;
+    int pidfd;                  // -1 when not watched by the supervisor
+    int stop_timeout;           // Seconds to wait after SIGTERM
+    struct timespec deadline;   // Monotonic readiness deadline while starting,
+                                // SIGKILL deadline while stopping
+    int sched_index;            // Dependency scheduler node, -1 when idle
+    int registry_index;         // Position in the registry's service list
+    int restart_pending;        // Start again once the current instance exits
+    int exit_status;            // Last wait status reported for this service
+    int cgroup_slot;            // Pool cgroup holding the service, -1 if none
+    int stop_failed;            // Stopped for failing; its exit counts as a failure
+    int restart_attempts;       // Consecutive failures, drives the backoff
+    int restart_burst;          // Automatic restarts in the current window
+    time_t restart_window;      // Monotonic start of that window
+    uint64_t restart_tick;      // Restart wheel expiry, 0 when none is pending
+    struct service *restart_next; // Restart wheel bucket links
+    struct service *restart_prev;
+    unsigned int config_generation; // Last configuration load that listed it
 };
 
 int start_service(const char *service_name);
@@ -42,4 +82,22 @@ int restart_service(const char *service_name);
 int load_service_config(const char *config_file);
 int validate_service_security(struct service *svc);
 
+/* Event-driven supervisor (pidfd/signalfd + epoll) */
+int supervisor_init(void);
+void supervisor_shutdown(void);
+int supervisor_poll(int timeout_ms);
+int service_stop_async(const char *service_name);
+int service_restart_async(const char *service_name);
+int stop_services(const char *const *service_names, int count);
+int stop_all_services(void);
+
+/* Dependency-ordered parallel startup */
+int start_all_services(void);
+
+/* Compiled binary configuration; reload starts added, stops removed and
+ * restarts changed services */
+int compile_service_config(const char *config_file, const char *blob_file);
+int load_service_blob(const char *blob_file);
+int reload_service_blob(const char *blob_file);
+
 #endif /* SERVICE_MANAGER_H */
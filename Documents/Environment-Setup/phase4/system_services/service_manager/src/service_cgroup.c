@@ -0,0 +1,290 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/vfs.h>
+#include "service_internal.h"
+
+/* cgroup v2 enforcement of memory_limit (bytes) and cpu_limit (percent of
+ * one CPU). A pool of empty child cgroups is created ahead of time under
+ * the service slice and kept open, so a launch only rewrites the limit
+ * files that changed and the child is cloned straight into its cgroup -
+ * no mkdir and no cgroup.procs migration on the start path. Slots are
+ * recycled once the service and everything it forked have exited. */
+
+#define CGROUP2_SUPER_MAGIC 0x63677270
+#define CGROUP_CPU_PERIOD 100000
+#define CGROUP_LIMIT_UNSET ((unsigned long)-1)
+
+struct cgroup_slot {
+    int fd;                     // Directory fd, kept open for CLONE_INTO_CGROUP
+    int busy;                   // Owned by a running service
+    int draining;               // Killed, waiting for cgroup.events to empty
+    unsigned long memory_max;   // Last values written, to skip rewrites
+    unsigned long cpu_max;
+};
+
+static struct cgroup_slot *slots = NULL;
+static int slot_count = 0;
+static int idle_count = 0;
+static int root_fd = -1;
+static int cgroup_state = 0;    // 0 untried, 1 available, -1 unavailable
+
+static int write_cgroup_file(int dir_fd, const char *file, const char *value) {
+    int fd = openat(dir_fd, file, O_WRONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -errno;
+    }
+
+    size_t len = strlen(value);
+    int ret = write(fd, value, len) == (ssize_t)len ? 0 : -errno;
+    close(fd);
+    return ret;
+}
+
+/* "populated 1" in cgroup.events means some process is still inside */
+static int cgroup_populated(int dir_fd) {
+    char buf[256];
+    int fd = openat(dir_fd, "cgroup.events", O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -errno;
+    }
+
+    ssize_t n = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (n < 0) {
+        return -errno;
+    }
+
+    buf[n] = '\0';
+    return strstr(buf, "populated 1") != NULL;
+}
+
+static const char *cgroup_root_path(void) {
+    const char *root = getenv(SERVICE_CGROUP_ROOT_ENV);
+    return (root && *root) ? root : SERVICE_CGROUP_ROOT;
+}
+
+static int cgroup_setup(void) {
+    const char *root = cgroup_root_path();
+    char parent[256];
+    struct statfs fs;
+
+    if ((size_t)snprintf(parent, sizeof(parent), "%s", root) >= sizeof(parent)) {
+        return -ENAMETOOLONG;
+    }
+    char *slash = strrchr(parent, '/');
+    if (!slash || slash == parent) {
+        return -EINVAL;
+    }
+    *slash = '\0';
+
+    if (statfs(parent, &fs) < 0) {
+        return -errno;
+    }
+    if (fs.f_type != CGROUP2_SUPER_MAGIC) {
+        return -EOPNOTSUPP; // Legacy or hybrid hierarchy
+    }
+
+    if (mkdir(root, 0755) < 0 && errno != EEXIST) {
+        return -errno;
+    }
+
+    root_fd = open(root, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (root_fd < 0) {
+        return -errno;
+    }
+
+    // Delegate memory and cpu down to the pool; already enabled is fine
+    int parent_fd = open(parent, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (parent_fd >= 0) {
+        write_cgroup_file(parent_fd, "cgroup.subtree_control", "+memory +cpu");
+        close(parent_fd);
+    }
+
+    int ret = write_cgroup_file(root_fd, "cgroup.subtree_control", "+memory +cpu");
+    if (ret < 0) {
+        close(root_fd);
+        root_fd = -1;
+        return ret;
+    }
+
+    return 0;
+}
+
+/* Reported once; afterwards -EOPNOTSUPP tells callers to run unconfined */
+static int cgroup_available(void) {
+    if (cgroup_state == 0) {
+        int ret = cgroup_setup();
+        cgroup_state = ret < 0 ? -1 : 1;
+        if (ret < 0) {
+            printf("cgroup v2 unavailable under %s (%s): service limits not enforced\n",
+                   cgroup_root_path(), strerror(-ret));
+        }
+    }
+    return cgroup_state > 0 ? 0 : -EOPNOTSUPP;
+}
+
+/* Slow path: mkdir one more pool cgroup */
+static int create_slot(void) {
+    char name[32];
+
+    struct cgroup_slot *grown = realloc(slots, (slot_count + 1) * sizeof(*grown));
+    if (!grown) {
+        return -ENOMEM;
+    }
+    slots = grown;
+
+    snprintf(name, sizeof(name), "pool-%d", slot_count);
+    if (mkdirat(root_fd, name, 0755) < 0 && errno != EEXIST) {
+        return -errno;
+    }
+
+    int fd = openat(root_fd, name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        return -errno;
+    }
+
+    struct cgroup_slot *slot = &slots[slot_count];
+    slot->fd = fd;
+    slot->busy = 0;
+    slot->memory_max = CGROUP_LIMIT_UNSET;
+    slot->cpu_max = CGROUP_LIMIT_UNSET;
+
+    // Left over from a previous run: kill and let maintenance reclaim it
+    slot->draining = cgroup_populated(fd) > 0;
+    if (slot->draining) {
+        write_cgroup_file(fd, "cgroup.kill", "1");
+    } else {
+        idle_count++;
+    }
+
+    return slot_count++;
+}
+
+static int apply_limits(struct cgroup_slot *slot, const struct service_config *config) {
+    char value[64];
+    int ret;
+
+    if (slot->memory_max != config->memory_limit) {
+        if (config->memory_limit) {
+            snprintf(value, sizeof(value), "%lu", config->memory_limit);
+        } else {
+            strcpy(value, "max");
+        }
+        ret = write_cgroup_file(slot->fd, "memory.max", value);
+        if (ret < 0) {
+            slot->memory_max = CGROUP_LIMIT_UNSET;
+            return ret;
+        }
+        slot->memory_max = config->memory_limit;
+    }
+
+    if (slot->cpu_max != config->cpu_limit) {
+        if (config->cpu_limit) {
+            snprintf(value, sizeof(value), "%lu %d",
+                     config->cpu_limit * CGROUP_CPU_PERIOD / 100, CGROUP_CPU_PERIOD);
+        } else {
+            snprintf(value, sizeof(value), "max %d", CGROUP_CPU_PERIOD);
+        }
+        ret = write_cgroup_file(slot->fd, "cpu.max", value);
+        if (ret < 0) {
+            slot->cpu_max = CGROUP_LIMIT_UNSET;
+            return ret;
+        }
+        slot->cpu_max = config->cpu_limit;
+    }
+
+    return 0;
+}
+
+/* Hands out an idle pool cgroup with the service's limits applied and
+ * returns its directory fd; the slot index is stored in svc->cgroup_slot */
+int service_cgroup_acquire(struct service *svc) {
+    int ret = cgroup_available();
+    if (ret < 0) {
+        return ret;
+    }
+
+    int index = -1;
+    for (int i = 0; i < slot_count; i++) {
+        if (!slots[i].busy && !slots[i].draining) {
+            index = i;
+            break;
+        }
+    }
+
+    if (index < 0) {
+        // Pool exhausted (or still being filled) - pay for the mkdir now
+        do {
+            index = create_slot();
+        } while (index >= 0 && slots[index].draining);
+        if (index < 0) {
+            return index;
+        }
+    }
+
+    struct cgroup_slot *slot = &slots[index];
+    ret = apply_limits(slot, &svc->config);
+    if (ret < 0) {
+        return ret;
+    }
+
+    slot->busy = 1;
+    idle_count--;
+    svc->cgroup_slot = index;
+    return slot->fd;
+}
+
+/* Called once the main process has been reaped */
+void service_cgroup_release(struct service *svc) {
+    int index = svc->cgroup_slot;
+
+    if (index < 0 || index >= slot_count) {
+        return;
+    }
+
+    struct cgroup_slot *slot = &slots[index];
+    svc->cgroup_slot = -1;
+    slot->busy = 0;
+
+    // Anything the service forked must not leak into the next tenant
+    if (cgroup_populated(slot->fd) > 0) {
+        write_cgroup_file(slot->fd, "cgroup.kill", "1");
+        slot->draining = 1;
+        return;
+    }
+
+    idle_count++;
+}
+
+/* Fills the pool before a batch of limited services is launched */
+void service_cgroup_prepare(void) {
+    if (cgroup_available() == 0) {
+        service_cgroup_maintain();
+    }
+}
+
+/* Off the launch path: reclaim drained slots and top the pool back up */
+void service_cgroup_maintain(void) {
+    if (cgroup_state != 1) {
+        return;
+    }
+
+    for (int i = 0; i < slot_count; i++) {
+        if (slots[i].draining && cgroup_populated(slots[i].fd) == 0) {
+            slots[i].draining = 0;
+            idle_count++;
+        }
+    }
+
+    while (idle_count < SERVICE_CGROUP_POOL_SIZE) {
+        if (create_slot() < 0) {
+            break;
+        }
+    }
+}
@@ -0,0 +1,573 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "service_internal.h"
+
+/* Compiled service configuration. The text file is parsed once by
+ * compile_service_config() into fixed-size records behind a versioned,
+ * CRC-32 checked header; the manager maps the blob and decodes it without
+ * any text parsing. The compiler writes a temporary file and rename()s it
+ * over the old blob, so a reader sees either the old or the new file,
+ * never a partial one. reload_service_blob() validates the whole new blob
+ * before touching a single service, then applies the difference: added
+ * services are started through the dependency scheduler, so after= and
+ * requires= hold among them and against services already running;
+ * removed ones are stopped, changed ones restarted.
+ *
+ * Records are stored in host byte order; the byte-order mark rejects a
+ * blob compiled on a machine of the other endianness. */
+
+#define SERVICE_BLOB_MAGIC "SOSSVCB"
+#define SERVICE_BLOB_VERSION 1
+#define SERVICE_BLOB_BOM 0x01020304u
+
+struct service_blob_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t record_size;
+    uint32_t count;
+    uint32_t checksum;          // CRC-32 of the record array
+    uint32_t reserved;
+};
+
+struct service_blob_record {
+    char name[MAX_SERVICE_NAME];
+    char command[MAX_COMMAND_LEN];
+    char user[32];
+    char group[32];
+    int32_t security_level;
+    int32_t auto_restart;
+    uint32_t type;
+    uint32_t after_count;
+    uint32_t requires_count;
+    uint32_t reserved;
+    uint64_t memory_limit;
+    uint64_t cpu_limit;
+    char after[MAX_SERVICE_DEPS][MAX_SERVICE_NAME];
+    char requires[MAX_SERVICE_DEPS][MAX_SERVICE_NAME];
+};
+
+struct service_blob {
+    void *base;
+    size_t size;
+    const struct service_blob_record *records;
+    uint32_t count;
+};
+
+static unsigned int config_generation = 0;
+
+static uint32_t crc32_update(uint32_t crc, const void *data, size_t len) {
+    static uint32_t table[256];
+    const unsigned char *p = data;
+
+    if (!table[1]) {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            table[i] = c;
+        }
+    }
+
+    crc = ~crc;
+    while (len--) {
+        crc = table[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+/* dst is already zeroed, so copying the bytes leaves it terminated */
+static void copy_string(char *dst, const char *src, size_t size) {
+    memcpy(dst, src, strnlen(src, size - 1));
+}
+
+/* Zero-filled so that equal configurations encode to identical bytes */
+static void encode_record(const struct service_config *config, struct service_blob_record *rec) {
+    memset(rec, 0, sizeof(*rec));
+    copy_string(rec->name, config->name, sizeof(rec->name));
+    copy_string(rec->command, config->command, sizeof(rec->command));
+    copy_string(rec->user, config->user, sizeof(rec->user));
+    copy_string(rec->group, config->group, sizeof(rec->group));
+    rec->security_level = config->security_level;
+    rec->auto_restart = config->auto_restart;
+    rec->type = config->type;
+    rec->memory_limit = config->memory_limit;
+    rec->cpu_limit = config->cpu_limit;
+    rec->after_count = config->after_count;
+    rec->requires_count = config->requires_count;
+    for (int i = 0; i < config->after_count; i++) {
+        copy_string(rec->after[i], config->after[i], MAX_SERVICE_NAME);
+    }
+    for (int i = 0; i < config->requires_count; i++) {
+        copy_string(rec->requires[i], config->requires[i], MAX_SERVICE_NAME);
+    }
+}
+
+static int terminated(const char *field, size_t size) {
+    return memchr(field, '\0', size) != NULL;
+}
+
+static int decode_record(const struct service_blob_record *rec, struct service_config *config) {
+    if (!terminated(rec->name, sizeof(rec->name)) || !rec->name[0] ||
+        !terminated(rec->command, sizeof(rec->command)) ||
+        !terminated(rec->user, sizeof(rec->user)) ||
+        !terminated(rec->group, sizeof(rec->group)) ||
+        rec->type > SERVICE_TYPE_NOTIFY ||
+        rec->after_count > MAX_SERVICE_DEPS || rec->requires_count > MAX_SERVICE_DEPS) {
+        return -EINVAL;
+    }
+
+    memset(config, 0, sizeof(*config));
+    strcpy(config->name, rec->name);
+    strcpy(config->command, rec->command);
+    strcpy(config->user, rec->user);
+    strcpy(config->group, rec->group);
+    config->security_level = rec->security_level;
+    config->auto_restart = rec->auto_restart;
+    config->type = rec->type;
+    config->memory_limit = rec->memory_limit;
+    config->cpu_limit = rec->cpu_limit;
+    config->after_count = rec->after_count;
+    config->requires_count = rec->requires_count;
+
+    for (uint32_t i = 0; i < rec->after_count; i++) {
+        if (!terminated(rec->after[i], MAX_SERVICE_NAME)) {
+            return -EINVAL;
+        }
+        strcpy(config->after[i], rec->after[i]);
+    }
+    for (uint32_t i = 0; i < rec->requires_count; i++) {
+        if (!terminated(rec->requires[i], MAX_SERVICE_NAME)) {
+            return -EINVAL;
+        }
+        strcpy(config->requires[i], rec->requires[i]);
+    }
+    return 0;
+}
+
+static int write_all(int fd, const void *data, size_t len) {
+    const char *p = data;
+
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -errno;
+        }
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static int compare_record_names(const void *a, const void *b) {
+    const struct service_blob_record *const *x = a;
+    const struct service_blob_record *const *y = b;
+    return strcmp((*x)->name, (*y)->name);
+}
+
+/* Sorted name index, so large configurations don't pay a quadratic scan */
+static int check_duplicates(const struct service_blob_record *records, uint32_t count) {
+    const struct service_blob_record **index = malloc((count ? count : 1) * sizeof(*index));
+    int ret = 0;
+
+    if (!index) {
+        return -ENOMEM;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        index[i] = &records[i];
+    }
+
+    qsort(index, count, sizeof(*index), compare_record_names);
+    for (uint32_t i = 1; i < count; i++) {
+        if (strcmp(index[i - 1]->name, index[i]->name) == 0) {
+            fprintf(stderr, "Duplicate service %s\n", index[i]->name);
+            ret = -EEXIST;
+            break;
+        }
+    }
+
+    free(index);
+    return ret;
+}
+
+/* Parses the whole text file; any invalid line fails the compile */
+static int read_text_config(const char *config_file, struct service_blob_record **out, uint32_t *count) {
+    struct service_blob_record *records = NULL;
+    uint32_t used = 0, cap = 0;
+    char line[4096];
+    int line_no = 0;
+    int ret = 0;
+
+    FILE *file = fopen(config_file, "r");
+    if (!file) {
+        return -errno;
+    }
+
+    while (ret == 0 && fgets(line, sizeof(line), file)) {
+        struct service_config config;
+
+        line_no++;
+        ret = parse_service_line(line, &config);
+        if (ret == -ENODATA) {
+            ret = 0;
+            continue;
+        }
+        if (ret < 0) {
+            fprintf(stderr, "%s:%d: invalid service definition\n", config_file, line_no);
+            break;
+        }
+
+        if (used == cap) {
+            cap = cap ? cap * 2 : 16;
+            struct service_blob_record *grown = realloc(records, cap * sizeof(*grown));
+            if (!grown) {
+                ret = -ENOMEM;
+                break;
+            }
+            records = grown;
+        }
+        encode_record(&config, &records[used++]);
+    }
+
+    fclose(file);
+    if (ret == 0) {
+        ret = check_duplicates(records, used);
+    }
+    if (ret < 0) {
+        free(records);
+        return ret;
+    }
+
+    *out = records;
+    *count = used;
+    return 0;
+}
+
+int compile_service_config(const char *config_file, const char *blob_file) {
+    struct service_blob_record *records = NULL;
+    struct service_blob_header header;
+    char tmp_path[PATH_MAX];
+    uint32_t count = 0;
+
+    int ret = read_text_config(config_file, &records, &count);
+    if (ret < 0) {
+        return ret;
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SERVICE_BLOB_MAGIC, sizeof(header.magic));
+    header.version = SERVICE_BLOB_VERSION;
+    header.byte_order = SERVICE_BLOB_BOM;
+    header.record_size = sizeof(struct service_blob_record);
+    header.count = count;
+    header.checksum = crc32_update(0, records, (size_t)count * sizeof(*records));
+
+    if ((size_t)snprintf(tmp_path, sizeof(tmp_path), "%s.%d.tmp", blob_file, (int)getpid()) >=
+        sizeof(tmp_path)) {
+        free(records);
+        return -ENAMETOOLONG;
+    }
+
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        ret = -errno;
+        free(records);
+        return ret;
+    }
+
+    ret = write_all(fd, &header, sizeof(header));
+    if (ret == 0) {
+        ret = write_all(fd, records, (size_t)count * sizeof(*records));
+    }
+    if (ret == 0 && fsync(fd) < 0) {
+        ret = -errno;
+    }
+    close(fd);
+    free(records);
+
+    if (ret == 0 && rename(tmp_path, blob_file) < 0) {
+        ret = -errno;
+    }
+    if (ret < 0) {
+        unlink(tmp_path);
+        return ret;
+    }
+
+    // Make the rename itself durable
+    char dir_path[PATH_MAX];
+    snprintf(dir_path, sizeof(dir_path), "%s", blob_file);
+    int dir_fd = open(dirname(dir_path), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir_fd >= 0) {
+        fsync(dir_fd);
+        close(dir_fd);
+    }
+
+    return (int)count;
+}
+
+static void blob_unmap(struct service_blob *blob) {
+    if (blob->base) {
+        munmap(blob->base, blob->size);
+    }
+    memset(blob, 0, sizeof(*blob));
+}
+
+static int blob_map(const char *blob_file, struct service_blob *blob) {
+    struct stat st;
+
+    memset(blob, 0, sizeof(*blob));
+
+    int fd = open(blob_file, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -errno;
+    }
+    if (fstat(fd, &st) < 0) {
+        int ret = -errno;
+        close(fd);
+        return ret;
+    }
+    if ((size_t)st.st_size < sizeof(struct service_blob_header)) {
+        close(fd);
+        return -EBADMSG;
+    }
+
+    void *base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        return -errno;
+    }
+
+    blob->base = base;
+    blob->size = st.st_size;
+
+    const struct service_blob_header *header = base;
+    if (memcmp(header->magic, SERVICE_BLOB_MAGIC, sizeof(header->magic)) != 0 ||
+        header->byte_order != SERVICE_BLOB_BOM) {
+        blob_unmap(blob);
+        return -EBADMSG;
+    }
+    if (header->version != SERVICE_BLOB_VERSION ||
+        header->record_size != sizeof(struct service_blob_record)) {
+        blob_unmap(blob);
+        return -EPROTO; // Compiled by a different manager version
+    }
+
+    size_t payload = (size_t)header->count * sizeof(struct service_blob_record);
+    if (blob->size != sizeof(*header) + payload) {
+        blob_unmap(blob);
+        return -EBADMSG;
+    }
+
+    blob->records = (const struct service_blob_record *)(header + 1);
+    blob->count = header->count;
+    if (crc32_update(0, blob->records, payload) != header->checksum) {
+        blob_unmap(blob);
+        return -EBADMSG;
+    }
+
+    return 0;
+}
+
+/* Decodes every record up front so a bad blob changes nothing */
+static int blob_decode(const char *blob_file, struct service_config **out, uint32_t *count) {
+    struct service_blob blob;
+
+    int ret = blob_map(blob_file, &blob);
+    if (ret < 0) {
+        return ret;
+    }
+
+    struct service_config *configs = calloc(blob.count ? blob.count : 1, sizeof(*configs));
+    if (!configs) {
+        blob_unmap(&blob);
+        return -ENOMEM;
+    }
+
+    uint32_t decoded = blob.count;
+    for (uint32_t i = 0; i < decoded && ret == 0; i++) {
+        ret = decode_record(&blob.records[i], &configs[i]);
+    }
+    blob_unmap(&blob);
+
+    if (ret < 0) {
+        free(configs);
+        return ret;
+    }
+
+    *out = configs;
+    *count = decoded;
+    return 0;
+}
+
+int load_service_blob(const char *blob_file) {
+    struct service_config *configs;
+    uint32_t count;
+
+    int ret = blob_decode(blob_file, &configs, &count);
+    if (ret < 0) {
+        return ret;
+    }
+
+    config_generation++;
+    for (uint32_t i = 0; i < count; i++) {
+        struct service *svc = service_create(&configs[i]);
+        if (!svc) {
+            free(configs);
+            return -ENOMEM;
+        }
+
+        ret = registry_add(svc);
+        if (ret < 0) {
+            fprintf(stderr, "Service %s: %s\n", svc->config.name,
+                    ret == -EEXIST ? "duplicate definition ignored" : strerror(-ret));
+            free(svc);
+            continue;
+        }
+        svc->config_generation = config_generation;
+    }
+
+    free(configs);
+    return service_total();
+}
+
+static int config_changed(const struct service_config *old, const struct service_config *new) {
+    struct service_blob_record a, b;
+
+    encode_record(old, &a);
+    encode_record(new, &b);
+    return memcmp(&a, &b, sizeof(a)) != 0;
+}
+
+static int remove_services(unsigned int generation) {
+    struct service **removed = NULL;
+    const char **names = NULL;
+    struct service *svc;
+    int count = 0;
+    int cursor = 0;
+
+    int total = service_total();
+    removed = calloc(total ? total : 1, sizeof(*removed));
+    names = calloc(total ? total : 1, sizeof(*names));
+    if (!removed || !names) {
+        free(removed);
+        free(names);
+        return -ENOMEM;
+    }
+
+    while ((svc = next_service(&cursor)) != NULL) {
+        if (svc->config_generation != generation) {
+            removed[count] = svc;
+            names[count++] = svc->config.name;
+        }
+    }
+
+    // Stopped in parallel; returns once every one of them has exited
+    int ret = stop_services(names, count);
+
+    for (int i = 0; i < count; i++) {
+        svc = removed[i];
+        svc->restart_pending = 0;
+        restart_cancel(svc);
+        if (svc->pid > 0) {
+            continue; // Refused to die: keep tracking it rather than leak it
+        }
+        registry_remove(svc);
+        printf("Service %s removed\n", svc->config.name);
+        free(svc);
+    }
+
+    free(removed);
+    free(names);
+    return ret < 0 ? ret : count;
+}
+
+int reload_service_blob(const char *blob_file) {
+    struct service_config *configs;
+    uint32_t count;
+    int added = 0, changed = 0;
+    int first_error = 0;
+
+    int ret = blob_decode(blob_file, &configs, &count);
+    if (ret < 0) {
+        return ret;
+    }
+
+    unsigned int generation = ++config_generation;
+    struct service **created = calloc(count ? count : 1, sizeof(*created));
+    if (!created) {
+        free(configs);
+        return -ENOMEM;
+    }
+
+    // Mark survivors and apply changed definitions
+    for (uint32_t i = 0; i < count; i++) {
+        struct service *svc = find_service(configs[i].name);
+        if (!svc) {
+            continue;
+        }
+        svc->config_generation = generation;
+
+        if (!config_changed(&svc->config, &configs[i])) {
+            continue;
+        }
+        svc->config = configs[i];
+        changed++;
+
+        if (svc->state == SERVICE_RUNNING || svc->state == SERVICE_STARTING ||
+            svc->state == SERVICE_STOPPING) {
+            ret = service_restart_async(svc->config.name);
+            if (ret < 0 && first_error == 0) {
+                first_error = ret;
+            }
+        }
+    }
+
+    int removed = remove_services(generation);
+    if (removed < 0 && first_error == 0) {
+        first_error = removed;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (find_service(configs[i].name)) {
+            continue;
+        }
+
+        struct service *svc = service_create(&configs[i]);
+        if (!svc || registry_add(svc) < 0) {
+            free(svc);
+            if (first_error == 0) {
+                first_error = -ENOMEM;
+            }
+            continue;
+        }
+        svc->config_generation = generation;
+        created[added++] = svc;
+    }
+
+    // In dependency order among themselves and against running services
+    ret = scheduler_start_services(created, added);
+    if (ret < 0 && first_error == 0) {
+        first_error = ret;
+    }
+
+    printf("Reloaded %s: %d added, %d removed, %d changed\n",
+           blob_file, added, removed > 0 ? removed : 0, changed);
+
+    free(created);
+    free(configs);
+    return first_error;
+}
@@ -0,0 +1,373 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <pwd.h>
+#include <grp.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include "service_internal.h"
+
+/* User/group resolution for service launches. /etc/passwd and /etc/group
+ * are parsed once into hash tables and only re-read after inotify reports
+ * a change to either file, so a crash-looping service no longer goes
+ * through NSS on every restart. Names missing from the files (LDAP, sssd)
+ * fall back to getpwnam_r()/getgrnam_r() and the answer is cached until
+ * the next reload. All entry points are thread-safe. */
+
+#ifndef SERVICE_PASSWD_FILE
+#define SERVICE_PASSWD_FILE "/etc/passwd"
+#endif
+#ifndef SERVICE_GROUP_FILE
+#define SERVICE_GROUP_FILE "/etc/group"
+#endif
+
+#define CRED_NAME_LEN 32    // Matches service_config.user/group
+#define CRED_MIN_SLOTS 64
+#define CRED_NSS_BUFFER 16384
+
+struct cred_entry {
+    uint32_t hash;
+    int used;
+    char name[CRED_NAME_LEN];
+    uint32_t id;            // uid or gid
+    uint32_t gid;           // Primary group, users only
+};
+
+struct cred_table {
+    struct cred_entry *slots;
+    size_t size;            // Always a power of two
+    size_t used;
+    int stale;              // Re-read the file before the next lookup
+    const char *path;
+    struct timespec mtime;  // Change detection when inotify is unavailable
+};
+
+static pthread_mutex_t cred_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct cred_table users = { .stale = 1, .path = SERVICE_PASSWD_FILE };
+static struct cred_table groups = { .stale = 1, .path = SERVICE_GROUP_FILE };
+static int inotify_fd = -1;
+static int watch_state = 0;     // 0 untried, 1 watching, -1 polling mtimes
+
+static uint32_t hash_name(const char *name) {
+    uint32_t hash = 2166136261u;
+    while (*name) {
+        hash ^= (unsigned char)*name++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static void table_clear(struct cred_table *table) {
+    if (table->slots) {
+        memset(table->slots, 0, table->size * sizeof(*table->slots));
+    }
+    table->used = 0;
+}
+
+static int table_grow(struct cred_table *table) {
+    size_t size = table->size ? table->size * 2 : CRED_MIN_SLOTS;
+    struct cred_entry *slots = calloc(size, sizeof(*slots));
+    if (!slots) {
+        return -ENOMEM;
+    }
+
+    for (size_t i = 0; i < table->size; i++) {
+        if (!table->slots[i].used) {
+            continue;
+        }
+        size_t pos = table->slots[i].hash & (size - 1);
+        while (slots[pos].used) {
+            pos = (pos + 1) & (size - 1);
+        }
+        slots[pos] = table->slots[i];
+    }
+
+    free(table->slots);
+    table->slots = slots;
+    table->size = size;
+    return 0;
+}
+
+static struct cred_entry *table_find(struct cred_table *table, const char *name, uint32_t hash) {
+    if (!table->size) {
+        return NULL;
+    }
+
+    for (size_t pos = hash & (table->size - 1);; pos = (pos + 1) & (table->size - 1)) {
+        struct cred_entry *entry = &table->slots[pos];
+        if (!entry->used) {
+            return NULL;
+        }
+        if (entry->hash == hash && strcmp(entry->name, name) == 0) {
+            return entry;
+        }
+    }
+}
+
+/* First definition wins, as with the files NSS module */
+static int table_insert(struct cred_table *table, const char *name, uint32_t id, uint32_t gid) {
+    if (strlen(name) >= CRED_NAME_LEN) {
+        return 0; // Cannot be named by a service configuration
+    }
+
+    uint32_t hash = hash_name(name);
+    if (table_find(table, name, hash)) {
+        return 0;
+    }
+
+    if ((table->used + 1) * 10 > table->size * 7 && table_grow(table) < 0) {
+        return -ENOMEM;
+    }
+
+    size_t pos = hash & (table->size - 1);
+    while (table->slots[pos].used) {
+        pos = (pos + 1) & (table->size - 1);
+    }
+
+    struct cred_entry *entry = &table->slots[pos];
+    entry->hash = hash;
+    entry->used = 1;
+    strcpy(entry->name, name);
+    entry->id = id;
+    entry->gid = gid;
+    table->used++;
+    return 0;
+}
+
+static int parse_id(const char *field, uint32_t *id) {
+    char *end;
+
+    errno = 0;
+    unsigned long value = strtoul(field, &end, 10);
+    if (errno || end == field || *end || value > UINT32_MAX - 1) {
+        return -EINVAL;
+    }
+    *id = (uint32_t)value;
+    return 0;
+}
+
+/* name:passwd:uid:gid:... for passwd, name:passwd:gid:members for group */
+static int table_load(struct cred_table *table, int with_gid) {
+    char line[4096];
+    struct stat st;
+
+    FILE *file = fopen(table->path, "re");
+    if (!file) {
+        table_clear(table);
+        return -errno;
+    }
+
+    if (fstat(fileno(file), &st) == 0) {
+        table->mtime = st.st_mtim;
+    }
+
+    table_clear(table);
+    while (fgets(line, sizeof(line), file)) {
+        char *fields[4];
+        char *cursor = line;
+        int count = 0;
+
+        if (line[0] == '#' || line[0] == '+' || line[0] == '-') {
+            continue; // Comments and NIS compat entries
+        }
+
+        while (count < 4 && cursor) {
+            fields[count++] = cursor;
+            cursor = strchr(cursor, ':');
+            if (cursor) {
+                *cursor++ = '\0';
+            }
+        }
+
+        uint32_t id, gid = 0;
+        if (count < (with_gid ? 4 : 3) || !fields[0][0] || parse_id(fields[2], &id) < 0 ||
+            (with_gid && parse_id(fields[3], &gid) < 0)) {
+            continue;
+        }
+
+        if (table_insert(table, fields[0], id, gid) < 0) {
+            fclose(file);
+            return -ENOMEM;
+        }
+    }
+
+    fclose(file);
+    table->stale = 0;
+    return 0;
+}
+
+/* Watch the directory rather than the files: editors and useradd replace
+ * them by rename(), which would orphan a watch on the old inode */
+static void watch_files(void) {
+    char dir[PATH_MAX];
+
+    snprintf(dir, sizeof(dir), "%s", SERVICE_PASSWD_FILE);
+    char *slash = strrchr(dir, '/');
+    if (slash) {
+        *(slash == dir ? slash + 1 : slash) = '\0';
+    }
+
+    inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd >= 0 &&
+        inotify_add_watch(inotify_fd, slash ? dir : ".",
+                          IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE) < 0) {
+        close(inotify_fd);
+        inotify_fd = -1;
+    }
+    watch_state = inotify_fd >= 0 ? 1 : -1;
+}
+
+static int matches_file(const char *name, const char *path) {
+    const char *base = strrchr(path, '/');
+    return strcmp(name, base ? base + 1 : path) == 0;
+}
+
+static void drain_events(void) {
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t n;
+
+    while ((n = read(inotify_fd, buf, sizeof(buf))) > 0) {
+        for (char *ptr = buf; ptr < buf + n;) {
+            struct inotify_event *event = (struct inotify_event *)ptr;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                users.stale = groups.stale = 1;
+            } else if (event->len) {
+                if (matches_file(event->name, users.path)) {
+                    users.stale = 1;
+                }
+                if (matches_file(event->name, groups.path)) {
+                    groups.stale = 1;
+                }
+            }
+            ptr += sizeof(*event) + event->len;
+        }
+    }
+}
+
+static void check_mtime(struct cred_table *table) {
+    struct stat st;
+
+    if (stat(table->path, &st) < 0 || st.st_mtim.tv_sec != table->mtime.tv_sec ||
+        st.st_mtim.tv_nsec != table->mtime.tv_nsec) {
+        table->stale = 1;
+    }
+}
+
+static void refresh(struct cred_table *table, int with_gid) {
+    if (watch_state == 0) {
+        watch_files(); // Before the first load, so no change can slip past
+    }
+
+    if (watch_state > 0) {
+        drain_events();
+    } else if (!table->stale) {
+        check_mtime(table);
+    }
+
+    if (table->stale) {
+        int ret = table_load(table, with_gid);
+        if (ret < 0) {
+            fprintf(stderr, "Cannot read %s: %s\n", table->path, strerror(-ret));
+        }
+    }
+}
+
+static int nss_lookup_user(const char *name, uint32_t *uid, uint32_t *gid) {
+    struct passwd pwd, *result = NULL;
+    char *buf = malloc(CRED_NSS_BUFFER);
+    if (!buf) {
+        return -ENOMEM;
+    }
+
+    int ret = getpwnam_r(name, &pwd, buf, CRED_NSS_BUFFER, &result);
+    if (ret == 0 && result) {
+        *uid = pwd.pw_uid;
+        *gid = pwd.pw_gid;
+    }
+    free(buf);
+
+    return ret ? -ret : (result ? 0 : -ENOENT);
+}
+
+static int nss_lookup_group(const char *name, uint32_t *gid) {
+    struct group grp, *result = NULL;
+    char *buf = malloc(CRED_NSS_BUFFER);
+    if (!buf) {
+        return -ENOMEM;
+    }
+
+    int ret = getgrnam_r(name, &grp, buf, CRED_NSS_BUFFER, &result);
+    if (ret == 0 && result) {
+        *gid = grp.gr_gid;
+    }
+    free(buf);
+
+    return ret ? -ret : (result ? 0 : -ENOENT);
+}
+
+int credentials_lookup_user(const char *name, uid_t *uid, gid_t *gid) {
+    if (!name || !*name) {
+        return -EINVAL;
+    }
+
+    pthread_mutex_lock(&cred_lock);
+    refresh(&users, 1);
+
+    uint32_t id = 0, primary = 0;
+    int ret = 0;
+    struct cred_entry *entry = table_find(&users, name, hash_name(name));
+    if (entry) {
+        id = entry->id;
+        primary = entry->gid;
+    } else {
+        // Not in the files database: ask NSS once and remember the answer
+        ret = nss_lookup_user(name, &id, &primary);
+        if (ret == 0) {
+            table_insert(&users, name, id, primary);
+        }
+    }
+    pthread_mutex_unlock(&cred_lock);
+
+    if (ret == 0) {
+        *uid = id;
+        if (gid) {
+            *gid = primary;
+        }
+    }
+    return ret;
+}
+
+int credentials_lookup_group(const char *name, gid_t *gid) {
+    if (!name || !*name) {
+        return -EINVAL;
+    }
+
+    pthread_mutex_lock(&cred_lock);
+    refresh(&groups, 0);
+
+    uint32_t id = 0;
+    int ret = 0;
+    struct cred_entry *entry = table_find(&groups, name, hash_name(name));
+    if (entry) {
+        id = entry->id;
+    } else {
+        ret = nss_lookup_group(name, &id);
+        if (ret == 0) {
+            table_insert(&groups, name, id, 0);
+        }
+    }
+    pthread_mutex_unlock(&cred_lock);
+
+    if (ret == 0) {
+        *gid = id;
+    }
+    return ret;
+}
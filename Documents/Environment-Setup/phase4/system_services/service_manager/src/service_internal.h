@@ -0,0 +1,40 @@
+#ifndef SERVICE_INTERNAL_H
+#define SERVICE_INTERNAL_H
+
+#include "../include/service_manager.h"
+
+/* Shared between the service manager sources - not part of the public API */
+
+int parse_service_line(const char *line, struct service_config *config);
+struct service *service_create(const struct service_config *config);
+
+struct service *find_service(const char *name);
+struct service *find_service_by_pid(pid_t pid);
+struct service *next_service(int *cursor);
+int service_total(void);
+int registry_add(struct service *svc);
+int registry_remove(struct service *svc);
+int registry_set_pid(struct service *svc, pid_t pid);
+
+int credentials_lookup_user(const char *name, uid_t *uid, gid_t *gid);
+int credentials_lookup_group(const char *name, gid_t *gid);
+
+int supervisor_watch_service(struct service *svc, int pidfd);
+int supervisor_arm_deadline(struct service *svc);
+int supervisor_arm_at(const struct timespec *deadline);
+
+int restart_schedule(struct service *svc);
+void restart_cancel(struct service *svc);
+int restart_next_deadline(struct timespec *deadline);
+void restart_expire(void);
+
+int service_cgroup_acquire(struct service *svc);
+void service_cgroup_release(struct service *svc);
+void service_cgroup_prepare(void);
+void service_cgroup_maintain(void);
+
+void scheduler_service_ready(struct service *svc);
+void scheduler_service_failed(struct service *svc);
+int scheduler_start_services(struct service **services, int count);
+
+#endif /* SERVICE_INTERNAL_H */
@@ -3,42 +3,28 @@
 #include <string.h>
 #include <unistd.h>
 #include <sys/wait.h>
-#include <pwd.h>
-#include <grp.h>
 #include <errno.h>
 #include <time.h>
-#include "../include/service_manager.h"
-
-static struct service services[MAX_SERVICES];
-static int service_count = 0;
-
-static struct service* find_service(const char *name) {
-    for (int i = 0; i < service_count; i++) {
-        if (strcmp(services[i].config.name, name) == 0) {
-            return &services[i];
-        }
-    }
-    return NULL;
-}
+#include <limits.h>
+#include "spawn_launcher.h"
+#include "service_internal.h"
 
 int validate_service_security(struct service *svc) {
     if (!svc) {
         return -EINVAL;
     }
     
-    // Validate user exists
-    struct passwd *pwd = getpwnam(svc->config.user);
-    if (!pwd) {
-        return -ENOENT;
+    // Validate user exists (cached, so restarts don't go through NSS)
+    int ret = credentials_lookup_user(svc->config.user, &svc->config.uid, NULL);
+    if (ret < 0) {
+        return ret;
     }
-    svc->config.uid = pwd->pw_uid;
     
     // Validate group exists
-    struct group *grp = getgrnam(svc->config.group);
-    if (!grp) {
-        return -ENOENT;
+    ret = credentials_lookup_group(svc->config.group, &svc->config.gid);
+    if (ret < 0) {
+        return ret;
     }
-    svc->config.gid = grp->gr_gid;
     
     // Security level validation
     if (svc->config.security_level < 1 || svc->config.security_level > 5) {
@@ -54,87 +40,262 @@ int start_service(const char *service_name) {
         return -ENOENT;
     }
     
-    if (svc->state == SERVICE_RUNNING) {
-        return 0; // Already running
+    if (svc->state == SERVICE_RUNNING || svc->state == SERVICE_STARTING) {
+        return 0; // Already running or waiting for readiness
+    }
+    
+    if (svc->state == SERVICE_STOPPING) {
+        return -EBUSY;
     }
     
+    restart_cancel(svc); // Started by hand before its automatic restart
+    
     int ret = validate_service_security(svc);
     if (ret < 0) {
         return ret;
     }
     
+    // Readiness notifications arrive through the supervisor's socket
+    if (svc->config.type == SERVICE_TYPE_NOTIFY) {
+        ret = supervisor_init();
+        if (ret < 0) {
+            return ret;
+        }
+    }
+    
     svc->state = SERVICE_STARTING;
     
-    pid_t pid = fork();
-    if (pid < 0) {
-        svc->state = SERVICE_FAILED;
-        return -errno;
-    }
+    // Drop privileges and execute service (directly unless it needs a shell)
+    struct spawn_request req;
+    memset(&req, 0, sizeof(req));
+    req.command = svc->config.command;
+    req.drop_privileges = 1;
+    req.uid = svc->config.uid;
+    req.gid = svc->config.gid;
     
-    if (pid == 0) {
-        // Drop privileges
-        if (setgid(svc->config.gid) < 0 || setuid(svc->config.uid) < 0) {
-            _exit(EXIT_FAILURE);
+    // Limits are enforced by starting the service inside a pool cgroup.
+    // Only a host without cgroup v2 (reported once) runs services unconfined;
+    // any other failure would silently drop the limits, so refuse to start.
+    if (svc->config.memory_limit || svc->config.cpu_limit) {
+        int cgroup_fd = service_cgroup_acquire(svc);
+        if (cgroup_fd >= 0) {
+            req.into_cgroup = 1;
+            req.cgroup_fd = cgroup_fd;
+        } else if (cgroup_fd != -EOPNOTSUPP) {
+            fprintf(stderr, "Service %s: cannot apply resource limits: %s\n",
+                    service_name, strerror(-cgroup_fd));
+            svc->state = SERVICE_FAILED;
+            return cgroup_fd;
         }
-        
-        // Execute service
-        execl("/bin/sh", "sh", "-c", svc->config.command, NULL);
-        _exit(EXIT_FAILURE);
     }
     
-    svc->pid = pid;
-    svc->state = SERVICE_RUNNING;
+    int pidfd = -1;
+    pid_t pid = spawn_process(&req, &pidfd);
+    if (pid < 0) {
+        service_cgroup_release(svc);
+        svc->state = SERVICE_FAILED;
+        return pid;
+    }
+    
+    registry_set_pid(svc, pid);
     svc->start_time = time(NULL);
+    svc->exit_status = 0;
+    
+    ret = supervisor_watch_service(svc, pidfd);
+    if (ret < 0) {
+        fprintf(stderr, "Service %s: cannot watch PID %d: %s\n",
+                service_name, pid, strerror(-ret));
+    }
     
     printf("Service %s started with PID %d\n", service_name, pid);
+    
+    if (svc->config.type == SERVICE_TYPE_NOTIFY) {
+        // Stay in STARTING until READY=1 or the readiness deadline
+        clock_gettime(CLOCK_MONOTONIC, &svc->deadline);
+        svc->deadline.tv_sec += SERVICE_START_TIMEOUT;
+        supervisor_arm_deadline(svc);
+    } else {
+        svc->state = SERVICE_RUNNING;
+        scheduler_service_ready(svc);
+    }
+    
     return 0;
 }
 
 int stop_service(const char *service_name) {
+    const char *names[1] = { service_name };
+    
+    // SIGTERM, then SIGKILL after stop_timeout; returns once the exit is reaped
+    return stop_services(names, 1);
+}
+
+int restart_service(const char *service_name) {
+    int ret = service_restart_async(service_name);
+    if (ret < 0) {
+        return ret;
+    }
+    
+    // A notify service stays STARTING until READY=1; the supervisor's
+    // readiness deadline bounds the wait
     struct service *svc = find_service(service_name);
-    if (!svc) {
-        return -ENOENT;
+    while (svc && (svc->restart_pending || svc->state == SERVICE_STARTING)) {
+        ret = supervisor_poll(-1);
+        if (ret < 0) {
+            return ret;
+        }
     }
     
-    if (svc->state != SERVICE_RUNNING) {
-        return 0; // Not running
+    return (svc && svc->state == SERVICE_RUNNING) ? 0 : -ECHILD;
+}
+
+static int parse_dependency_list(char *list, char names[][MAX_SERVICE_NAME], int *count) {
+    for (char *save = NULL, *name = strtok_r(list, ",", &save); name;
+         name = strtok_r(NULL, ",", &save)) {
+        if (*count >= MAX_SERVICE_DEPS || strlen(name) >= MAX_SERVICE_NAME) {
+            return -E2BIG;
+        }
+        strcpy(names[(*count)++], name);
     }
+    return 0;
+}
+
+/* Optional trailing key=value options: after=a,b requires=c type=notify */
+static int parse_service_options(struct service_config *config, char *options) {
+    for (char *save = NULL, *opt = strtok_r(options, " \t\r\n", &save); opt;
+         opt = strtok_r(NULL, " \t\r\n", &save)) {
+        int ret = 0;
+        
+        if (strncmp(opt, "after=", 6) == 0) {
+            ret = parse_dependency_list(opt + 6, config->after, &config->after_count);
+        } else if (strncmp(opt, "requires=", 9) == 0) {
+            ret = parse_dependency_list(opt + 9, config->requires, &config->requires_count);
+        } else if (strcmp(opt, "type=notify") == 0) {
+            config->type = SERVICE_TYPE_NOTIFY;
+        } else if (strcmp(opt, "type=simple") == 0) {
+            config->type = SERVICE_TYPE_SIMPLE;
+        } else {
+            ret = -EINVAL;
+        }
+        
+        if (ret < 0) {
+            fprintf(stderr, "Service %s: invalid option '%s'\n", config->name, opt);
+            return ret;
+        }
+    }
+    return 0;
+}
+
+static int is_service_option(const char *word) {
+    return strncmp(word, "after=", 6) == 0 || strncmp(word, "requires=", 9) == 0 ||
+           strncmp(word, "type=", 5) == 0;
+}
+
+static int parse_number(const char *word, int len, unsigned long *value) {
+    char buf[32];
+    char *end;
     
-    svc->state = SERVICE_STOPPING;
+    if (len <= 0 || len >= (int)sizeof(buf) || word[0] == '-') {
+        return -EINVAL;
+    }
+    memcpy(buf, word, len);
+    buf[len] = '\0';
     
-    if (kill(svc->pid, SIGTERM) < 0) {
-        return -errno;
+    errno = 0;
+    *value = strtoul(buf, &end, 10);
+    return (errno || *end) ? -EINVAL : 0;
+}
+
+static int copy_field(char *dst, size_t size, const char *src, int len) {
+    if (len <= 0 || (size_t)len >= size) {
+        return -E2BIG;
     }
+    memcpy(dst, src, len);
+    dst[len] = '\0';
+    return 0;
+}
+
+/* name command... user group security_level memory_limit cpu_limit [options]
+ *
+ * The command may contain spaces: the five fixed fields are taken from the
+ * end of the line, after any trailing option words, and everything between
+ * them and the name is the command line verbatim. Returns -ENODATA for
+ * blank and comment lines. */
+int parse_service_line(const char *line, struct service_config *config) {
+    const char *start[MAX_SERVICE_FIELDS];
+    int len[MAX_SERVICE_FIELDS];
+    int words = 0;
     
-    // Wait for graceful shutdown
-    sleep(5);
+    memset(config, 0, sizeof(*config));
     
-    int status;
-    if (waitpid(svc->pid, &status, WNOHANG) == 0) {
-        // Force kill if still running
-        kill(svc->pid, SIGKILL);
-        waitpid(svc->pid, &status, 0);
+    for (const char *p = line; *p;) {
+        p += strspn(p, " \t\r\n");
+        if (!*p) {
+            break;
+        }
+        if (words == MAX_SERVICE_FIELDS) {
+            return -E2BIG;
+        }
+        start[words] = p;
+        len[words] = strcspn(p, " \t\r\n");
+        p += len[words++];
     }
     
-    svc->state = SERVICE_STOPPED;
-    svc->pid = 0;
+    if (words == 0 || start[0][0] == '#') {
+        return -ENODATA;
+    }
     
-    printf("Service %s stopped\n", service_name);
+    int fixed = words;
+    while (fixed > 0 && is_service_option(start[fixed - 1])) {
+        fixed--;
+    }
+    if (fixed < 7) {
+        return -EINVAL;
+    }
+    
+    unsigned long security_level;
+    const char *command_end = start[fixed - 6] + len[fixed - 6];
+    if (copy_field(config->name, sizeof(config->name), start[0], len[0]) < 0 ||
+        copy_field(config->command, sizeof(config->command), start[1],
+                   command_end - start[1]) < 0 ||
+        copy_field(config->user, sizeof(config->user), start[fixed - 5], len[fixed - 5]) < 0 ||
+        copy_field(config->group, sizeof(config->group), start[fixed - 4], len[fixed - 4]) < 0 ||
+        parse_number(start[fixed - 3], len[fixed - 3], &security_level) < 0 ||
+        parse_number(start[fixed - 2], len[fixed - 2], &config->memory_limit) < 0 ||
+        parse_number(start[fixed - 1], len[fixed - 1], &config->cpu_limit) < 0 ||
+        security_level > INT_MAX) {
+        return -EINVAL;
+    }
+    config->security_level = (int)security_level;
+    config->auto_restart = 1;
+    
+    if (fixed < words) {
+        char options[4096];
+        if (copy_field(options, sizeof(options), start[fixed],
+                       start[words - 1] + len[words - 1] - start[fixed]) < 0) {
+            return -E2BIG;
+        }
+        return parse_service_options(config, options);
+    }
     return 0;
 }
 
-int restart_service(const char *service_name) {
-    int ret = stop_service(service_name);
-    if (ret < 0) {
-        return ret;
-    }
-    
-    struct service *svc = find_service(service_name);
-    if (svc) {
-        svc->restart_count++;
+/* Allocates an idle service for a parsed configuration */
+struct service *service_create(const struct service_config *config) {
+    struct service *svc = calloc(1, sizeof(*svc));
+    if (!svc) {
+        return NULL;
     }
     
-    return start_service(service_name);
+    svc->config = *config;
+    svc->state = SERVICE_STOPPED;
+    svc->pid = 0;
+    svc->pidfd = -1;
+    svc->stop_timeout = SERVICE_STOP_TIMEOUT;
+    svc->restart_pending = 0;
+    svc->restart_count = 0;
+    svc->sched_index = -1;
+    svc->cgroup_slot = -1;
+    return svc;
 }
 
 int load_service_config(const char *config_file) {
@@ -143,31 +304,79 @@ int load_service_config(const char *config_file) {
         return -errno;
     }
     
-    char line[512];
-    while (fgets(line, sizeof(line), file) && service_count < MAX_SERVICES) {
-        struct service *svc = &services[service_count];
+    char line[4096];
+    int line_no = 0;
+    while (fgets(line, sizeof(line), file)) {
+        struct service_config config;
         
-        if (sscanf(line, "%63s %511s %31s %31s %d %lu %lu",
-                   svc->config.name, svc->config.command,
-                   svc->config.user, svc->config.group,
-                   &svc->config.security_level,
-                   &svc->config.memory_limit,
-                   &svc->config.cpu_limit) == 7) {
-            
-            svc->config.auto_restart = 1;
-            svc->state = SERVICE_STOPPED;
-            svc->pid = 0;
-            svc->restart_count = 0;
-            service_count++;
+        line_no++;
+        int ret = parse_service_line(line, &config);
+        if (ret == -ENODATA) {
+            continue;
+        }
+        if (ret < 0) {
+            fprintf(stderr, "%s:%d: invalid service definition ignored\n",
+                    config_file, line_no);
+            continue;
+        }
+        
+        struct service *svc = service_create(&config);
+        if (!svc) {
+            fclose(file);
+            return -ENOMEM;
+        }
+        
+        ret = registry_add(svc);
+        if (ret < 0) {
+            fprintf(stderr, "Service %s: %s\n", svc->config.name,
+                    ret == -EEXIST ? "duplicate definition ignored" : strerror(-ret));
+            free(svc);
         }
     }
     
     fclose(file);
-    return service_count;
+    return service_total();
 }
 
 /* Test main function for compilation validation */
 int main(int argc, char *argv[]) {
+    if (argc == 4 && strcmp(argv[1], "--compile-config") == 0) {
+        int ret = compile_service_config(argv[2], argv[3]);
+        if (ret < 0) {
+            fprintf(stderr, "Cannot compile %s: %s\n", argv[2], strerror(-ret));
+            return 1;
+        }
+        printf("Compiled %d services into %s\n", ret, argv[3]);
+        return 0;
+    }
+    
+    // --start-all <config> [service...]: start the listed services first,
+    // then everything in dependency order, then stop it all again
+    if (argc >= 3 && strcmp(argv[1], "--start-all") == 0) {
+        int ret = load_service_config(argv[2]);
+        if (ret < 0) {
+            fprintf(stderr, "Cannot load %s: %s\n", argv[2], strerror(-ret));
+            return 1;
+        }
+        for (int i = 3; i < argc; i++) {
+            ret = start_service(argv[i]);
+            if (ret < 0) {
+                fprintf(stderr, "Cannot start %s: %s\n", argv[i], strerror(-ret));
+                return 1;
+            }
+        }
+        int failed = start_all_services();
+        stop_all_services();
+        supervisor_shutdown();
+        if (failed != 0) {
+            fprintf(stderr, "Startup failed: %s\n",
+                    failed < 0 ? strerror(-failed) : "some services did not start");
+            return 1;
+        }
+        printf("All services started in dependency order\n");
+        return 0;
+    }
+    
     printf("SecureOS Service Manager - Compilation Test Passed\n");
     return 0;
 }
@@ -0,0 +1,292 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include "service_internal.h"
+
+/* Service registry: services are allocated individually (so pointers held
+ * by the supervisor and scheduler stay valid), listed in a dense array for
+ * iteration, and indexed by two open-addressing hash tables - name and
+ * PID - with linear probing and backward-shift deletion. Both tables grow
+ * by doubling at 70% load, so there is no fixed service limit. */
+
+#define REGISTRY_MIN_SLOTS 64
+
+struct name_slot {
+    uint32_t hash;
+    struct service *svc;    // NULL marks an empty slot
+};
+
+struct pid_slot {
+    pid_t pid;              // 0 marks an empty slot
+    struct service *svc;
+};
+
+static struct service **service_list = NULL;
+static int service_count = 0;
+static int service_cap = 0;
+
+static struct name_slot *name_table = NULL;
+static size_t name_slots = 0;       // Always a power of two
+static size_t name_used = 0;
+
+static struct pid_slot *pid_table = NULL;
+static size_t pid_slots = 0;
+static size_t pid_used = 0;
+
+/* FNV-1a */
+static uint32_t hash_name(const char *name) {
+    uint32_t hash = 2166136261u;
+    while (*name) {
+        hash ^= (unsigned char)*name++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static size_t hash_pid(pid_t pid) {
+    uint32_t x = (uint32_t)pid;
+    x ^= x >> 16;
+    x *= 0x7feb352dU;
+    x ^= x >> 15;
+    x *= 0x846ca68bU;
+    x ^= x >> 16;
+    return x;
+}
+
+static int name_table_grow(void) {
+    size_t slots = name_slots ? name_slots * 2 : REGISTRY_MIN_SLOTS;
+    struct name_slot *table = calloc(slots, sizeof(*table));
+    if (!table) {
+        return -ENOMEM;
+    }
+
+    for (size_t i = 0; i < name_slots; i++) {
+        if (!name_table[i].svc) {
+            continue;
+        }
+        size_t pos = name_table[i].hash & (slots - 1);
+        while (table[pos].svc) {
+            pos = (pos + 1) & (slots - 1);
+        }
+        table[pos] = name_table[i];
+    }
+
+    free(name_table);
+    name_table = table;
+    name_slots = slots;
+    return 0;
+}
+
+static int pid_table_grow(void) {
+    size_t slots = pid_slots ? pid_slots * 2 : REGISTRY_MIN_SLOTS;
+    struct pid_slot *table = calloc(slots, sizeof(*table));
+    if (!table) {
+        return -ENOMEM;
+    }
+
+    for (size_t i = 0; i < pid_slots; i++) {
+        if (!pid_table[i].pid) {
+            continue;
+        }
+        size_t pos = hash_pid(pid_table[i].pid) & (slots - 1);
+        while (table[pos].pid) {
+            pos = (pos + 1) & (slots - 1);
+        }
+        table[pos] = pid_table[i];
+    }
+
+    free(pid_table);
+    pid_table = table;
+    pid_slots = slots;
+    return 0;
+}
+
+static struct name_slot *name_lookup(const char *name, uint32_t hash) {
+    if (!name_slots) {
+        return NULL;
+    }
+
+    for (size_t pos = hash & (name_slots - 1);; pos = (pos + 1) & (name_slots - 1)) {
+        struct name_slot *slot = &name_table[pos];
+        if (!slot->svc) {
+            return NULL;
+        }
+        if (slot->hash == hash && strcmp(slot->svc->config.name, name) == 0) {
+            return slot;
+        }
+    }
+}
+
+static struct pid_slot *pid_lookup(pid_t pid) {
+    if (!pid_slots || pid <= 0) {
+        return NULL;
+    }
+
+    for (size_t pos = hash_pid(pid) & (pid_slots - 1);; pos = (pos + 1) & (pid_slots - 1)) {
+        struct pid_slot *slot = &pid_table[pos];
+        if (!slot->pid) {
+            return NULL;
+        }
+        if (slot->pid == pid) {
+            return slot;
+        }
+    }
+}
+
+/* Backward-shift deletion keeps probe sequences intact without tombstones */
+static void name_table_delete(struct name_slot *slot) {
+    size_t hole = slot - name_table;
+    size_t mask = name_slots - 1;
+
+    for (size_t pos = (hole + 1) & mask; name_table[pos].svc; pos = (pos + 1) & mask) {
+        size_t home = name_table[pos].hash & mask;
+        // Move the entry back if the hole lies on its probe path
+        if (((pos - home) & mask) >= ((pos - hole) & mask)) {
+            name_table[hole] = name_table[pos];
+            hole = pos;
+        }
+    }
+
+    name_table[hole].svc = NULL;
+    name_table[hole].hash = 0;
+    name_used--;
+}
+
+static void pid_table_delete(struct pid_slot *slot) {
+    size_t hole = slot - pid_table;
+    size_t mask = pid_slots - 1;
+
+    for (size_t pos = (hole + 1) & mask; pid_table[pos].pid; pos = (pos + 1) & mask) {
+        size_t home = hash_pid(pid_table[pos].pid) & mask;
+        if (((pos - home) & mask) >= ((pos - hole) & mask)) {
+            pid_table[hole] = pid_table[pos];
+            hole = pos;
+        }
+    }
+
+    pid_table[hole].pid = 0;
+    pid_table[hole].svc = NULL;
+    pid_used--;
+}
+
+struct service* find_service(const char *name) {
+    if (!name) {
+        return NULL;
+    }
+
+    struct name_slot *slot = name_lookup(name, hash_name(name));
+    return slot ? slot->svc : NULL;
+}
+
+struct service* find_service_by_pid(pid_t pid) {
+    struct pid_slot *slot = pid_lookup(pid);
+    return slot ? slot->svc : NULL;
+}
+
+struct service* next_service(int *cursor) {
+    if (*cursor < 0 || *cursor >= service_count) {
+        return NULL;
+    }
+    return service_list[(*cursor)++];
+}
+
+int service_total(void) {
+    return service_count;
+}
+
+/* Takes ownership of a heap-allocated service; -EEXIST on a duplicate name */
+int registry_add(struct service *svc) {
+    if (!svc || !svc->config.name[0]) {
+        return -EINVAL;
+    }
+
+    uint32_t hash = hash_name(svc->config.name);
+    if (name_lookup(svc->config.name, hash)) {
+        return -EEXIST;
+    }
+
+    if ((name_used + 1) * 10 > name_slots * 7 && name_table_grow() < 0) {
+        return -ENOMEM;
+    }
+
+    if (service_count == service_cap) {
+        int cap = service_cap ? service_cap * 2 : REGISTRY_MIN_SLOTS;
+        struct service **list = realloc(service_list, cap * sizeof(*list));
+        if (!list) {
+            return -ENOMEM;
+        }
+        service_list = list;
+        service_cap = cap;
+    }
+
+    size_t pos = hash & (name_slots - 1);
+    while (name_table[pos].svc) {
+        pos = (pos + 1) & (name_slots - 1);
+    }
+    name_table[pos].hash = hash;
+    name_table[pos].svc = svc;
+    name_used++;
+
+    svc->registry_index = service_count;
+    service_list[service_count++] = svc;
+
+    if (svc->pid > 0) {
+        pid_t pid = svc->pid;
+        svc->pid = 0;
+        registry_set_pid(svc, pid);
+    }
+    return 0;
+}
+
+/* Unlinks the service from every index; the caller frees it */
+int registry_remove(struct service *svc) {
+    if (!svc) {
+        return -EINVAL;
+    }
+
+    struct name_slot *slot = name_lookup(svc->config.name, hash_name(svc->config.name));
+    if (!slot || slot->svc != svc) {
+        return -ENOENT;
+    }
+
+    registry_set_pid(svc, 0);
+    name_table_delete(slot);
+
+    // Swap-remove from the dense list
+    int index = svc->registry_index;
+    service_list[index] = service_list[--service_count];
+    service_list[index]->registry_index = index;
+    svc->registry_index = -1;
+    return 0;
+}
+
+/* All writes to svc->pid go through here to keep the reverse index exact */
+int registry_set_pid(struct service *svc, pid_t pid) {
+    if (svc->pid > 0) {
+        struct pid_slot *slot = pid_lookup(svc->pid);
+        if (slot && slot->svc == svc) {
+            pid_table_delete(slot);
+        }
+    }
+
+    svc->pid = pid;
+    if (pid <= 0) {
+        return 0;
+    }
+
+    if ((pid_used + 1) * 10 > pid_slots * 7 && pid_table_grow() < 0) {
+        return -ENOMEM;
+    }
+
+    size_t pos = hash_pid(pid) & (pid_slots - 1);
+    while (pid_table[pos].pid) {
+        pos = (pos + 1) & (pid_slots - 1);
+    }
+    pid_table[pos].pid = pid;
+    pid_table[pos].svc = svc;
+    pid_used++;
+    return 0;
+}
@@ -0,0 +1,214 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include "service_internal.h"
+
+/* Automatic restarts for services that fail. The delay doubles with each
+ * consecutive failure up to SERVICE_RESTART_MAX_DELAY_MS, with "equal
+ * jitter" (a random point in the upper half) so services that died
+ * together do not restart in lockstep, and more than SERVICE_RESTART_BURST
+ * restarts inside SERVICE_RESTART_WINDOW seconds gives up. Pending restarts
+ * sit in a hashed timer wheel: scheduling and cancelling are O(1) list
+ * operations and each tick only visits one bucket, however many services
+ * are waiting. The supervisor's timerfd drives the wheel. */
+
+#define RESTART_TICK_MS 10
+#define RESTART_WHEEL_SLOTS 512     // Power of two; one lap is ~5s
+
+static struct service *wheel[RESTART_WHEEL_SLOTS];
+static uint64_t current_tick = 0;   // Last tick processed
+static int wheel_count = 0;
+static struct timespec wheel_base;  // Monotonic time of tick 0
+static uint64_t jitter_state = 0;
+
+static uint64_t now_tick(void) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (wheel_base.tv_sec == 0 && wheel_base.tv_nsec == 0) {
+        wheel_base = now;
+    }
+
+    int64_t ms = (int64_t)(now.tv_sec - wheel_base.tv_sec) * 1000 +
+                 (now.tv_nsec - wheel_base.tv_nsec) / 1000000;
+    return ms > 0 ? (uint64_t)ms / RESTART_TICK_MS : 0;
+}
+
+/* xorshift64*, seeded lazily - quality only matters for spreading load */
+static uint64_t next_random(void) {
+    if (jitter_state == 0) {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        jitter_state = ((uint64_t)ts.tv_nsec << 20) ^ (uint64_t)ts.tv_sec ^ (uint64_t)getpid();
+        jitter_state |= 1;
+    }
+    jitter_state ^= jitter_state >> 12;
+    jitter_state ^= jitter_state << 25;
+    jitter_state ^= jitter_state >> 27;
+    return jitter_state * 2685821657736338717ULL;
+}
+
+static void wheel_insert(struct service *svc, uint64_t tick) {
+    struct service **bucket = &wheel[tick & (RESTART_WHEEL_SLOTS - 1)];
+
+    svc->restart_tick = tick;
+    svc->restart_prev = NULL;
+    svc->restart_next = *bucket;
+    if (*bucket) {
+        (*bucket)->restart_prev = svc;
+    }
+    *bucket = svc;
+    wheel_count++;
+}
+
+static void wheel_remove(struct service *svc) {
+    if (svc->restart_prev) {
+        svc->restart_prev->restart_next = svc->restart_next;
+    } else {
+        wheel[svc->restart_tick & (RESTART_WHEEL_SLOTS - 1)] = svc->restart_next;
+    }
+    if (svc->restart_next) {
+        svc->restart_next->restart_prev = svc->restart_prev;
+    }
+
+    svc->restart_next = svc->restart_prev = NULL;
+    svc->restart_tick = 0;
+    wheel_count--;
+}
+
+static long backoff_delay_ms(int attempts) {
+    long delay = SERVICE_RESTART_DELAY_MS;
+
+    for (int i = 1; i < attempts && delay < SERVICE_RESTART_MAX_DELAY_MS; i++) {
+        delay *= 2;
+    }
+    if (delay > SERVICE_RESTART_MAX_DELAY_MS) {
+        delay = SERVICE_RESTART_MAX_DELAY_MS;
+    }
+
+    return delay / 2 + (long)(next_random() % (uint64_t)(delay / 2 + 1));
+}
+
+/* Called when a service has failed; returns 1 if a restart was scheduled */
+int restart_schedule(struct service *svc) {
+    struct timespec now;
+
+    if (!svc->config.auto_restart || svc->restart_tick) {
+        return 0;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    // A run that outlived the window was healthy: start the backoff over
+    if (svc->start_time && time(NULL) - svc->start_time >= SERVICE_RESTART_WINDOW) {
+        svc->restart_attempts = 0;
+    }
+
+    if (svc->restart_burst == 0 || now.tv_sec - svc->restart_window >= SERVICE_RESTART_WINDOW) {
+        svc->restart_window = now.tv_sec;
+        svc->restart_burst = 0;
+    }
+
+    if (++svc->restart_burst > SERVICE_RESTART_BURST) {
+        printf("Service %s restarted too often (%d in %ds), giving up\n",
+               svc->config.name, SERVICE_RESTART_BURST, SERVICE_RESTART_WINDOW);
+        svc->restart_attempts = 0;
+        svc->restart_burst = 0;
+        return 0;
+    }
+
+    long delay = backoff_delay_ms(++svc->restart_attempts);
+    uint64_t tick = now_tick();
+    if (wheel_count == 0) {
+        current_tick = tick; // Idle wheel: nothing between here and now to sweep
+    }
+    wheel_insert(svc, tick + (delay + RESTART_TICK_MS - 1) / RESTART_TICK_MS + 1);
+
+    printf("Service %s will restart in %ldms (attempt %d)\n",
+           svc->config.name, delay, svc->restart_attempts);
+
+    struct timespec due;
+    restart_next_deadline(&due);
+    supervisor_arm_at(&due);
+    return 1;
+}
+
+void restart_cancel(struct service *svc) {
+    if (svc && svc->restart_tick) {
+        wheel_remove(svc);
+    }
+}
+
+/* Earliest tick with a non-empty bucket; entries further laps out only
+ * cause a harmless early wakeup. Returns 0 when nothing is pending. */
+int restart_next_deadline(struct timespec *deadline) {
+    if (wheel_count == 0) {
+        return 0;
+    }
+
+    uint64_t tick = current_tick + 1;
+    for (int i = 0; i < RESTART_WHEEL_SLOTS; i++, tick++) {
+        if (wheel[tick & (RESTART_WHEEL_SLOTS - 1)]) {
+            break;
+        }
+    }
+
+    uint64_t ms = tick * RESTART_TICK_MS;
+    *deadline = wheel_base;
+    deadline->tv_sec += ms / 1000;
+    deadline->tv_nsec += (ms % 1000) * 1000000;
+    if (deadline->tv_nsec >= 1000000000) {
+        deadline->tv_sec++;
+        deadline->tv_nsec -= 1000000000;
+    }
+    return 1;
+}
+
+/* Fires every restart that is due; called from the supervisor's timer */
+void restart_expire(void) {
+    struct service *due = NULL;
+    uint64_t now = now_tick();
+    int swept = 0;
+
+    // Collect first: start_service() may schedule into the wheel again
+    while (wheel_count > 0 && current_tick < now && swept < RESTART_WHEEL_SLOTS) {
+        current_tick++;
+        swept++;
+
+        struct service *svc = wheel[current_tick & (RESTART_WHEEL_SLOTS - 1)];
+        while (svc) {
+            struct service *next = svc->restart_next;
+            if (svc->restart_tick <= now) {
+                wheel_remove(svc);
+                svc->restart_next = due;
+                due = svc;
+            }
+            svc = next;
+        }
+    }
+    if (current_tick < now) {
+        current_tick = now; // Every bucket was visited; nothing due is left
+    }
+
+    while (due) {
+        struct service *svc = due;
+        due = svc->restart_next;
+        svc->restart_next = NULL;
+
+        if (svc->state != SERVICE_FAILED) {
+            continue; // Started or stopped by hand in the meantime
+        }
+
+        svc->restart_count++;
+        int ret = start_service(svc->config.name);
+        if (ret < 0) {
+            printf("Service %s failed to restart: %s\n", svc->config.name, strerror(-ret));
+            restart_schedule(svc);
+        }
+    }
+}
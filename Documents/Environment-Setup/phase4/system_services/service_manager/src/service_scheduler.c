@@ -0,0 +1,397 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "service_internal.h"
+
+/* Dependency-ordered parallel startup. after= and requires= edges form a
+ * DAG; every service whose dependencies have all settled is launched at
+ * once, so independent chains come up in parallel and each dependent
+ * starts the moment its last dependency reports ready rather than at the
+ * end of a global wave. A failed requires= dependency fails its
+ * dependents; a failed after= dependency only releases the ordering.
+ *
+ * The graph always spans every service, but a run may launch only some of
+ * them (services added by a reload). The others are never started here:
+ * a running one counts as ready, one that is starting or restarting
+ * settles when it reports, and any other as failed. */
+
+struct sched_edge {
+    int node;       // Dependent waiting on this service
+    int required;   // requires= (1) or after= (0)
+};
+
+struct sched_node {
+    struct service *svc;
+    int pending;        // Dependencies that have not settled yet
+    int dep_failed;     // A requires= dependency failed or is missing
+    int settled;        // 0 pending, 1 ready, -1 failed
+    int stopping;       // Launch deferred until the old instance has exited
+    int queued;         // In launch_queue; a node is never in it twice
+    int launch;         // Started by this run; other nodes only order it
+    struct sched_edge *dependents;
+    int dependent_count;
+    int dependent_cap;
+};
+
+static struct sched_node *nodes = NULL;
+static int node_count = 0;
+static int launch_count = 0;   // Nodes this run starts...
+static int settled_count = 0;  // ...how many of them have settled...
+static int failed_count = 0;   // ...and failed
+static int *launch_queue = NULL;   // Ring of node_count entries
+static int queue_head = 0;
+static int queue_tail = 0;
+
+static void settle(int index, int ready);
+
+static int add_edge(struct sched_node *dep, int dependent, int required) {
+    if (dep->dependent_count == dep->dependent_cap) {
+        int cap = dep->dependent_cap ? dep->dependent_cap * 2 : 4;
+        struct sched_edge *edges = realloc(dep->dependents, cap * sizeof(*edges));
+        if (!edges) {
+            return -ENOMEM;
+        }
+        dep->dependents = edges;
+        dep->dependent_cap = cap;
+    }
+
+    dep->dependents[dep->dependent_count].node = dependent;
+    dep->dependents[dep->dependent_count].required = required;
+    dep->dependent_count++;
+    return 0;
+}
+
+static int add_dependencies(int index, char names[][MAX_SERVICE_NAME], int count, int required) {
+    struct sched_node *node = &nodes[index];
+
+    for (int i = 0; i < count; i++) {
+        struct service *dep = find_service(names[i]);
+        if (!dep) {
+            if (required) {
+                printf("Service %s requires unknown service %s\n",
+                       node->svc->config.name, names[i]);
+                node->dep_failed = 1;
+            }
+            continue; // Ordering against a service we don't manage is a no-op
+        }
+
+        int ret = add_edge(&nodes[dep->sched_index], index, required);
+        if (ret < 0) {
+            return ret;
+        }
+        node->pending++;
+    }
+
+    return 0;
+}
+
+static void release_graph(void) {
+    for (int i = 0; i < node_count; i++) {
+        nodes[i].svc->sched_index = -1;
+        free(nodes[i].dependents);
+    }
+
+    free(nodes);
+    free(launch_queue);
+    nodes = NULL;
+    launch_queue = NULL;
+    node_count = launch_count = settled_count = failed_count = 0;
+    queue_head = queue_tail = 0;
+}
+
+static int build_graph(void) {
+    struct service *svc;
+    int cursor = 0;
+    int count = 0;
+
+    while (next_service(&cursor) != NULL) {
+        count++;
+    }
+
+    nodes = calloc(count ? count : 1, sizeof(*nodes));
+    launch_queue = calloc(count ? count : 1, sizeof(*launch_queue));
+    if (!nodes || !launch_queue) {
+        free(nodes);
+        free(launch_queue);
+        nodes = NULL;
+        launch_queue = NULL;
+        return -ENOMEM;
+    }
+
+    cursor = 0;
+    while ((svc = next_service(&cursor)) != NULL && node_count < count) {
+        nodes[node_count].svc = svc;
+        svc->sched_index = node_count++;
+    }
+
+    for (int i = 0; i < node_count; i++) {
+        struct service_config *config = &nodes[i].svc->config;
+        int ret = add_dependencies(i, config->requires, config->requires_count, 1);
+        if (ret == 0) {
+            ret = add_dependencies(i, config->after, config->after_count, 0);
+        }
+        if (ret < 0) {
+            return ret;
+        }
+    }
+
+    return 0;
+}
+
+/* Kahn's algorithm over a copy of the in-degrees - any node left over
+ * is part of (or depends on) a cycle */
+static int check_cycles(void) {
+    int *pending = malloc((node_count ? node_count : 1) * sizeof(*pending));
+    int *order = malloc((node_count ? node_count : 1) * sizeof(*order));
+    int head = 0, tail = 0;
+
+    if (!pending || !order) {
+        free(pending);
+        free(order);
+        return -ENOMEM;
+    }
+
+    for (int i = 0; i < node_count; i++) {
+        pending[i] = nodes[i].pending;
+        if (pending[i] == 0) {
+            order[tail++] = i;
+        }
+    }
+
+    while (head < tail) {
+        struct sched_node *node = &nodes[order[head++]];
+        for (int e = 0; e < node->dependent_count; e++) {
+            if (--pending[node->dependents[e].node] == 0) {
+                order[tail++] = node->dependents[e].node;
+            }
+        }
+    }
+
+    int ret = 0;
+    if (tail < node_count) {
+        for (int i = 0; i < node_count; i++) {
+            if (pending[i] > 0) {
+                printf("Service %s is part of a dependency cycle\n",
+                       nodes[i].svc->config.name);
+            }
+        }
+        ret = -ELOOP;
+    }
+
+    free(pending);
+    free(order);
+    return ret;
+}
+
+/* Every push goes through here: with each node queued at most once the
+ * ring of node_count entries cannot overflow, however often a node is
+ * released (settled dependencies, a stopping instance that exited) */
+static void push_launch(int index) {
+    if (nodes[index].queued) {
+        return;
+    }
+    nodes[index].queued = 1;
+    launch_queue[queue_tail++ % node_count] = index;
+}
+
+static void enqueue(int index) {
+    struct sched_node *node = &nodes[index];
+
+    if (!node->launch) {
+        return; // Settles from its own state, see start_nodes()
+    }
+
+    if (node->dep_failed) {
+        node->svc->state = SERVICE_FAILED;
+        printf("Service %s not started: a required dependency failed\n",
+               node->svc->config.name);
+        settle(index, 0);
+        return;
+    }
+
+    // start_service() refuses a service that is still stopping; launch it
+    // from scheduler_service_failed() once its exit has been reaped
+    if (node->svc->state == SERVICE_STOPPING) {
+        node->stopping = 1;
+        return;
+    }
+
+    push_launch(index);
+}
+
+static void settle(int index, int ready) {
+    struct sched_node *node = &nodes[index];
+
+    if (node->settled) {
+        return;
+    }
+
+    node->settled = ready ? 1 : -1;
+    if (node->launch) {
+        settled_count++;
+        failed_count += !ready;
+    }
+
+    for (int e = 0; e < node->dependent_count; e++) {
+        struct sched_node *dependent = &nodes[node->dependents[e].node];
+        if (!ready && node->dependents[e].required) {
+            dependent->dep_failed = 1;
+        }
+        if (--dependent->pending == 0) {
+            enqueue(node->dependents[e].node);
+        }
+    }
+}
+
+static int scheduled(struct service *svc) {
+    return nodes && svc->sched_index >= 0 && svc->sched_index < node_count &&
+           nodes[svc->sched_index].svc == svc;
+}
+
+void scheduler_service_ready(struct service *svc) {
+    if (svc && scheduled(svc)) {
+        settle(svc->sched_index, 1);
+    }
+}
+
+void scheduler_service_failed(struct service *svc) {
+    if (!svc || !scheduled(svc)) {
+        return;
+    }
+
+    struct sched_node *node = &nodes[svc->sched_index];
+    if (!node->launch && svc->restart_pending) {
+        return; // The instance it restarts with reports in turn
+    }
+    if (node->stopping) {
+        if (svc->state != SERVICE_STOPPING) {
+            node->stopping = 0;
+            push_launch(svc->sched_index); // Old instance is gone
+        }
+        return;
+    }
+
+    settle(svc->sched_index, 0);
+}
+
+static void launch_queued(void) {
+    while (queue_head < queue_tail) {
+        int index = launch_queue[queue_head++ % node_count];
+        struct service *svc = nodes[index].svc;
+
+        nodes[index].queued = 0;
+        int ret = start_service(svc->config.name);
+        if (ret == -EBUSY) {
+            nodes[index].stopping = 1; // Still stopping, retry on exit
+        } else if (ret < 0) {
+            printf("Service %s failed to start: %s\n", svc->config.name, strerror(-ret));
+            svc->state = SERVICE_FAILED;
+            scheduler_service_failed(svc);
+        } else if (svc->state == SERVICE_RUNNING) {
+            scheduler_service_ready(svc); // Was already running
+        }
+    }
+}
+
+/* Starts the nodes marked launch and returns how many of them failed */
+static int start_nodes(void) {
+    int ret = 0;
+
+    // Create the cgroup pool now rather than one mkdir per launch
+    for (int i = 0; i < node_count; i++) {
+        if (nodes[i].launch &&
+            (nodes[i].svc->config.memory_limit || nodes[i].svc->config.cpu_limit)) {
+            service_cgroup_prepare();
+            break;
+        }
+    }
+
+    // Running services satisfy their dependents straight away; others
+    // outside this run only settle by themselves, or have failed already
+    for (int i = 0; i < node_count; i++) {
+        enum service_state state = nodes[i].svc->state;
+        if (state == SERVICE_RUNNING) {
+            settle(i, 1);
+        } else if (!nodes[i].launch && state != SERVICE_STARTING && state != SERVICE_STOPPING) {
+            settle(i, 0);
+        }
+    }
+
+    for (int i = 0; i < node_count; i++) {
+        if (!nodes[i].settled && nodes[i].pending == 0 &&
+            nodes[i].svc->state != SERVICE_STARTING) {
+            enqueue(i);
+        }
+    }
+
+    // Done once this run's nodes have settled, whatever the others do
+    while (settled_count < launch_count) {
+        launch_queued();
+        if (settled_count >= launch_count) {
+            break;
+        }
+
+        ret = supervisor_poll(-1);
+        if (ret < 0) {
+            break;
+        }
+    }
+
+    return ret < 0 ? ret : failed_count;
+}
+
+static int prepare_graph(void) {
+    if (nodes) {
+        return -EBUSY; // Re-entered from a service event
+    }
+
+    int ret = supervisor_init();
+    if (ret < 0) {
+        return ret;
+    }
+
+    ret = build_graph();
+    if (ret == 0) {
+        ret = check_cycles();
+    }
+    if (ret < 0) {
+        release_graph();
+    }
+    return ret;
+}
+
+int start_all_services(void) {
+    int ret = prepare_graph();
+    if (ret < 0) {
+        return ret;
+    }
+
+    for (int i = 0; i < node_count; i++) {
+        nodes[i].launch = 1;
+    }
+    launch_count = node_count;
+
+    ret = start_nodes();
+    release_graph();
+    return ret;
+}
+
+int scheduler_start_services(struct service **services, int count) {
+    int ret = prepare_graph();
+    if (ret < 0) {
+        return ret;
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (scheduled(services[i]) && !nodes[services[i]->sched_index].launch) {
+            nodes[services[i]->sched_index].launch = 1;
+            launch_count++;
+        }
+    }
+
+    ret = start_nodes();
+    release_graph();
+    return ret;
+}
@@ -0,0 +1,629 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#include <time.h>
+#include <stddef.h>
+#include <sys/wait.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <sys/syscall.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "service_internal.h"
+
+/* Event-driven supervisor: every child is watched through a pidfd (or the
+ * SIGCHLD signalfd on kernels without pidfd_open), and a single timerfd
+ * fires at the earliest readiness or SIGTERM->SIGKILL deadline. Stops are
+ * requested without blocking, so shutting down many services costs the
+ * slowest one. Notify-type services report READY=1 over a datagram socket
+ * advertised in NOTIFY_SOCKET, the same protocol as sd_notify(3). */
+
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open 434
+#endif
+#ifndef SYS_pidfd_send_signal
+#define SYS_pidfd_send_signal 424
+#endif
+
+#define SUPERVISOR_MAX_EVENTS 64
+#define NOTIFY_MSG_MAX 4096
+
+static int epoll_fd = -1;
+static int signal_fd = -1;
+static int timer_fd = -1;
+static int notify_fd = -1;
+static sigset_t saved_mask;
+static struct timespec armed_deadline;
+
+/* Sentinels distinguishing non-service fds in epoll_event.data.ptr */
+static int signal_tag;
+static int timer_tag;
+static int notify_tag;
+
+static int pidfd_open(pid_t pid, unsigned int flags) {
+    return syscall(SYS_pidfd_open, pid, flags);
+}
+
+static int pidfd_send_signal(int pidfd, int sig, siginfo_t *info, unsigned int flags) {
+    return syscall(SYS_pidfd_send_signal, pidfd, sig, info, flags);
+}
+
+static int timespec_before(const struct timespec *a, const struct timespec *b) {
+    return a->tv_sec < b->tv_sec || (a->tv_sec == b->tv_sec && a->tv_nsec < b->tv_nsec);
+}
+
+static int timespec_unset(const struct timespec *ts) {
+    return ts->tv_sec == 0 && ts->tv_nsec == 0;
+}
+
+static int signal_service(struct service *svc, int sig) {
+    if (svc->pidfd >= 0) {
+        if (pidfd_send_signal(svc->pidfd, sig, NULL, 0) == 0) {
+            return 0;
+        }
+        if (errno != ENOSYS) {
+            return -errno;
+        }
+    }
+
+    if (kill(svc->pid, sig) < 0) {
+        return -errno;
+    }
+    return 0;
+}
+
+static int arm_timer(const struct timespec *deadline) {
+    struct itimerspec its;
+    memset(&its, 0, sizeof(its));
+    its.it_value = *deadline;
+
+    if (timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &its, NULL) < 0) {
+        return -errno;
+    }
+    armed_deadline = *deadline;
+    return 0;
+}
+
+static int has_deadline(const struct service *svc) {
+    return (svc->state == SERVICE_STARTING || svc->state == SERVICE_STOPPING) &&
+           !timespec_unset(&svc->deadline);
+}
+
+/* Only touches the timerfd if the deadline is the new earliest one */
+int supervisor_arm_at(const struct timespec *deadline) {
+    if (timer_fd < 0 || timespec_unset(deadline)) {
+        return 0;
+    }
+
+    if (timespec_unset(&armed_deadline) || timespec_before(deadline, &armed_deadline)) {
+        return arm_timer(deadline);
+    }
+    return 0;
+}
+
+int supervisor_arm_deadline(struct service *svc) {
+    if (!has_deadline(svc)) {
+        return 0;
+    }
+    return supervisor_arm_at(&svc->deadline);
+}
+
+/* Recompute the earliest outstanding deadline after the timer fired */
+static void rearm_timer(void) {
+    struct timespec earliest = {0, 0};
+    struct service *svc;
+    int cursor = 0;
+
+    restart_next_deadline(&earliest);
+
+    while ((svc = next_service(&cursor)) != NULL) {
+        if (!has_deadline(svc)) {
+            continue;
+        }
+        if (timespec_unset(&earliest) || timespec_before(&svc->deadline, &earliest)) {
+            earliest = svc->deadline;
+        }
+    }
+
+    arm_timer(&earliest);
+}
+
+/* close() alone only drops the epoll registration once every reference
+ * to the file is gone, and a child spawned meanwhile may still pin it */
+static void unwatch_service(struct service *svc) {
+    if (svc->pidfd >= 0) {
+        if (epoll_fd >= 0) {
+            epoll_ctl(epoll_fd, EPOLL_CTL_DEL, svc->pidfd, NULL);
+        }
+        close(svc->pidfd);
+        svc->pidfd = -1;
+    }
+}
+
+static void service_exited(struct service *svc, int status) {
+    unwatch_service(svc);
+
+    registry_set_pid(svc, 0);
+    service_cgroup_release(svc);
+    svc->exit_status = status;
+    memset(&svc->deadline, 0, sizeof(svc->deadline));
+
+    if (svc->state == SERVICE_STOPPING && svc->stop_failed) {
+        svc->state = SERVICE_FAILED;
+        printf("Service %s stopped after failing\n", svc->config.name);
+    } else if (svc->state == SERVICE_STOPPING) {
+        svc->state = SERVICE_STOPPED;
+        printf("Service %s stopped\n", svc->config.name);
+    } else if (svc->state == SERVICE_STARTING) {
+        svc->state = SERVICE_FAILED;
+        printf("Service %s exited before becoming ready (status %d)\n",
+               svc->config.name, status);
+    } else if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+        svc->state = SERVICE_STOPPED;
+        printf("Service %s exited\n", svc->config.name);
+    } else {
+        svc->state = SERVICE_FAILED;
+        printf("Service %s failed (status %d)\n", svc->config.name, status);
+    }
+
+    // No-op unless the dependency scheduler is still waiting on it
+    scheduler_service_failed(svc);
+
+    svc->stop_failed = 0;
+
+    if (svc->restart_pending) {
+        svc->restart_pending = 0;
+        svc->restart_count++;
+        if (start_service(svc->config.name) < 0) {
+            scheduler_service_failed(svc); // No instance left to report
+        }
+    } else if (svc->state == SERVICE_FAILED) {
+        restart_schedule(svc); // Backoff and rate limits apply
+    }
+}
+
+/* Returns 1 if the service was reaped, 0 if it is still running */
+static int reap_service(struct service *svc) {
+    int status = 0;
+
+    if (svc->pid <= 0) {
+        return 0;
+    }
+
+    pid_t ret = waitpid(svc->pid, &status, WNOHANG);
+    if (ret == 0) {
+        return 0;
+    }
+    if (ret < 0 && errno != ECHILD) {
+        return 0;
+    }
+
+    service_exited(svc, status);
+    return 1;
+}
+
+static void handle_sigchld(void) {
+    struct signalfd_siginfo info;
+    struct service *svc;
+    int cursor = 0;
+
+    while (read(signal_fd, &info, sizeof(info)) == sizeof(info)) {
+        // Drain - SIGCHLD coalesces, so the sweep below does the real work
+    }
+
+    // Services with a pidfd are reaped from their own epoll event
+    while ((svc = next_service(&cursor)) != NULL) {
+        if (svc->pid > 0 && svc->pidfd < 0) {
+            reap_service(svc);
+        }
+    }
+}
+
+static void handle_timer(void) {
+    uint64_t expirations;
+    struct timespec now;
+    struct service *svc;
+    int cursor = 0;
+
+    if (read(timer_fd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN) {
+        return;
+    }
+
+    memset(&armed_deadline, 0, sizeof(armed_deadline));
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    while ((svc = next_service(&cursor)) != NULL) {
+        if (!has_deadline(svc) || timespec_before(&now, &svc->deadline)) {
+            continue;
+        }
+
+        if (svc->state == SERVICE_STARTING) {
+            printf("Service %s did not report readiness in %ds\n",
+                   svc->config.name, SERVICE_START_TIMEOUT);
+            scheduler_service_failed(svc);
+            svc->stop_failed = 1;
+            service_stop_async(svc->config.name);
+            continue;
+        }
+
+        // Grace period over - force kill and wait for the exit event
+        memset(&svc->deadline, 0, sizeof(svc->deadline));
+        signal_service(svc, SIGKILL);
+        printf("Service %s did not stop in %ds, sent SIGKILL\n",
+               svc->config.name, svc->stop_timeout);
+    }
+
+    restart_expire();
+    rearm_timer();
+}
+
+static void handle_notify(void) {
+    char buf[NOTIFY_MSG_MAX + 1];
+    char control[CMSG_SPACE(sizeof(struct ucred))];
+
+    for (;;) {
+        struct iovec iov = { .iov_base = buf, .iov_len = NOTIFY_MSG_MAX };
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        ssize_t len = recvmsg(notify_fd, &msg, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+        if (len < 0) {
+            return;
+        }
+        buf[len] = '\0';
+
+        struct ucred *cred = NULL;
+        for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_CREDENTIALS) {
+                cred = (struct ucred *)CMSG_DATA(cmsg);
+            }
+        }
+        if (!cred) {
+            continue; // Cannot attribute the message to a service
+        }
+
+        struct service *svc = find_service_by_pid(cred->pid);
+        if (!svc || svc->state != SERVICE_STARTING) {
+            continue;
+        }
+
+        // Newline-separated KEY=VALUE assignments, as sent by sd_notify()
+        for (char *line = strtok(buf, "\n"); line; line = strtok(NULL, "\n")) {
+            if (strcmp(line, "READY=1") == 0) {
+                svc->state = SERVICE_RUNNING;
+                memset(&svc->deadline, 0, sizeof(svc->deadline));
+                printf("Service %s is ready\n", svc->config.name);
+                scheduler_service_ready(svc);
+                break;
+            }
+        }
+    }
+}
+
+static int open_notify_socket(void) {
+    struct sockaddr_un addr;
+    int one = 1;
+
+    notify_fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (notify_fd < 0) {
+        return -errno;
+    }
+
+    // Abstract namespace: nothing to clean up and no filesystem permissions
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    int name_len = snprintf(addr.sun_path + 1, sizeof(addr.sun_path) - 1,
+                            "secureos-notify-%d", (int)getpid());
+    socklen_t addr_len = offsetof(struct sockaddr_un, sun_path) + 1 + name_len;
+
+    if (bind(notify_fd, (struct sockaddr *)&addr, addr_len) < 0 ||
+        setsockopt(notify_fd, SOL_SOCKET, SO_PASSCRED, &one, sizeof(one)) < 0) {
+        return -errno;
+    }
+
+    // Children inherit the address; '@' marks an abstract socket
+    char env[sizeof(addr.sun_path) + 1];
+    snprintf(env, sizeof(env), "@%s", addr.sun_path + 1);
+    if (setenv(SERVICE_NOTIFY_ENV, env, 1) < 0) {
+        return -errno;
+    }
+
+    return 0;
+}
+
+/* Takes ownership of pidfd; pass -1 to have one opened for svc->pid */
+int supervisor_watch_service(struct service *svc, int pidfd) {
+    if (epoll_fd < 0 || !svc || svc->pid <= 0) {
+        if (pidfd >= 0) {
+            close(pidfd);
+        }
+        return 0;
+    }
+
+    if (pidfd < 0) {
+        pidfd = pidfd_open(svc->pid, 0);
+    }
+    if (pidfd < 0) {
+        // Pre-5.3 kernels: the SIGCHLD signalfd covers this service
+        return errno == ENOSYS ? 0 : -errno;
+    }
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = svc;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, pidfd, &ev) < 0) {
+        int err = -errno;
+        close(pidfd);
+        return err;
+    }
+
+    svc->pidfd = pidfd;
+    return 0;
+}
+
+static int add_internal_fd(int fd, void *tag) {
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = tag;
+    return epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0 ? -errno : 0;
+}
+
+int supervisor_init(void) {
+    if (epoll_fd >= 0) {
+        return 0;
+    }
+
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    if (sigprocmask(SIG_BLOCK, &mask, &saved_mask) < 0) {
+        return -errno;
+    }
+
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    signal_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (epoll_fd < 0 || signal_fd < 0 || timer_fd < 0) {
+        int err = -errno;
+        supervisor_shutdown();
+        return err;
+    }
+
+    int ret = open_notify_socket();
+    if (ret == 0) {
+        ret = add_internal_fd(signal_fd, &signal_tag);
+    }
+    if (ret == 0) {
+        ret = add_internal_fd(timer_fd, &timer_tag);
+    }
+    if (ret == 0) {
+        ret = add_internal_fd(notify_fd, &notify_tag);
+    }
+    if (ret < 0) {
+        supervisor_shutdown();
+        return ret;
+    }
+
+    // Adopt services that were started before the supervisor existed
+    struct service *svc;
+    int cursor = 0;
+    while ((svc = next_service(&cursor)) != NULL) {
+        if (svc->pid > 0 && svc->pidfd < 0) {
+            supervisor_watch_service(svc, -1);
+        }
+    }
+
+    return 0;
+}
+
+void supervisor_shutdown(void) {
+    struct service *svc;
+    int cursor = 0;
+
+    while ((svc = next_service(&cursor)) != NULL) {
+        unwatch_service(svc);
+    }
+
+    if (notify_fd >= 0) {
+        close(notify_fd);
+        notify_fd = -1;
+        unsetenv(SERVICE_NOTIFY_ENV);
+    }
+    if (timer_fd >= 0) {
+        close(timer_fd);
+        timer_fd = -1;
+    }
+    if (signal_fd >= 0) {
+        close(signal_fd);
+        signal_fd = -1;
+    }
+    if (epoll_fd >= 0) {
+        close(epoll_fd);
+        epoll_fd = -1;
+        sigprocmask(SIG_SETMASK, &saved_mask, NULL);
+    }
+    memset(&armed_deadline, 0, sizeof(armed_deadline));
+}
+
+int supervisor_poll(int timeout_ms) {
+    struct epoll_event events[SUPERVISOR_MAX_EVENTS];
+
+    int ret = supervisor_init();
+    if (ret < 0) {
+        return ret;
+    }
+
+    int n = epoll_wait(epoll_fd, events, SUPERVISOR_MAX_EVENTS, timeout_ms);
+    if (n < 0) {
+        return errno == EINTR ? 0 : -errno;
+    }
+
+    for (int i = 0; i < n; i++) {
+        void *tag = events[i].data.ptr;
+
+        if (tag == &signal_tag) {
+            handle_sigchld();
+        } else if (tag == &timer_tag) {
+            handle_timer();
+        } else if (tag == &notify_tag) {
+            handle_notify();
+        } else {
+            reap_service((struct service *)tag);
+        }
+    }
+
+    service_cgroup_maintain();
+    return n;
+}
+
+int service_stop_async(const char *service_name) {
+    struct service *svc = find_service(service_name);
+    if (!svc) {
+        return -ENOENT;
+    }
+
+    restart_cancel(svc); // An explicit stop overrides a pending auto-restart
+
+    if (svc->state != SERVICE_RUNNING && svc->state != SERVICE_STARTING) {
+        return 0; // Not running, or already stopping
+    }
+
+    int ret = supervisor_init();
+    if (ret < 0) {
+        return ret;
+    }
+
+    svc->state = SERVICE_STOPPING;
+
+    ret = signal_service(svc, SIGTERM);
+    if (ret < 0 && ret != -ESRCH) {
+        svc->state = SERVICE_RUNNING;
+        return ret;
+    }
+
+    if (svc->stop_timeout <= 0) {
+        svc->stop_timeout = SERVICE_STOP_TIMEOUT;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &svc->deadline);
+    svc->deadline.tv_sec += svc->stop_timeout;
+
+    ret = supervisor_arm_deadline(svc);
+    if (ret < 0) {
+        return ret;
+    }
+
+    // The process may already be gone (ESRCH) or not be pidfd-watched
+    reap_service(svc);
+    return 0;
+}
+
+int service_restart_async(const char *service_name) {
+    struct service *svc = find_service(service_name);
+    if (!svc) {
+        return -ENOENT;
+    }
+
+    if (svc->state == SERVICE_STOPPING) {
+        svc->restart_pending = 1;
+        return 0;
+    }
+
+    if (svc->state != SERVICE_RUNNING && svc->state != SERVICE_STARTING) {
+        svc->restart_count++;
+        return start_service(service_name);
+    }
+
+    svc->restart_pending = 1;
+    return service_stop_async(service_name);
+}
+
+static int wait_until_stopped(struct service **targets, int count) {
+    for (;;) {
+        int stopping = 0;
+        for (int i = 0; i < count; i++) {
+            if (targets[i] && targets[i]->state == SERVICE_STOPPING) {
+                stopping = 1;
+                break;
+            }
+        }
+        if (!stopping) {
+            return 0;
+        }
+
+        int ret = supervisor_poll(-1);
+        if (ret < 0) {
+            return ret;
+        }
+    }
+}
+
+int stop_services(const char *const *service_names, int count) {
+    if (!service_names || count < 0) {
+        return -EINVAL;
+    }
+
+    struct service **targets = calloc(count ? count : 1, sizeof(*targets));
+    if (!targets) {
+        return -ENOMEM;
+    }
+
+    int first_error = 0;
+    for (int i = 0; i < count; i++) {
+        int ret = service_stop_async(service_names[i]);
+        if (ret < 0 && first_error == 0) {
+            first_error = ret;
+        }
+        targets[i] = find_service(service_names[i]);
+    }
+
+    int ret = wait_until_stopped(targets, count);
+    free(targets);
+
+    return first_error < 0 ? first_error : ret;
+}
+
+int stop_all_services(void) {
+    struct service *svc;
+    int first_error = 0;
+    int cursor = 0;
+
+    while ((svc = next_service(&cursor)) != NULL) {
+        svc->restart_pending = 0;
+        int ret = service_stop_async(svc->config.name);
+        if (ret < 0 && first_error == 0) {
+            first_error = ret;
+        }
+    }
+
+    for (;;) {
+        int stopping = 0;
+        cursor = 0;
+        while ((svc = next_service(&cursor)) != NULL) {
+            if (svc->state == SERVICE_STOPPING) {
+                stopping = 1;
+                break;
+            }
+        }
+        if (!stopping) {
+            break;
+        }
+
+        int ret = supervisor_poll(-1);
+        if (ret < 0) {
+            return ret;
+        }
+    }
+
+    return first_error;
+}
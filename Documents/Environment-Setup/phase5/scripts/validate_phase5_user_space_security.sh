@@ -16,8 +16,10 @@ echo "Compiling application sandbox..."
 gcc -o "$PHASE5_DIR/user_space/app_sandbox/test_app_sandbox" \
     "$PHASE5_DIR/user_space/app_sandbox/src/app_sandbox.c" \
     "../../phase4/system_services/process_sandbox/src/capability_syscalls.c" \
+    "../../phase4/system_services/process_sandbox/src/spawn_launcher.c" \
     -I"$PHASE5_DIR/user_space/app_sandbox/include" \
-    -I"../../phase4/system_services/process_sandbox/src" || {
+    -I"../../phase4/system_services/process_sandbox/src" \
+    -I"../../phase4/system_services/process_sandbox/include" || {
     echo "ERROR: Application sandbox compilation failed"
     exit 1
 }
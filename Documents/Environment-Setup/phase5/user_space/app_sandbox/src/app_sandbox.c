@@ -14,17 +14,29 @@
 #include <linux/capability.h>
 #include <linux/seccomp.h>
 #include <sys/syscall.h>
+#include "spawn_launcher.h"
 #include "../include/app_sandbox.h"
 
 /* Use capability management from Phase 4 */
 extern int secureos_cap_drop_all_except(unsigned long required_caps);
 extern void audit_capability_operation(const char *operation, int result);
 
+/* Also called from the launcher child, which may share the parent's
+ * memory: format on the stack and write(2) instead of using stdio */
 static void audit_log_app_sandbox_event(const char *event, const char *app_name, int result) {
+    char msg[512];
+    int len;
+    
     if (result == 0) {
-        printf("AUDIT: App sandbox %s for %s succeeded\n", event, app_name);
+        len = snprintf(msg, sizeof(msg), "AUDIT: App sandbox %s for %s succeeded\n",
+                       event, app_name);
     } else {
-        printf("AUDIT: App sandbox %s for %s failed: %s\n", event, app_name, strerror(-result));
+        len = snprintf(msg, sizeof(msg), "AUDIT: App sandbox %s for %s failed: %s\n",
+                       event, app_name, strerrordesc_np(-result));
+    }
+    
+    if (len > 0) {
+        write(STDOUT_FILENO, msg, len < (int)sizeof(msg) ? (size_t)len : sizeof(msg) - 1);
     }
 }
 
@@ -126,6 +138,70 @@ static int apply_app_resource_limits(struct app_sandbox_policy *policy) {
     return 0;
 }
 
+/* Sandbox construction, run in the launcher child before exec */
+static int setup_app_sandbox_child(void *arg) {
+    struct app_sandbox_policy *policy = arg;
+    int ret;
+    
+    /* Create new namespaces */
+    int ns_flags = CLONE_NEWNS | CLONE_NEWPID | CLONE_NEWUTS | CLONE_NEWIPC;
+    if (!policy->network_access) {
+        ns_flags |= CLONE_NEWNET;
+    }
+    
+    ret = unshare(ns_flags);
+    if (ret < 0) {
+        ret = -errno;
+        audit_log_app_sandbox_event("namespace creation", policy->app_name, ret);
+        return ret;
+    }
+    
+    /* Setup filesystem */
+    ret = setup_app_filesystem(policy);
+    if (ret < 0) {
+        audit_log_app_sandbox_event("filesystem setup", policy->app_name, ret);
+        return ret;
+    }
+    
+    /* Apply seccomp filter */
+    ret = apply_app_seccomp(policy);
+    if (ret < 0) {
+        audit_log_app_sandbox_event("seccomp setup", policy->app_name, ret);
+        return ret;
+    }
+    
+    /* Drop capabilities */
+    ret = secureos_cap_drop_all_except(policy->allowed_capabilities);
+    if (ret < 0) {
+        audit_log_app_sandbox_event("capability drop", policy->app_name, ret);
+        return ret;
+    }
+    
+    /* Apply resource limits */
+    ret = apply_app_resource_limits(policy);
+    if (ret < 0) {
+        audit_log_app_sandbox_event("resource limits", policy->app_name, ret);
+        return ret;
+    }
+    
+    /* Change to sandbox user - raw syscalls, see spawn_launcher.c */
+    if (syscall(SYS_setgid, policy->sandbox_gid) < 0 ||
+        syscall(SYS_setuid, policy->sandbox_uid) < 0) {
+        ret = -errno;
+        audit_log_app_sandbox_event("user change", policy->app_name, ret);
+        return ret;
+    }
+    
+    /* Verify we can't regain privileges */
+    if (syscall(SYS_setuid, 0) == 0) {
+        audit_log_app_sandbox_event("privilege check", policy->app_name, -EPERM);
+        return -EPERM;
+    }
+    
+    audit_log_app_sandbox_event("creation", policy->app_name, 0);
+    return 0;
+}
+
 int create_app_sandbox(struct app_sandbox_policy *policy, const char *app_path, char **argv) {
     pid_t pid;
     int ret;
@@ -136,73 +212,15 @@ int create_app_sandbox(struct app_sandbox_policy *policy, const char *app_path,
         return ret;
     }
     
-    pid = fork();
-    if (pid < 0) {
-        return -errno;
-    }
-    
-    if (pid == 0) {
-        /* Child process - create sandbox */
-        
-        /* Create new namespaces */
-        int ns_flags = CLONE_NEWNS | CLONE_NEWPID | CLONE_NEWUTS | CLONE_NEWIPC;
-        if (!policy->network_access) {
-            ns_flags |= CLONE_NEWNET;
-        }
-        
-        ret = unshare(ns_flags);
-        if (ret < 0) {
-            audit_log_app_sandbox_event("namespace creation", policy->app_name, -errno);
-            _exit(EXIT_FAILURE);
-        }
-        
-        /* Setup filesystem */
-        ret = setup_app_filesystem(policy);
-        if (ret < 0) {
-            audit_log_app_sandbox_event("filesystem setup", policy->app_name, ret);
-            _exit(EXIT_FAILURE);
-        }
-        
-        /* Apply seccomp filter */
-        ret = apply_app_seccomp(policy);
-        if (ret < 0) {
-            audit_log_app_sandbox_event("seccomp setup", policy->app_name, ret);
-            _exit(EXIT_FAILURE);
-        }
-        
-        /* Drop capabilities */
-        ret = secureos_cap_drop_all_except(policy->allowed_capabilities);
-        if (ret < 0) {
-            audit_log_app_sandbox_event("capability drop", policy->app_name, ret);
-            _exit(EXIT_FAILURE);
-        }
-        
-        /* Apply resource limits */
-        ret = apply_app_resource_limits(policy);
-        if (ret < 0) {
-            audit_log_app_sandbox_event("resource limits", policy->app_name, ret);
-            _exit(EXIT_FAILURE);
-        }
-        
-        /* Change to sandbox user */
-        if (setgid(policy->sandbox_gid) < 0 || setuid(policy->sandbox_uid) < 0) {
-            audit_log_app_sandbox_event("user change", policy->app_name, -errno);
-            _exit(EXIT_FAILURE);
-        }
-        
-        /* Verify we can't regain privileges */
-        if (setuid(0) == 0) {
-            audit_log_app_sandbox_event("privilege check", policy->app_name, -EPERM);
-            _exit(EXIT_FAILURE);
-        }
-        
-        audit_log_app_sandbox_event("creation", policy->app_name, 0);
-        
-        /* Execute the application */
-        execv(app_path, argv);
-        _exit(EXIT_FAILURE);
-    }
+    /* Execute the application */
+    struct spawn_request req;
+    memset(&req, 0, sizeof(req));
+    req.path = app_path;
+    req.argv = argv;
+    req.setup = setup_app_sandbox_child;
+    req.setup_arg = policy;
     
+    pid = spawn_process(&req, NULL);
     return pid;
 }
 
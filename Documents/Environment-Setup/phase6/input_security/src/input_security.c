@@ -1,5 +1,6 @@
 #define _POSIX_C_SOURCE 199309L
 #include "input_security.h"
+#include "audit_sink.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -93,10 +94,11 @@ int check_input_rate_limit(struct input_security_context *ctx) {
     return 0;
 }
 
+/* On the input path: a flood of rejected events must not stall on /dev/log */
 void audit_log_input_violation(const char *message, struct input_security_context *ctx) {
-    syslog(LOG_WARNING | LOG_AUTH, 
-           "SecureOS Input Security Violation: %s (PID=%d, UID=%d, Level=%d)",
-           message, ctx->client_pid, ctx->client_uid, ctx->security_level);
+    audit_log(LOG_WARNING | LOG_AUTH, 
+              "SecureOS Input Security Violation: %s (PID=%d, UID=%d, Level=%d)",
+              message, ctx->client_pid, ctx->client_uid, ctx->security_level);
 }
 
 /* Main function for testing */
@@ -107,6 +109,9 @@ int main(int argc, char *argv[]) {
     
     printf("SecureOS Input Security Framework v1.0\n");
     
+    struct audit_sink_config audit = { .ident = "secureos-input", .facility = LOG_AUTH };
+    audit_sink_open(&audit);
+    
     /* Initialize test context */
     ctx.client_pid = getpid();
     ctx.client_uid = getuid();
@@ -140,6 +145,7 @@ int main(int argc, char *argv[]) {
         printf("Dangerous key filtering test: FAILED\n");
     }
     
+    audit_sink_close();
     printf("Input security framework tests completed\n");
     return 0;
 }
@@ -1,4 +1,5 @@
 #include "secure_compositor.h"
+#include "audit_sink.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -148,13 +149,14 @@ int apply_surface_mac_policy(struct secure_surface *surface, struct secure_clien
     return 0;
 }
 
+/* Called on every commit: queued for the audit writer, never blocks */
 void audit_log_compositor_violation(const char *message) {
-    syslog(LOG_WARNING | LOG_AUTH, "SecureOS Compositor Security Violation: %s", message);
+    audit_log(LOG_WARNING | LOG_AUTH, "SecureOS Compositor Security Violation: %s", message);
 }
 
 void audit_log_surface_commit(pid_t client_pid, struct secure_surface *surface) {
-    syslog(LOG_INFO, "Surface commit: PID=%d Security=%d", 
-           client_pid, surface->security_level);
+    audit_log(LOG_INFO, "Surface commit: PID=%d Security=%d", 
+              client_pid, surface->security_level);
 }
 
 /* Secure surface commit handler */
@@ -245,7 +247,11 @@ int secure_compositor_init(void) {
     }
     
     openlog("secureos-compositor", LOG_PID | LOG_CONS, LOG_AUTH);
-    syslog(LOG_INFO, "Secure GUI compositor initialized");
+    struct audit_sink_config audit = { .ident = "secureos-compositor", .facility = LOG_AUTH };
+    if (audit_sink_open(&audit) < 0) {
+        syslog(LOG_WARNING, "Audit sink unavailable, logging synchronously");
+    }
+    audit_log(LOG_INFO, "Secure GUI compositor initialized");
     
     return 0;
 }
@@ -261,6 +267,7 @@ void secure_compositor_cleanup(void) {
         event_fd = -1;
     }
     
+    audit_sink_close();
     closelog();
 }
 